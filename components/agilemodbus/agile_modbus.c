@@ -319,6 +319,136 @@ int agile_modbus_receive_judge(agile_modbus_t *ctx, int msg_length, agile_modbus
     return rc;
 }
 
+/**
+ * @brief   Initialize a streaming frame parser
+ * @param   parser parser handle
+ * @param   ctx modbus handle (RTU or TCP)
+ * @param   msg_type AGILE_MODBUS_MSG_INDICATION for requests, AGILE_MODBUS_MSG_CONFIRMATION for responses
+ */
+void agile_modbus_parser_init(agile_modbus_parser_t *parser, agile_modbus_t *ctx, agile_modbus_msg_type_t msg_type)
+{
+    parser->ctx = ctx;
+    parser->msg_type = msg_type;
+    agile_modbus_parser_reset(parser);
+}
+
+/**
+ * @brief   Discard the current frame and wait for the first byte of the next one
+ * @param   parser parser handle
+ */
+void agile_modbus_parser_reset(agile_modbus_parser_t *parser)
+{
+    parser->status = AGILE_MODBUS_PARSE_NEED_MORE;
+    parser->length = 0;
+    parser->frame_length = 0;
+#if AGILE_MODBUS_USING_RTU
+    parser->crc = AGILE_MODBUS_RTU_CRC16_INIT;
+#endif
+}
+
+/**
+ * @brief   Compute the frame length from the leading bytes received so far
+ @verbatim
+    RTU:  address + function code, then the same meta/data lengths receive_judge uses, + CRC16
+    TCP:  MBAP header, the length field gives the exact frame length
+
+ @endverbatim
+ * @param   parser parser handle
+ * @return  >0: frame length; 0: more bytes needed; -1: malformed header
+ */
+static int agile_modbus_parser_compute_frame_length(agile_modbus_parser_t *parser)
+{
+    agile_modbus_t *ctx = parser->ctx;
+    int header_length = ctx->backend->header_length;
+    int length;
+
+    if (ctx->backend->backend_type == AGILE_MODBUS_BACKEND_TYPE_TCP) {
+        if (parser->length < header_length)
+            return 0;
+        /* Protocol identifier must be 0, length covers unit identifier + PDU */
+        length = (parser->head[4] << 8) | parser->head[5];
+        if (parser->head[2] != 0 || parser->head[3] != 0 || length < 2)
+            return -1;
+        return header_length - 1 + length;
+    }
+
+    if (parser->length < header_length + 1)
+        return 0;
+    length = header_length + 1 + agile_modbus_compute_meta_length_after_function(ctx, parser->head[header_length], parser->msg_type);
+    if (length >= AGILE_MODBUS_PARSER_HEAD_LENGTH)
+        return -1;
+    if (parser->length < length)
+        return 0;
+
+    return length + agile_modbus_compute_data_length_after_meta(ctx, parser->head, parser->length, parser->msg_type);
+}
+
+/**
+ * @brief   Feed received bytes to the streaming frame parser
+ * @note    Consumes bytes up to the end of the current frame only, so pipelined frames in one
+ *          chunk are returned one by one: feed the remaining bytes again after each frame.
+ *          Feeding after COMPLETE or ERROR starts a new frame.
+ * @param   parser parser handle
+ * @param   data received bytes
+ * @param   data_length number of received bytes
+ * @param   consumed number of bytes that belong to the current frame (may be NULL)
+ * @return  agile_modbus_parse_status_t
+ */
+int agile_modbus_parser_feed(agile_modbus_parser_t *parser, const uint8_t *data, int data_length, int *consumed)
+{
+    int used = 0;
+
+    if (parser->status != AGILE_MODBUS_PARSE_NEED_MORE)
+        agile_modbus_parser_reset(parser);
+
+    while (used < data_length && parser->status == AGILE_MODBUS_PARSE_NEED_MORE) {
+        int n;
+
+        if (parser->frame_length == 0) {
+            /* Header bytes one at a time until the frame length is known */
+            n = 1;
+        } else {
+            n = parser->frame_length - parser->length;
+            if (n > data_length - used)
+                n = data_length - used;
+        }
+
+        if (parser->length < AGILE_MODBUS_PARSER_HEAD_LENGTH) {
+            int head_n = AGILE_MODBUS_PARSER_HEAD_LENGTH - parser->length;
+            memcpy(parser->head + parser->length, data + used, head_n < n ? head_n : n);
+        }
+#if AGILE_MODBUS_USING_RTU
+        if (parser->ctx->backend->backend_type == AGILE_MODBUS_BACKEND_TYPE_RTU)
+            parser->crc = agile_modbus_rtu_crc16_update(parser->crc, data + used, n);
+#endif
+        parser->length += n;
+        used += n;
+
+        if (parser->frame_length == 0) {
+            int frame_length = agile_modbus_parser_compute_frame_length(parser);
+            if (frame_length < 0 || frame_length > (int)parser->ctx->backend->max_adu_length) {
+                parser->status = AGILE_MODBUS_PARSE_ERROR;
+                break;
+            }
+            parser->frame_length = frame_length;
+        }
+
+        if (parser->frame_length > 0 && parser->length == parser->frame_length) {
+            parser->status = AGILE_MODBUS_PARSE_COMPLETE;
+#if AGILE_MODBUS_USING_RTU
+            /* CRC over the whole frame including its CRC bytes is 0 */
+            if (parser->ctx->backend->backend_type == AGILE_MODBUS_BACKEND_TYPE_RTU && parser->crc != 0)
+                parser->status = AGILE_MODBUS_PARSE_ERROR;
+#endif
+        }
+    }
+
+    if (consumed)
+        *consumed = used;
+
+    return parser->status;
+}
+
 /**
  * @}
  */
@@ -640,6 +770,162 @@ int agile_modbus_deserialize_read_input_registers(agile_modbus_t *ctx, int msg_l
     return rc;
 }
 
+/**
+ * @brief   Parse a read response and locate its data field without unpacking it
+ * @param   ctx modbus handle
+ * @param   msg_length received data length
+ * @param   data data field of the response inside ctx->read_buf
+ * @return  >=0: response object count (bits or registers); others: same as agile_modbus_deserialize_xxx
+ */
+static int agile_modbus_deserialize_read_data(agile_modbus_t *ctx, int msg_length, const uint8_t **data)
+{
+    int min_req_length = ctx->backend->header_length + 5 + ctx->backend->checksum_length;
+    if (ctx->send_bufsz < min_req_length)
+        return -1;
+    if ((msg_length <= 0) || (msg_length > ctx->read_bufsz))
+        return -1;
+
+    int rc = agile_modbus_receive_msg_judge(ctx, ctx->read_buf, msg_length, AGILE_MODBUS_MSG_CONFIRMATION);
+    if (rc < 0)
+        return -1;
+
+    rc = agile_modbus_check_confirmation(ctx, ctx->send_buf, ctx->read_buf, rc);
+    if (rc < 0)
+        return rc;
+
+    if (data)
+        *data = ctx->read_buf + ctx->backend->header_length + 2;
+
+    return rc;
+}
+
+/**
+ * @brief   Read coils response, zero copy
+ * @param   ctx modbus handle
+ * @param   msg_length received data length
+ * @param   bits packed bits (LSB first, as on the wire) inside ctx->read_buf
+ * @return  >=0: number of bits; others: same as agile_modbus_deserialize_read_bits
+ */
+int agile_modbus_deserialize_read_bits_packed(agile_modbus_t *ctx, int msg_length, const uint8_t **bits)
+{
+    int rc = agile_modbus_deserialize_read_data(ctx, msg_length, bits);
+    if (rc < 0)
+        return rc;
+
+    return (ctx->send_buf[ctx->backend->header_length + 3] << 8) + ctx->send_buf[ctx->backend->header_length + 4];
+}
+
+/**
+ * @brief   Read discrete inputs response, zero copy
+ * @see     agile_modbus_deserialize_read_bits_packed
+ */
+int agile_modbus_deserialize_read_input_bits_packed(agile_modbus_t *ctx, int msg_length, const uint8_t **bits)
+{
+    return agile_modbus_deserialize_read_bits_packed(ctx, msg_length, bits);
+}
+
+/**
+ * @brief   Read holding registers response, zero copy
+ * @param   ctx modbus handle
+ * @param   msg_length received data length
+ * @param   regs big-endian register values inside ctx->read_buf
+ * @return  >=0: number of registers; others: same as agile_modbus_deserialize_read_registers
+ */
+int agile_modbus_deserialize_read_registers_raw(agile_modbus_t *ctx, int msg_length, const uint8_t **regs)
+{
+    return agile_modbus_deserialize_read_data(ctx, msg_length, regs);
+}
+
+/**
+ * @brief   Read input registers response, zero copy
+ * @see     agile_modbus_deserialize_read_registers_raw
+ */
+int agile_modbus_deserialize_read_input_registers_raw(agile_modbus_t *ctx, int msg_length, const uint8_t **regs)
+{
+    return agile_modbus_deserialize_read_data(ctx, msg_length, regs);
+}
+
+/**
+ * @brief   Copy nb packed bits starting at bit src_bit of src into dest starting at bit 0
+ * @note    Bits of the last dest byte beyond nb are preserved.
+ *          Byte aligned sources are copied with memcpy, others 32 bits at a time.
+ * @param   dest destination bitset
+ * @param   src source bitset (LSB first)
+ * @param   src_bit first source bit
+ * @param   nb number of bits
+ */
+void agile_modbus_copy_packed_bits(uint8_t *dest, const uint8_t *src, int src_bit, int nb)
+{
+    const uint8_t *s = src + (src_bit >> 3);
+    int shift = src_bit & 7;
+    int full = nb >> 3;
+    int rest = nb & 7;
+    int i = 0;
+
+    if (shift == 0) {
+        memcpy(dest, s, full);
+        i = full;
+    } else {
+        /* 5 source bytes hold the 32 bits of each destination word */
+        for (; i + 4 <= full; i += 4) {
+            uint32_t word = ((uint32_t)s[i] | ((uint32_t)s[i + 1] << 8) |
+                             ((uint32_t)s[i + 2] << 16) | ((uint32_t)s[i + 3] << 24)) >> shift;
+            word |= (uint32_t)s[i + 4] << (32 - shift);
+            dest[i] = (uint8_t)word;
+            dest[i + 1] = (uint8_t)(word >> 8);
+            dest[i + 2] = (uint8_t)(word >> 16);
+            dest[i + 3] = (uint8_t)(word >> 24);
+        }
+        for (; i < full; i++)
+            dest[i] = (uint8_t)((s[i] | (s[i + 1] << 8)) >> shift);
+    }
+
+    if (rest) {
+        uint8_t mask = (uint8_t)((1 << rest) - 1);
+        uint8_t value = s[i] >> shift;
+        if (shift + rest > 8)
+            value |= (uint8_t)(s[i + 1] << (8 - shift));
+        dest[i] = (uint8_t)((dest[i] & ~mask) | (value & mask));
+    }
+}
+
+/**
+ * @brief   Copy nb packed bits from bit src_bit of src to bit dest_bit of dest
+ * @note    Bits of dest outside [dest_bit, dest_bit + nb) are preserved.
+ *          Bits up to the next dest byte boundary are merged first, the rest
+ *          is copied by agile_modbus_copy_packed_bits.
+ * @param   dest destination bitset (LSB first)
+ * @param   dest_bit first destination bit
+ * @param   src source bitset (LSB first)
+ * @param   src_bit first source bit
+ * @param   nb number of bits
+ */
+void agile_modbus_copy_bits(uint8_t *dest, int dest_bit, const uint8_t *src, int src_bit, int nb)
+{
+    uint8_t *d = dest + (dest_bit >> 3);
+    int shift = dest_bit & 7;
+
+    if (nb <= 0)
+        return;
+
+    if (shift) {
+        int head = 8 - shift;
+        uint8_t value = 0;
+
+        if (head > nb)
+            head = nb;
+        agile_modbus_copy_packed_bits(&value, src, src_bit, head);
+        uint8_t mask = (uint8_t)(((1 << head) - 1) << shift);
+        *d = (uint8_t)((*d & ~mask) | ((value << shift) & mask));
+        d++;
+        src_bit += head;
+        nb -= head;
+    }
+
+    if (nb > 0)
+        agile_modbus_copy_packed_bits(d, src, src_bit, nb);
+}
+
 int agile_modbus_serialize_write_bit(agile_modbus_t *ctx, int addr, int status)
 {
     int min_req_length = ctx->backend->header_length + 5 + ctx->backend->checksum_length;
@@ -745,6 +1031,41 @@ int agile_modbus_serialize_write_bits(agile_modbus_t *ctx, int addr, int nb, con
     return req_length;
 }
 
+/**
+ * @brief   Write multiple coils request from packed bits
+ * @param   ctx modbus handle
+ * @param   addr register address
+ * @param   nb number of coils
+ * @param   src packed bits (LSB first, as on the wire), copied as they are
+ * @return  >0: request data length; others: same as agile_modbus_serialize_write_bits
+ */
+int agile_modbus_serialize_write_bits_packed(agile_modbus_t *ctx, int addr, int nb, const uint8_t *src)
+{
+    int min_req_length = ctx->backend->header_length + 5 + ctx->backend->checksum_length;
+    if (ctx->send_bufsz < min_req_length)
+        return -1;
+
+    if (nb < 1 || nb > AGILE_MODBUS_MAX_WRITE_BITS)
+        return -1;
+
+    int req_length = ctx->backend->build_request_basis(ctx, AGILE_MODBUS_FC_WRITE_MULTIPLE_COILS, addr, nb, ctx->send_buf);
+    int byte_count = (nb / 8) + ((nb % 8) ? 1 : 0);
+
+    min_req_length += (1 + byte_count);
+    if (ctx->send_bufsz < min_req_length)
+        return -1;
+
+    ctx->send_buf[req_length++] = byte_count;
+    /* Padding bits after nb are sent as zero */
+    ctx->send_buf[req_length + byte_count - 1] = 0;
+    agile_modbus_copy_packed_bits(ctx->send_buf + req_length, src, 0, nb);
+    req_length += byte_count;
+
+    req_length = ctx->backend->send_msg_pre(ctx->send_buf, req_length);
+
+    return req_length;
+}
+
 int agile_modbus_deserialize_write_bits(agile_modbus_t *ctx, int msg_length)
 {
     int min_req_length = ctx->backend->header_length + 5 + ctx->backend->checksum_length;
@@ -1224,7 +1545,8 @@ int agile_modbus_slave_handle(agile_modbus_t *ctx, int msg_length, uint8_t slave
     uint8_t *req = ctx->read_buf;
     uint8_t *rsp = ctx->send_buf;
 
-    memset(rsp, 0, ctx->send_bufsz);
+    /* Only the data areas filled by slave_cb are zeroed below, the send
+       buffer may be much larger than one response */
     offset = ctx->backend->header_length;
     slave = req[offset - 1];
     function = req[offset];
@@ -1264,11 +1586,13 @@ int agile_modbus_slave_handle(agile_modbus_t *ctx, int msg_length, uint8_t slave
         rsp[rsp_length++] = slave_info.nb;
         slave_info.send_index = rsp_length;
         rsp_length += slave_info.nb;
-        slave_info.nb = nb;
         if (ctx->send_bufsz < (int)(rsp_length + ctx->backend->checksum_length)) {
             exception_code = AGILE_MODBUS_EXCEPTION_NEGATIVE_ACKNOWLEDGE;
             break;
         }
+        /* Unmapped bits and the padding after nb read as zero */
+        memset(rsp + slave_info.send_index, 0, slave_info.nb);
+        slave_info.nb = nb;
     } break;
 
     case AGILE_MODBUS_FC_READ_HOLDING_REGISTERS:
@@ -1290,11 +1614,13 @@ int agile_modbus_slave_handle(agile_modbus_t *ctx, int msg_length, uint8_t slave
         rsp[rsp_length++] = slave_info.nb;
         slave_info.send_index = rsp_length;
         rsp_length += slave_info.nb;
-        slave_info.nb = nb;
         if (ctx->send_bufsz < (int)(rsp_length + ctx->backend->checksum_length)) {
             exception_code = AGILE_MODBUS_EXCEPTION_NEGATIVE_ACKNOWLEDGE;
             break;
         }
+        /* Unmapped registers read as zero */
+        memset(rsp + slave_info.send_index, 0, slave_info.nb);
+        slave_info.nb = nb;
     } break;
 
     case AGILE_MODBUS_FC_WRITE_SINGLE_COIL: {
@@ -1468,6 +1794,7 @@ int agile_modbus_slave_handle(agile_modbus_t *ctx, int msg_length, uint8_t slave
             exception_code = AGILE_MODBUS_EXCEPTION_NEGATIVE_ACKNOWLEDGE;
             break;
         }
+        memset(rsp + slave_info.send_index, 0, nb << 1);
     } break;
 
     default: {
@@ -1478,6 +1805,8 @@ int agile_modbus_slave_handle(agile_modbus_t *ctx, int msg_length, uint8_t slave
             slave_info.send_index = rsp_length;
             slave_info.buf = &req[offset + 1];
             slave_info.nb = req_length - offset - 1;
+            /* Callbacks of other function codes build the data themselves on a zeroed buffer */
+            memset(rsp + rsp_length, 0, ctx->send_bufsz - rsp_length);
         }
     } break;
     }
@@ -228,6 +228,34 @@ struct agile_modbus {
     void *backend_data;                                                                      /**< Backend data, pointing to RTU or TCP structure */
 };
 
+/**
+ * @brief   Streaming frame parser result
+ */
+typedef enum {
+    AGILE_MODBUS_PARSE_ERROR = -1,    /**< Malformed frame: RTU CRC mismatch, bad MBAP header or frame too long */
+    AGILE_MODBUS_PARSE_NEED_MORE = 0, /**< Frame not complete yet */
+    AGILE_MODBUS_PARSE_COMPLETE = 1   /**< Frame complete, its length is in frame_length */
+} agile_modbus_parse_status_t;
+
+/** Leading bytes of a frame kept by the parser, enough to compute the frame length */
+#define AGILE_MODBUS_PARSER_HEAD_LENGTH 20
+
+/**
+ * @brief   Streaming frame parser structure
+ * @note    Bytes may be fed in chunks of any size. The parser does not keep the frame itself,
+ *          the caller stores the consumed bytes (usually in read_buf) and hands the complete
+ *          frame to receive_judge / deserialize / slave_handle.
+ */
+typedef struct agile_modbus_parser {
+    agile_modbus_t *ctx;                           /**< modbus handle, provides backend and length callbacks */
+    agile_modbus_msg_type_t msg_type;              /**< type of the frames being parsed */
+    int status;                                    /**< agile_modbus_parse_status_t of the current frame */
+    int length;                                    /**< bytes of the current frame consumed so far */
+    int frame_length;                              /**< total length of the current frame, 0 while unknown */
+    uint16_t crc;                                  /**< RTU running CRC16 */
+    uint8_t head[AGILE_MODBUS_PARSER_HEAD_LENGTH]; /**< leading bytes of the current frame */
+} agile_modbus_parser_t;
+
 /**
  * @}
  */
@@ -284,6 +312,9 @@ void agile_modbus_set_compute_data_length_after_meta_cb(agile_modbus_t *ctx,
                                                         int (*cb)(agile_modbus_t *ctx, uint8_t *msg,
                                                                   int msg_length, agile_modbus_msg_type_t msg_type));
 int agile_modbus_receive_judge(agile_modbus_t *ctx, int msg_length, agile_modbus_msg_type_t msg_type);
+void agile_modbus_parser_init(agile_modbus_parser_t *parser, agile_modbus_t *ctx, agile_modbus_msg_type_t msg_type);
+void agile_modbus_parser_reset(agile_modbus_parser_t *parser);
+int agile_modbus_parser_feed(agile_modbus_parser_t *parser, const uint8_t *data, int data_length, int *consumed);
 /**
  * @}
  */
@@ -303,11 +334,18 @@ int agile_modbus_serialize_read_registers(agile_modbus_t *ctx, int addr, int nb)
 int agile_modbus_deserialize_read_registers(agile_modbus_t *ctx, int msg_length, uint16_t *dest);
 int agile_modbus_serialize_read_input_registers(agile_modbus_t *ctx, int addr, int nb);
 int agile_modbus_deserialize_read_input_registers(agile_modbus_t *ctx, int msg_length, uint16_t *dest);
+int agile_modbus_deserialize_read_bits_packed(agile_modbus_t *ctx, int msg_length, const uint8_t **bits);
+int agile_modbus_deserialize_read_input_bits_packed(agile_modbus_t *ctx, int msg_length, const uint8_t **bits);
+int agile_modbus_deserialize_read_registers_raw(agile_modbus_t *ctx, int msg_length, const uint8_t **regs);
+int agile_modbus_deserialize_read_input_registers_raw(agile_modbus_t *ctx, int msg_length, const uint8_t **regs);
+void agile_modbus_copy_packed_bits(uint8_t *dest, const uint8_t *src, int src_bit, int nb);
+void agile_modbus_copy_bits(uint8_t *dest, int dest_bit, const uint8_t *src, int src_bit, int nb);
 int agile_modbus_serialize_write_bit(agile_modbus_t *ctx, int addr, int status);
 int agile_modbus_deserialize_write_bit(agile_modbus_t *ctx, int msg_length);
 int agile_modbus_serialize_write_register(agile_modbus_t *ctx, int addr, const uint16_t value);
 int agile_modbus_deserialize_write_register(agile_modbus_t *ctx, int msg_length);
 int agile_modbus_serialize_write_bits(agile_modbus_t *ctx, int addr, int nb, const uint8_t *src);
+int agile_modbus_serialize_write_bits_packed(agile_modbus_t *ctx, int addr, int nb, const uint8_t *src);
 int agile_modbus_deserialize_write_bits(agile_modbus_t *ctx, int msg_length);
 int agile_modbus_serialize_write_registers(agile_modbus_t *ctx, int addr, int nb, const uint16_t *src);
 int agile_modbus_deserialize_write_registers(agile_modbus_t *ctx, int msg_length);
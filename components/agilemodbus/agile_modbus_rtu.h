@@ -34,6 +34,7 @@ extern "C" {
 #define AGILE_MODBUS_RTU_PRESET_RSP_LENGTH 2
 
 #define AGILE_MODBUS_RTU_CHECKSUM_LENGTH 2
+#define AGILE_MODBUS_RTU_CRC16_INIT      0xFFFF /**< initial value for agile_modbus_rtu_crc16_update */
 
 /**
  @verbatim
@@ -55,7 +56,8 @@ extern "C" {
  * @brief   RTU structure
  */
 typedef struct agile_modbus_rtu {
-    agile_modbus_t _ctx; /**< modbus handle */
+    agile_modbus_t _ctx;     /**< modbus handle */
+    int crc_verified_length; /**< length of the frame in read_buf already CRC-verified by the receiver */
 } agile_modbus_rtu_t;
 
 /**
@@ -66,6 +68,9 @@ typedef struct agile_modbus_rtu {
  * @{
  */
 int agile_modbus_rtu_init(agile_modbus_rtu_t *ctx, uint8_t *send_buf, int send_bufsz, uint8_t *read_buf, int read_bufsz);
+void agile_modbus_rtu_set_crc_verified(agile_modbus_rtu_t *ctx, int length);
+uint16_t agile_modbus_rtu_crc16(const uint8_t *buffer, uint16_t buffer_length);
+uint16_t agile_modbus_rtu_crc16_update(uint16_t crc, const uint8_t *buffer, uint16_t buffer_length);
 /**
  * @}
  */
@@ -28,21 +28,166 @@
  */
 
 /**
- * @brief   根据寄存器地址从映射对象数组中获取映射对象
+ * @brief   在按地址升序排列的映射对象数组中二分查找第一个结束地址不小于 address 的映射对象
  * @param   maps 映射对象数组
  * @param   nb_maps 数组数目
  * @param   address 寄存器地址
- * @return  !=NULL:映射对象; =NULL:失败
+ * @return  映射对象下标，=nb_maps:所有映射都在 address 之前
  */
-static const agile_modbus_slave_util_map_t *get_map_by_addr(const agile_modbus_slave_util_map_t *maps, int nb_maps, int address)
+static int get_map_index(const agile_modbus_slave_util_map_t *maps, int nb_maps, int address)
 {
-    for (int i = 0; i < nb_maps; i++) {
-        const agile_modbus_slave_util_map_t *map = &maps[i];
-        if (address >= map->start_addr && address <= map->end_addr)
-            return map;
+    int low = 0;
+    int high = nb_maps;
+
+    while (low < high) {
+        int mid = low + (high - low) / 2;
+        if (maps[mid].end_addr < address)
+            low = mid + 1;
+        else
+            high = mid;
     }
 
-    return NULL;
+    return low;
+}
+
+/**
+ * @brief   映射对象加解锁
+ * @param   map 映射对象
+ * @param   op 加解锁操作
+ * @return  =0:成功; <0:加锁失败的异常码
+ */
+static int map_lock(const agile_modbus_slave_util_map_t *map, int op)
+{
+    if (map->lock)
+        return map->lock(op);
+
+    return 0;
+}
+
+/**
+ * @brief   请求区间 [address, address + nb) 与一个映射对象的交集
+ */
+typedef struct {
+    int index;    /**< 交集起点在映射中的下标 */
+    int offset;   /**< 交集起点在请求中的偏移 */
+    int need_len; /**< 交集长度 */
+} map_range_t;
+
+/**
+ * @brief   计算请求区间与映射对象的交集
+ * @param   map 映射对象
+ * @param   address 请求起始地址
+ * @param   nb 请求数目
+ * @return  交集
+ */
+static map_range_t map_range(const agile_modbus_slave_util_map_t *map, int address, int nb)
+{
+    int first = address > map->start_addr ? address : map->start_addr;
+    int last = address + nb - 1 < map->end_addr ? address + nb - 1 : map->end_addr;
+    map_range_t range = {first - map->start_addr, first - address, last - first + 1};
+
+    return range;
+}
+
+/**
+ * @brief   读取一段映射数据到响应
+ * @param   ctx modbus 句柄
+ * @param   map 映射对象
+ * @param   range 请求与映射的交集
+ * @param   bits 是否为线圈/离散量
+ * @param   send_index 响应数据在发送缓冲区中的位置
+ * @return  =0:正常; <0:加锁失败的异常码
+ */
+static int read_map(agile_modbus_t *ctx, const agile_modbus_slave_util_map_t *map, map_range_t range, int bits, int send_index)
+{
+    uint8_t map_buf[AGILE_MODBUS_MAX_PDU_LENGTH];
+    const void *src = map->data;
+
+    if (src) {
+        int rc = map_lock(map, AGILE_MODBUS_SLAVE_UTIL_LOCK_READ);
+        if (rc != 0)
+            return rc;
+    } else {
+        if (map->get == NULL)
+            return 0;
+        memset(map_buf, 0, sizeof(map_buf));
+        map->get(map_buf, sizeof(map_buf));
+        src = map_buf;
+    }
+
+    if (bits && map->data) {
+        agile_modbus_copy_bits(ctx->send_buf + send_index, range.offset, (const uint8_t *)src, range.index, range.need_len);
+    } else if (bits) {
+        const uint8_t *ptr = (const uint8_t *)src + range.index;
+        for (int j = 0; j < range.need_len; j++) {
+            agile_modbus_slave_io_set(ctx->send_buf + send_index, range.offset + j, ptr[j]);
+        }
+    } else {
+        const uint16_t *ptr = (const uint16_t *)src + range.index;
+        for (int j = 0; j < range.need_len; j++) {
+            agile_modbus_slave_register_set(ctx->send_buf + send_index, range.offset + j, ptr[j]);
+        }
+    }
+
+    if (map->data)
+        map_lock(map, AGILE_MODBUS_SLAVE_UTIL_UNLOCK);
+
+    return 0;
+}
+
+/**
+ * @brief   写入一段映射数据
+ * @param   map 映射对象
+ * @param   range 请求与映射的交集
+ * @param   bits 是否为线圈
+ * @param   src 请求中的数据(线圈为打包的位，寄存器为大端)，=NULL:使用 value
+ * @param   value 单个线圈/寄存器的值
+ * @return  =0:正常; <0:加锁失败或 set 接口返回的异常码
+ */
+static int write_map(const agile_modbus_slave_util_map_t *map, map_range_t range, int bits, const uint8_t *src, int value)
+{
+    uint8_t map_buf[AGILE_MODBUS_MAX_PDU_LENGTH];
+    void *dest = map->data;
+    int bufsz;
+
+    if (map->set == NULL)
+        return 0;
+
+    if (dest) {
+        int elements = map->end_addr - map->start_addr + 1;
+        bufsz = bits ? (elements + 7) / 8 : elements * (int)sizeof(uint16_t);
+        int rc = map_lock(map, AGILE_MODBUS_SLAVE_UTIL_LOCK_WRITE);
+        if (rc != 0)
+            return rc;
+    } else {
+        memset(map_buf, 0, sizeof(map_buf));
+        if (map->get)
+            map->get(map_buf, sizeof(map_buf));
+        dest = map_buf;
+        bufsz = sizeof(map_buf);
+    }
+
+    if (bits && map->data) {
+        if (src)
+            agile_modbus_copy_bits((uint8_t *)dest, range.index, src, range.offset, range.need_len);
+        else
+            agile_modbus_slave_io_set((uint8_t *)dest, range.index, value);
+    } else if (bits) {
+        uint8_t *ptr = (uint8_t *)dest + range.index;
+        for (int j = 0; j < range.need_len; j++) {
+            ptr[j] = src ? agile_modbus_slave_io_get((uint8_t *)src, range.offset + j) : value;
+        }
+    } else {
+        uint16_t *ptr = (uint16_t *)dest + range.index;
+        for (int j = 0; j < range.need_len; j++) {
+            ptr[j] = src ? agile_modbus_slave_register_get((uint8_t *)src, range.offset + j) : value;
+        }
+    }
+
+    if (map->data)
+        map_lock(map, AGILE_MODBUS_SLAVE_UTIL_UNLOCK);
+
+    return map->set(range.index, range.need_len, dest, bufsz);
 }
 
 /**
@@ -57,11 +202,9 @@ static const agile_modbus_slave_util_map_t *get_map_by_addr(const agile_modbus_s
  */
 static int read_registers(agile_modbus_t *ctx, struct agile_modbus_slave_info *slave_info, const agile_modbus_slave_util_t *slave_util)
 {
-    uint8_t map_buf[AGILE_MODBUS_MAX_PDU_LENGTH];
     int function = slave_info->sft->function;
     int address = slave_info->address;
     int nb = slave_info->nb;
-    int send_index = slave_info->send_index;
     const agile_modbus_slave_util_map_t *maps = NULL;
     int nb_maps = 0;
 
@@ -93,36 +236,11 @@ static int read_registers(agile_modbus_t *ctx, struct agile_modbus_slave_info *s
     if (maps == NULL)
         return 0;
 
-    for (int now_address = address, i = 0; now_address < address + nb; now_address++, i++) {
-        const agile_modbus_slave_util_map_t *map = get_map_by_addr(maps, nb_maps, now_address);
-        if (map == NULL)
-            continue;
-
-        int map_len = map->end_addr - now_address + 1;
-        if (map->get) {
-            memset(map_buf, 0, sizeof(map_buf));
-            map->get(map_buf, sizeof(map_buf));
-            int index = now_address - map->start_addr;
-            int need_len = address + nb - now_address;
-            if (need_len > map_len) {
-                need_len = map_len;
-            }
-
-            if (function == AGILE_MODBUS_FC_READ_COILS || function == AGILE_MODBUS_FC_READ_DISCRETE_INPUTS) {
-                uint8_t *ptr = map_buf;
-                for (int j = 0; j < need_len; j++) {
-                    agile_modbus_slave_io_set(ctx->send_buf + send_index, i + j, ptr[index + j]);
-                }
-            } else {
-                uint16_t *ptr = (uint16_t *)map_buf;
-                for (int j = 0; j < need_len; j++) {
-                    agile_modbus_slave_register_set(ctx->send_buf + send_index, i + j, ptr[index + j]);
-                }
-            }
-        }
-
-        now_address += map_len - 1;
-        i += map_len - 1;
+    int bits = (function == AGILE_MODBUS_FC_READ_COILS || function == AGILE_MODBUS_FC_READ_DISCRETE_INPUTS);
+    for (int k = get_map_index(maps, nb_maps, address); k < nb_maps && maps[k].start_addr < address + nb; k++) {
+        int rc = read_map(ctx, &maps[k], map_range(&maps[k], address, nb), bits, slave_info->send_index);
+        if (rc != 0)
+            return rc;
     }
 
     return 0;
@@ -140,7 +258,6 @@ static int read_registers(agile_modbus_t *ctx, struct agile_modbus_slave_info *s
  */
 static int write_registers(agile_modbus_t *ctx, struct agile_modbus_slave_info *slave_info, const agile_modbus_slave_util_t *slave_util)
 {
-    uint8_t map_buf[AGILE_MODBUS_MAX_PDU_LENGTH];
     int function = slave_info->sft->function;
     int address = slave_info->address;
     int nb = 0;
@@ -177,55 +294,15 @@ static int write_registers(agile_modbus_t *ctx, struct agile_modbus_slave_info *
     if (maps == NULL)
         return 0;
 
-    for (int now_address = address, i = 0; now_address < address + nb; now_address++, i++) {
-        const agile_modbus_slave_util_map_t *map = get_map_by_addr(maps, nb_maps, now_address);
-        if (map == NULL)
-            continue;
-
-        int map_len = map->end_addr - now_address + 1;
-        if (map->set) {
-            memset(map_buf, 0, sizeof(map_buf));
-            if (map->get) {
-                map->get(map_buf, sizeof(map_buf));
-            }
-
-            int index = now_address - map->start_addr;
-            int need_len = address + nb - now_address;
-            if (need_len > map_len) {
-                need_len = map_len;
-            }
-
-            if (function == AGILE_MODBUS_FC_WRITE_SINGLE_COIL || function == AGILE_MODBUS_FC_WRITE_MULTIPLE_COILS) {
-                uint8_t *ptr = map_buf;
-                if (function == AGILE_MODBUS_FC_WRITE_SINGLE_COIL) {
-                    int data = *((int *)slave_info->buf);
-                    ptr[index] = data;
-                } else {
-                    for (int j = 0; j < need_len; j++) {
-                        uint8_t data = agile_modbus_slave_io_get(slave_info->buf, i + j);
-                        ptr[index + j] = data;
-                    }
-                }
-            } else {
-                uint16_t *ptr = (uint16_t *)map_buf;
-                if (function == AGILE_MODBUS_FC_WRITE_SINGLE_REGISTER) {
-                    int data = *((int *)slave_info->buf);
-                    ptr[index] = data;
-                } else {
-                    for (int j = 0; j < need_len; j++) {
-                        uint16_t data = agile_modbus_slave_register_get(slave_info->buf, i + j);
-                        ptr[index + j] = data;
-                    }
-                }
-            }
-
-            int rc = map->set(index, need_len, map_buf, sizeof(map_buf));
-            if (rc != 0)
-                return rc;
-        }
+    int bits = (function == AGILE_MODBUS_FC_WRITE_SINGLE_COIL || function == AGILE_MODBUS_FC_WRITE_MULTIPLE_COILS);
+    int single = (function == AGILE_MODBUS_FC_WRITE_SINGLE_COIL || function == AGILE_MODBUS_FC_WRITE_SINGLE_REGISTER);
+    const uint8_t *src = single ? NULL : slave_info->buf;
+    int value = single ? *((int *)slave_info->buf) : 0;
 
-        now_address += map_len - 1;
-        i += map_len - 1;
+    for (int k = get_map_index(maps, nb_maps, address); k < nb_maps && maps[k].start_addr < address + nb; k++) {
+        int rc = write_map(&maps[k], map_range(&maps[k], address, nb), bits, src, value);
+        if (rc != 0)
+            return rc;
     }
 
     return 0;
@@ -251,31 +328,41 @@ static int mask_write_register(agile_modbus_t *ctx, struct agile_modbus_slave_in
     if (maps == NULL)
         return 0;
 
-    const agile_modbus_slave_util_map_t *map = get_map_by_addr(maps, nb_maps, address);
-    if (map == NULL)
+    int k = get_map_index(maps, nb_maps, address);
+    if (k >= nb_maps || maps[k].start_addr > address)
+        return 0;
+
+    const agile_modbus_slave_util_map_t *map = &maps[k];
+    if (map->set == NULL)
         return 0;
 
-    if (map->set) {
+    uint16_t *ptr = (uint16_t *)map->data;
+    int bufsz = (map->end_addr - map->start_addr + 1) * sizeof(uint16_t);
+    if (ptr) {
+        int rc = map_lock(map, AGILE_MODBUS_SLAVE_UTIL_LOCK_WRITE);
+        if (rc != 0)
+            return rc;
+    } else {
         memset(map_buf, 0, sizeof(map_buf));
         if (map->get) {
             map->get(map_buf, sizeof(map_buf));
         }
+        ptr = (uint16_t *)map_buf;
+        bufsz = sizeof(map_buf);
+    }
 
-        int index = address - map->start_addr;
-        uint16_t *ptr = (uint16_t *)map_buf;
-        uint16_t data = ptr[index];
-        uint16_t and = (slave_info->buf[0] << 8) + slave_info->buf[1];
-        uint16_t or = (slave_info->buf[2] << 8) + slave_info->buf[3];
+    int index = address - map->start_addr;
+    uint16_t data = ptr[index];
+    uint16_t and = (slave_info->buf[0] << 8) + slave_info->buf[1];
+    uint16_t or = (slave_info->buf[2] << 8) + slave_info->buf[3];
 
-        data = (data & and) | (or &(~and));
-        ptr[index] = data;
+    data = (data & and) | (or &(~and));
+    ptr[index] = data;
 
-        int rc = map->set(index, 1, map_buf, sizeof(map_buf));
-        if (rc != 0)
-            return rc;
-    }
+    if (map->data)
+        map_lock(map, AGILE_MODBUS_SLAVE_UTIL_UNLOCK);
 
-    return 0;
+    return map->set(index, 1, ptr, bufsz);
 }
 
 /**
@@ -290,12 +377,10 @@ static int mask_write_register(agile_modbus_t *ctx, struct agile_modbus_slave_in
  */
 static int write_read_registers(agile_modbus_t *ctx, struct agile_modbus_slave_info *slave_info, const agile_modbus_slave_util_t *slave_util)
 {
-    uint8_t map_buf[AGILE_MODBUS_MAX_PDU_LENGTH];
     int address = slave_info->address;
     int nb = (slave_info->buf[0] << 8) + slave_info->buf[1];
     int address_write = (slave_info->buf[2] << 8) + slave_info->buf[3];
     int nb_write = (slave_info->buf[4] << 8) + slave_info->buf[5];
-    int send_index = slave_info->send_index;
 
     const agile_modbus_slave_util_map_t *maps = slave_util->tab_registers;
     int nb_maps = slave_util->nb_registers;
@@ -304,63 +389,17 @@ static int write_read_registers(agile_modbus_t *ctx, struct agile_modbus_slave_i
         return 0;
 
     /* Write first. 7 is the offset of the first values to write */
-    for (int now_address = address_write, i = 0; now_address < address_write + nb_write; now_address++, i++) {
-        const agile_modbus_slave_util_map_t *map = get_map_by_addr(maps, nb_maps, now_address);
-        if (map == NULL)
-            continue;
-
-        int map_len = map->end_addr - now_address + 1;
-        if (map->set) {
-            memset(map_buf, 0, sizeof(map_buf));
-            if (map->get) {
-                map->get(map_buf, sizeof(map_buf));
-            }
-
-            int index = now_address - map->start_addr;
-            uint16_t *ptr = (uint16_t *)map_buf;
-            int need_len = address_write + nb_write - now_address;
-            if (need_len > map_len) {
-                need_len = map_len;
-            }
-
-            for (int j = 0; j < need_len; j++) {
-                uint16_t data = agile_modbus_slave_register_get(slave_info->buf + 7, i + j);
-                ptr[index + j] = data;
-            }
-
-            int rc = map->set(index, need_len, map_buf, sizeof(map_buf));
-            if (rc != 0)
-                return rc;
-        }
-
-        now_address += map_len - 1;
-        i += map_len - 1;
+    for (int k = get_map_index(maps, nb_maps, address_write); k < nb_maps && maps[k].start_addr < address_write + nb_write; k++) {
+        int rc = write_map(&maps[k], map_range(&maps[k], address_write, nb_write), 0, slave_info->buf + 7, 0);
+        if (rc != 0)
+            return rc;
     }
 
     /* and read the data for the response */
-    for (int now_address = address, i = 0; now_address < address + nb; now_address++, i++) {
-        const agile_modbus_slave_util_map_t *map = get_map_by_addr(maps, nb_maps, now_address);
-        if (map == NULL)
-            continue;
-
-        int map_len = map->end_addr - now_address + 1;
-        if (map->get) {
-            memset(map_buf, 0, sizeof(map_buf));
-            map->get(map_buf, sizeof(map_buf));
-            int index = now_address - map->start_addr;
-            uint16_t *ptr = (uint16_t *)map_buf;
-            int need_len = address + nb - now_address;
-            if (need_len > map_len) {
-                need_len = map_len;
-            }
-
-            for (int j = 0; j < need_len; j++) {
-                agile_modbus_slave_register_set(ctx->send_buf + send_index, i + j, ptr[index + j]);
-            }
-        }
-
-        now_address += map_len - 1;
-        i += map_len - 1;
+    for (int k = get_map_index(maps, nb_maps, address); k < nb_maps && maps[k].start_addr < address + nb; k++) {
+        int rc = read_map(ctx, &maps[k], map_range(&maps[k], address, nb), 0, slave_info->send_index);
+        if (rc != 0)
+            return rc;
     }
 
     return 0;
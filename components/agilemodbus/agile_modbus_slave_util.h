@@ -32,14 +32,30 @@ extern "C" {
  * @{
  */
 
+/**
+ * @brief   直接访问映射的加解锁操作
+ */
+enum {
+    AGILE_MODBUS_SLAVE_UTIL_UNLOCK = 0, /**< 解锁 */
+    AGILE_MODBUS_SLAVE_UTIL_LOCK_READ,  /**< 读取 data 前加锁 */
+    AGILE_MODBUS_SLAVE_UTIL_LOCK_WRITE  /**< 写入 data 前加锁 */
+};
+
 /**
  * @brief   从机寄存器映射结构体
+ * @note    同一类寄存器的映射数组须按 start_addr 升序排列且地址不重叠，按地址二分查找。
+ *          data 不为 NULL 时为直接访问映射：读写直接操作 data 中 end_addr - start_addr + 1 个元素
+ *          (线圈/离散量为按位打包的位表，第 i 个元素为 data[i / 8] 的第 i % 8 位，寄存器每元素 uint16_t)，
+ *          只访问请求涉及的元素，位表按字整体移位复制，不调用 get；
+ *          set 为 NULL 时映射只读，否则在写入 data 之后以 buf = data 调用 set 通知写入的区间。
  */
 typedef struct agile_modbus_slave_util_map {
     int start_addr;                                       /**< 起始地址 */
     int end_addr;                                         /**< 结束地址 */
     int (*get)(void *buf, int bufsz);                     /**< 获取寄存器数据接口 */
     int (*set)(int index, int len, void *buf, int bufsz); /**< 设置寄存器数据接口 */
+    void *data;                                           /**< 直接访问的寄存器表，NULL 时使用 get/set 复制整个映射 */
+    int (*lock)(int op);                                  /**< 访问 data 前后的加解锁接口，可为 NULL；加锁失败返回负数异常码，请求以该异常响应 */
 } agile_modbus_slave_util_map_t;
 
 /**
@@ -0,0 +1,138 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "esp_log.h"
+#include "agile_modbus.h"
+#include "agile_modbus_rtu.h"
+#include "agile_modbus_test.h"
+
+static const char *TAG = "agile_modbus_test";
+
+#define CRC_ROUNDS 20000
+#define CRC_MAX_LEN 600
+#define COPY_ROUNDS 200000
+#define COPY_BUF_BYTES 300
+#define COPY_MAX_BITS AGILE_MODBUS_MAX_WRITE_BITS
+
+// 测试数据用固定种子的线性同余序列，每次运行相同
+static uint32_t rng_state;
+
+static uint32_t rng_next(void)
+{
+    rng_state = rng_state * 1103515245u + 12345u;
+    return rng_state >> 8;
+}
+
+// 逐位计算的标准 Modbus CRC16(多项式0xA001，初值0xFFFF)，低字节先发送
+static uint16_t crc16_reference(const uint8_t *buf, int len)
+{
+    uint16_t crc = 0xFFFF;
+    for (int i = 0; i < len; i++) {
+        crc ^= buf[i];
+        for (int b = 0; b < 8; b++) {
+            crc = (crc & 1) ? (crc >> 1) ^ 0xA001 : crc >> 1;
+        }
+    }
+    return crc;
+}
+
+static int bit_get(const uint8_t *buf, int bit)
+{
+    return (buf[bit >> 3] >> (bit & 7)) & 1;
+}
+
+static void bit_set(uint8_t *buf, int bit, int value)
+{
+    if (value) {
+        buf[bit >> 3] |= (uint8_t)(1 << (bit & 7));
+    } else {
+        buf[bit >> 3] &= (uint8_t)~(1 << (bit & 7));
+    }
+}
+
+// agile_modbus_rtu_crc16 返回高字节在前的值(帧中先发高字节即标准CRC的低字节)，
+// 增量接口返回标准CRC，任意切分成两段计算结果相同
+static int test_crc(void)
+{
+    static uint8_t buf[CRC_MAX_LEN];
+
+    // 标准校验值："123456789" 的 Modbus CRC 为 0x4B37
+    if (crc16_reference((const uint8_t *)"123456789", 9) != 0x4B37) {
+        ESP_LOGE(TAG, "crc reference self check failed");
+        return 1;
+    }
+
+    for (int round = 0; round < CRC_ROUNDS; round++) {
+        int len = rng_next() % CRC_MAX_LEN;
+        for (int i = 0; i < len; i++) {
+            buf[i] = (uint8_t)rng_next();
+        }
+        uint16_t expected = crc16_reference(buf, len);
+
+        uint16_t crc = agile_modbus_rtu_crc16(buf, len);
+        if (crc != (uint16_t)((expected << 8) | (expected >> 8))) {
+            ESP_LOGE(TAG, "crc16 len %d: 0x%04X, expected 0x%04X", len, crc, expected);
+            return 1;
+        }
+
+        int split = rng_next() % (len + 1);
+        crc = agile_modbus_rtu_crc16_update(AGILE_MODBUS_RTU_CRC16_INIT, buf, split);
+        crc = agile_modbus_rtu_crc16_update(crc, buf + split, len - split);
+        if (crc != expected) {
+            ESP_LOGE(TAG, "crc16_update len %d split %d: 0x%04X, expected 0x%04X", len, split, crc, expected);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// 任意源/目标位偏移和长度，目标区间外的位保持不变
+static int test_copy_bits(void)
+{
+    static uint8_t src[COPY_BUF_BYTES];
+    static uint8_t dest[COPY_BUF_BYTES];
+    static uint8_t expected[COPY_BUF_BYTES];
+    const int max_bit = (COPY_BUF_BYTES - 8) * 8;
+
+    for (int round = 0; round < COPY_ROUNDS; round++) {
+        for (int i = 0; i < COPY_BUF_BYTES; i++) {
+            src[i] = (uint8_t)rng_next();
+            dest[i] = expected[i] = (uint8_t)rng_next();
+        }
+        int nb = rng_next() % (COPY_MAX_BITS + 1);
+        int src_bit = rng_next() % (max_bit - nb + 1);
+        int dest_bit = rng_next() % (max_bit - nb + 1);
+        bool packed = (round & 1) != 0;
+        if (packed) {
+            dest_bit = 0;
+        }
+
+        for (int i = 0; i < nb; i++) {
+            bit_set(expected, dest_bit + i, bit_get(src, src_bit + i));
+        }
+        if (packed) {
+            agile_modbus_copy_packed_bits(dest, src, src_bit, nb);
+        } else {
+            agile_modbus_copy_bits(dest, dest_bit, src, src_bit, nb);
+        }
+        if (memcmp(dest, expected, sizeof(dest)) != 0) {
+            ESP_LOGE(TAG, "%s nb %d src_bit %d dest_bit %d mismatch",
+                     packed ? "copy_packed_bits" : "copy_bits", nb, src_bit, dest_bit);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+bool agile_modbus_test_run(void)
+{
+    int failures = 0;
+
+    rng_state = 1;
+    failures += test_crc();
+    failures += test_copy_bits();
+
+    ESP_LOGI(TAG, "%d crc rounds, %d copy rounds, %d failures", CRC_ROUNDS, COPY_ROUNDS, failures);
+    return failures == 0;
+}
@@ -0,0 +1,12 @@
+#ifndef AGILE_MODBUS_TEST_H
+#define AGILE_MODBUS_TEST_H
+
+#include <stdbool.h>
+
+// agile_modbus 位运算和CRC的主机测试：按字节查表CRC16/增量CRC与逐位参考实现比对，
+// 打包位复制与逐位参考实现比对。只在主机构建中使用，配置 {"agile_modbus_test":{}} 时运行
+
+// 运行所有用例，打印第一个不一致的参数，返回是否全部通过
+bool agile_modbus_test_run(void);
+
+#endif
@@ -0,0 +1,557 @@
+#include <errno.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "lwip/sockets.h"
+#include "agile_modbus.h"
+#include "gateway_bench.h"
+#include "modbus_config.h"
+#include "perf_stage.h"
+#include "rtu_pty.h"
+#include "slave_sim.h"
+#include "tcp_server.h"
+#include "tcp_slave_regs.h"
+
+static const char *TAG = "gateway_bench";
+
+#define BENCH_TASK_STACK_SIZE 4096
+#define BENCH_PORT_COUNT 3
+#define BENCH_TCP_TIMEOUT_MS 1000
+#define BENCH_RESULTS_PATH_LEN 128
+
+// 探针：模拟从站上的一个寄存器，每次改写为新值后记录各阶段首次观察到新值的时间
+typedef struct {
+    uint8_t group;
+    uint16_t offset;                // 组内寄存器序号
+    uint8_t function_code;
+    uint16_t *table;                // 模拟从站的保持/输入寄存器表
+    uint16_t slave_reg;             // 模拟从站上的寄存器地址
+    int tcp_addr;                   // TCP从站上的寄存器地址，-1 表示未映射
+    int mqtt_index;                 // MQTT负载中组数组的下标，-1 表示不发布
+    uint16_t value;                 // 最近一次写入的值
+    int64_t changed_us;             // 最近一次写入的时间，0 表示尚未写入
+    bool seen[GATEWAY_BENCH_STAGE_COUNT];
+} bench_probe_t;
+
+// 一个阶段的延迟样本
+typedef struct {
+    uint32_t *samples_us;
+    uint32_t count;
+    uint32_t missed;                // 下一次改写前仍未观察到的变化次数
+    bool used;                      // 有探针经过此阶段
+    uint32_t max_p99_ms;            // p99 上限，0 表示不检查
+} bench_series_t;
+
+static bool bench_enabled = false;
+static bench_probe_t probes[GATEWAY_BENCH_MAX_PROBES];
+static int probe_count = 0;
+static bench_series_t series[GATEWAY_BENCH_STAGE_COUNT];
+static uint32_t change_interval_ms = 500;
+static int tcp_clients = 0;
+static uint32_t tcp_interval_ms = 20;
+static char results_path[BENCH_RESULTS_PATH_LEN];
+
+static SemaphoreHandle_t bench_mutex = NULL;
+static uint32_t changes = 0;
+static uint32_t tcp_requests = 0;
+static uint32_t tcp_errors = 0;
+static int64_t start_us = 0;
+static rtu_port_stats_t start_stats[BENCH_PORT_COUNT + 1];
+static perf_stage_stats_t start_cpu[PERF_STAGE_COUNT];
+
+static const char *stage_names[GATEWAY_BENCH_STAGE_COUNT] = {"acquire", "tcp", "mqtt"};
+
+static int json_int(const cJSON *obj, const char *key, int def)
+{
+    cJSON *item = cJSON_GetObjectItem(obj, key);
+    return cJSON_IsNumber(item) ? item->valueint : def;
+}
+
+// TCP从站上映射了该组寄存器的地址，没有映射返回-1
+static int find_tcp_addr(uint8_t group, uint8_t function_code, uint16_t offset)
+{
+    if (!tcp_slave.enabled) {
+        return -1;
+    }
+    map_type_t type = (function_code == 3) ? MAP_HOLD_TO_HOLD : MAP_INPUT_TO_INPUT;
+    for (int i = 0; i < MAX_MAPS; i++) {
+        if (tcp_slave.maps[i].count == 0 || tcp_slave.maps[i].group_index != group ||
+            tcp_slave.maps[i].type != type) {
+            continue;
+        }
+        uint16_t first = tcp_slave.maps[i].master_start_addr;
+        if (offset >= first && offset < first + tcp_slave.maps[i].count) {
+            return tcp_slave.maps[i].slave_start_addr + (offset - first);
+        }
+    }
+    return -1;
+}
+
+// MQTT负载中该寄存器的下标：只有按16位解析时一个寄存器对应一个数值
+static int find_mqtt_index(const mqtt_config_t *mqtt, uint8_t group, uint16_t offset)
+{
+    if (mqtt == NULL || !mqtt->enabled) {
+        return -1;
+    }
+    for (int i = 0; i < mqtt->group_count; i++) {
+        if (mqtt->group_ids[i] != group) {
+            continue;
+        }
+        parse_method_t method = mqtt->parse_methods[group];
+        return (method == PARSE_INT16_SIGNED || method == PARSE_INT16_UNSIGNED) ? offset : -1;
+    }
+    return -1;
+}
+
+static esp_err_t add_probe(const cJSON *item, const mqtt_config_t *mqtt)
+{
+    int group = json_int(item, "group", -1);
+    int offset = json_int(item, "offset", 0);
+
+    if (group < 0 || group >= modbus_config.group_count || !modbus_config.groups[group].enabled) {
+        ESP_LOGE(TAG, "Probe group %d is not an enabled poll group", group);
+        return ESP_ERR_INVALID_ARG;
+    }
+    const poll_group_config_t *cfg = &modbus_config.groups[group];
+    if ((cfg->function_code != 3 && cfg->function_code != 4) || offset < 0 || offset >= cfg->reg_count) {
+        ESP_LOGE(TAG, "Probe group %d offset %d: only registers of FC03/FC04 groups can be probed",
+                 group, offset);
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    slave_sim_t *slave = slave_sim_find(cfg->uart_port, cfg->slave_addr);
+    if (slave == NULL || cfg->start_addr + offset >= slave->size) {
+        ESP_LOGE(TAG, "Probe group %d offset %d has no simulated register", group, offset);
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (slave->ramp_ms) {
+        ESP_LOGW(TAG, "Probe group %d: slave %d ramps its registers, changes may be missed",
+                 group, cfg->slave_addr);
+    }
+
+    bench_probe_t *probe = &probes[probe_count++];
+    memset(probe, 0, sizeof(*probe));
+    probe->group = group;
+    probe->offset = offset;
+    probe->function_code = cfg->function_code;
+    probe->table = (cfg->function_code == 3) ? slave->registers : slave->input_registers;
+    probe->slave_reg = cfg->start_addr + offset;
+    probe->value = probe->table[probe->slave_reg];
+    probe->tcp_addr = find_tcp_addr(group, cfg->function_code, offset);
+    probe->mqtt_index = find_mqtt_index(mqtt, group, offset);
+
+    series[GATEWAY_BENCH_ACQUIRE].used = true;
+    series[GATEWAY_BENCH_TCP].used |= probe->tcp_addr >= 0;
+    series[GATEWAY_BENCH_MQTT].used |= probe->mqtt_index >= 0;
+    ESP_LOGI(TAG, "Probe %d: group %d reg %d (port %d slave %d addr %d), TCP addr %d, MQTT index %d",
+             probe_count - 1, group, offset, cfg->uart_port, cfg->slave_addr, probe->slave_reg,
+             probe->tcp_addr, probe->mqtt_index);
+    return ESP_OK;
+}
+
+esp_err_t gateway_bench_from_json(const cJSON *bench, const mqtt_config_t *mqtt)
+{
+    const cJSON *list = cJSON_GetObjectItem(bench, "probes");
+    if (!cJSON_IsArray(list) || cJSON_GetArraySize(list) == 0) {
+        ESP_LOGE(TAG, "Benchmark needs at least one probe");
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    probe_count = 0;
+    memset(series, 0, sizeof(series));
+    const cJSON *item;
+    cJSON_ArrayForEach(item, list) {
+        if (probe_count >= GATEWAY_BENCH_MAX_PROBES) {
+            ESP_LOGW(TAG, "Only the first %d probes are used", GATEWAY_BENCH_MAX_PROBES);
+            break;
+        }
+        esp_err_t err = add_probe(item, mqtt);
+        if (err != ESP_OK) {
+            return err;
+        }
+    }
+
+    int interval = json_int(bench, "change_interval_ms", 500);
+    change_interval_ms = interval > 0 ? interval : 500;
+    tcp_clients = json_int(bench, "tcp_clients", 1);
+    if (tcp_clients < 0 || !series[GATEWAY_BENCH_TCP].used) {
+        tcp_clients = 0;
+    } else if (tcp_clients > tcp_slave.max_clients) {
+        ESP_LOGW(TAG, "TCP slave accepts at most %d clients", tcp_slave.max_clients);
+        tcp_clients = tcp_slave.max_clients;
+    }
+    interval = json_int(bench, "tcp_interval_ms", 20);
+    tcp_interval_ms = interval > 0 ? interval : 20;
+
+    cJSON *path = cJSON_GetObjectItem(bench, "results");
+    snprintf(results_path, sizeof(results_path), "%s", cJSON_IsString(path) ? path->valuestring : "");
+
+    cJSON *limits = cJSON_GetObjectItem(bench, "max_p99_ms");
+    for (int s = 0; s < GATEWAY_BENCH_STAGE_COUNT; s++) {
+        int limit = json_int(limits, stage_names[s], 0);
+        series[s].max_p99_ms = limit > 0 ? limit : 0;
+        if (series[s].used) {
+            series[s].samples_us = calloc(GATEWAY_BENCH_MAX_SAMPLES, sizeof(uint32_t));
+            if (series[s].samples_us == NULL) {
+                return ESP_ERR_NO_MEM;
+            }
+        }
+    }
+
+    bench_mutex = xSemaphoreCreateMutex();
+    if (bench_mutex == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    bench_enabled = true;
+    return ESP_OK;
+}
+
+bool gateway_bench_enabled(void)
+{
+    return bench_enabled;
+}
+
+// 某阶段观察到探针的值：是本次改写的新值且尚未记录时记下延迟
+static void observe(gateway_bench_stage_t stage, bench_probe_t *probe, uint16_t value, int64_t seen_us)
+{
+    xSemaphoreTake(bench_mutex, portMAX_DELAY);
+    if (probe->changed_us != 0 && !probe->seen[stage] && value == probe->value) {
+        bench_series_t *s = &series[stage];
+        probe->seen[stage] = true;
+        if (s->count < GATEWAY_BENCH_MAX_SAMPLES) {
+            int64_t latency = seen_us - probe->changed_us;
+            s->samples_us[s->count++] = latency > 0 ? (uint32_t)latency : 0;
+        }
+    }
+    xSemaphoreGive(bench_mutex);
+}
+
+// 改写探针为新值，上一次的值仍未被某阶段观察到时计为丢失
+static void change_probe(bench_probe_t *probe)
+{
+    xSemaphoreTake(bench_mutex, portMAX_DELAY);
+    if (probe->changed_us != 0) {
+        series[GATEWAY_BENCH_ACQUIRE].missed += !probe->seen[GATEWAY_BENCH_ACQUIRE];
+        series[GATEWAY_BENCH_TCP].missed += probe->tcp_addr >= 0 && !probe->seen[GATEWAY_BENCH_TCP];
+        series[GATEWAY_BENCH_MQTT].missed += probe->mqtt_index >= 0 && !probe->seen[GATEWAY_BENCH_MQTT];
+    }
+    // 新值在 0x4000~0x7FFF 间循环，按有符号16位解析时也不变号
+    probe->value = ((probe->value + 1) & 0x3FFF) | 0x4000;
+    probe->table[probe->slave_reg] = probe->value;
+    probe->changed_us = esp_timer_get_time();
+    memset(probe->seen, 0, sizeof(probe->seen));
+    changes++;
+    xSemaphoreGive(bench_mutex);
+}
+
+// 按间隔改写探针，每个tick检查数据存储中的采集结果
+static void bench_task(void *pvParameters)
+{
+    int64_t next_change_us = esp_timer_get_time();
+
+    while (1) {
+        int64_t now = esp_timer_get_time();
+        if (now >= next_change_us) {
+            next_change_us += (int64_t)change_interval_ms * 1000;
+            for (int i = 0; i < probe_count; i++) {
+                change_probe(&probes[i]);
+            }
+        }
+
+        // 采集延迟取数据存储中的采样时间戳，而不是本任务看到的时间
+        for (int i = 0; i < probe_count; i++) {
+            bench_probe_t *probe = &probes[i];
+            uint16_t value;
+            modbus_sample_t sample;
+            if (modbus_data_read_sample(probe->group, probe->function_code, probe->offset * sizeof(uint16_t),
+                                        &value, sizeof(value), &sample)) {
+                observe(GATEWAY_BENCH_ACQUIRE, probe, value, sample.sample_us);
+            }
+        }
+        vTaskDelay(1);
+    }
+}
+
+static int tcp_connect(void)
+{
+    struct sockaddr_in addr = {
+        .sin_family = AF_INET,
+        .sin_port = htons(tcp_slave.server_port),
+        .sin_addr.s_addr = htonl(INADDR_LOOPBACK),
+    };
+
+    int sock = socket(AF_INET, SOCK_STREAM, IPPROTO_IP);
+    if (sock < 0) {
+        return -1;
+    }
+    if (connect(sock, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+        close(sock);
+        return -1;
+    }
+    int nodelay = 1;
+    setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(nodelay));
+    fcntl(sock, F_SETFL, fcntl(sock, F_GETFL, 0) | O_NONBLOCK);
+    return sock;
+}
+
+// 发送请求并接收一个完整的MBAP帧，任务不能阻塞在系统调用上，非阻塞收发并按tick轮询
+static int tcp_transaction(int sock, agile_modbus_t *ctx, int send_len)
+{
+    if (send(sock, ctx->send_buf, send_len, 0) != send_len) {
+        return -1;
+    }
+
+    int len = 0;
+    int64_t deadline = esp_timer_get_time() + BENCH_TCP_TIMEOUT_MS * 1000LL;
+    while (esp_timer_get_time() < deadline) {
+        int rc = recv(sock, ctx->read_buf + len, ctx->read_bufsz - len, 0);
+        if (rc > 0) {
+            len += rc;
+            if (len >= 6 && len >= 6 + ((ctx->read_buf[4] << 8) | ctx->read_buf[5])) {
+                return len;
+            }
+            continue;
+        }
+        if (rc == 0 || errno != EAGAIN) {
+            return -1;
+        }
+        vTaskDelay(1);
+    }
+    return -1;
+}
+
+// 模拟SCADA客户端：轮流读取每个映射到TCP从站的探针
+static void tcp_client_task(void *pvParameters)
+{
+    uint8_t send_buf[AGILE_MODBUS_MAX_ADU_LENGTH];
+    uint8_t read_buf[AGILE_MODBUS_MAX_ADU_LENGTH];
+    agile_modbus_tcp_t ctx_tcp;
+    agile_modbus_t *ctx = &ctx_tcp._ctx;
+    int sock = -1;
+
+    agile_modbus_tcp_init(&ctx_tcp, send_buf, sizeof(send_buf), read_buf, sizeof(read_buf));
+    agile_modbus_set_slave(ctx, tcp_slave.slave_address);
+
+    while (1) {
+        if (sock < 0) {
+            sock = tcp_connect();
+            if (sock < 0) {
+                vTaskDelay(pdMS_TO_TICKS(100));
+                continue;
+            }
+        }
+
+        for (int i = 0; i < probe_count && sock >= 0; i++) {
+            bench_probe_t *probe = &probes[i];
+            if (probe->tcp_addr < 0) {
+                continue;
+            }
+
+            bool holding = probe->function_code == 3;
+            int send_len = holding ? agile_modbus_serialize_read_registers(ctx, probe->tcp_addr, 1)
+                                   : agile_modbus_serialize_read_input_registers(ctx, probe->tcp_addr, 1);
+            int read_len = tcp_transaction(sock, ctx, send_len);
+            uint16_t value;
+            int rc = -1;
+            if (read_len > 0) {
+                rc = holding ? agile_modbus_deserialize_read_registers(ctx, read_len, &value)
+                             : agile_modbus_deserialize_read_input_registers(ctx, read_len, &value);
+            }
+
+            xSemaphoreTake(bench_mutex, portMAX_DELAY);
+            tcp_requests++;
+            tcp_errors += rc < 0;
+            xSemaphoreGive(bench_mutex);
+
+            if (rc >= 0) {
+                observe(GATEWAY_BENCH_TCP, probe, value, esp_timer_get_time());
+            } else if (read_len < 0) {
+                close(sock);
+                sock = -1;
+            }
+        }
+        vTaskDelay(pdMS_TO_TICKS(tcp_interval_ms));
+    }
+}
+
+esp_err_t gateway_bench_start(void)
+{
+    start_us = esp_timer_get_time();
+    for (int port = 1; port <= BENCH_PORT_COUNT; port++) {
+        rtu_port_t *rtu = rtu_pty_port(rtu_pty_uart_num(port));
+        if (rtu) {
+            rtu_port_stats(rtu, &start_stats[port]);
+        }
+    }
+    for (int s = 0; s < PERF_STAGE_COUNT; s++) {
+        perf_stage_get(s, &start_cpu[s]);
+    }
+
+    if (xTaskCreate(bench_task, "bench", BENCH_TASK_STACK_SIZE, NULL, 13, NULL) != pdPASS) {
+        return ESP_ERR_NO_MEM;
+    }
+    for (int i = 0; i < tcp_clients; i++) {
+        char task_name[20];
+        snprintf(task_name, sizeof(task_name), "bench_tcp%d", i);
+        if (xTaskCreate(tcp_client_task, task_name, BENCH_TASK_STACK_SIZE, NULL, 9, NULL) != pdPASS) {
+            return ESP_ERR_NO_MEM;
+        }
+    }
+    ESP_LOGI(TAG, "Benchmark started: %d probes, change every %" PRIu32 " ms, %d TCP clients",
+             probe_count, change_interval_ms, tcp_clients);
+    return ESP_OK;
+}
+
+void gateway_bench_mqtt_payload(const char *payload, int64_t now_us)
+{
+    if (!bench_enabled || !series[GATEWAY_BENCH_MQTT].used) {
+        return;
+    }
+
+    cJSON *root = cJSON_Parse(payload);
+    if (root == NULL) {
+        ESP_LOGE(TAG, "MQTT payload is not valid JSON");
+        return;
+    }
+    for (int i = 0; i < probe_count; i++) {
+        bench_probe_t *probe = &probes[i];
+        if (probe->mqtt_index < 0) {
+            continue;
+        }
+        char key[16];
+        snprintf(key, sizeof(key), "group%d", probe->group);
+        cJSON *value = cJSON_GetArrayItem(cJSON_GetObjectItem(root, key), probe->mqtt_index);
+        if (cJSON_IsNumber(value)) {
+            observe(GATEWAY_BENCH_MQTT, probe, (uint16_t)value->valueint, now_us);
+        }
+    }
+    cJSON_Delete(root);
+}
+
+static int compare_u32(const void *a, const void *b)
+{
+    uint32_t x = *(const uint32_t *)a;
+    uint32_t y = *(const uint32_t *)b;
+    return (x > y) - (x < y);
+}
+
+// 排序后按最近秩取百分位
+static uint32_t percentile(const uint32_t *sorted, uint32_t count, int pct)
+{
+    return count ? sorted[(uint64_t)(count - 1) * pct / 100] : 0;
+}
+
+bool gateway_bench_finish(void)
+{
+    if (!bench_enabled) {
+        return true;
+    }
+
+    xSemaphoreTake(bench_mutex, portMAX_DELAY);
+    int64_t elapsed_us = esp_timer_get_time() - start_us;
+    double elapsed_s = elapsed_us / 1e6;
+    bool pass = true;
+
+    cJSON *root = cJSON_CreateObject();
+    cJSON_AddNumberToObject(root, "duration_s", elapsed_s);
+    cJSON_AddNumberToObject(root, "changes", changes);
+
+    cJSON *latency = cJSON_AddObjectToObject(root, "latency_ms");
+    for (int s = 0; s < GATEWAY_BENCH_STAGE_COUNT; s++) {
+        bench_series_t *ser = &series[s];
+        if (!ser->used) {
+            continue;
+        }
+        qsort(ser->samples_us, ser->count, sizeof(uint32_t), compare_u32);
+        double p50 = percentile(ser->samples_us, ser->count, 50) / 1000.0;
+        double p99 = percentile(ser->samples_us, ser->count, 99) / 1000.0;
+        double max = ser->count ? ser->samples_us[ser->count - 1] / 1000.0 : 0;
+        bool ok = ser->count > 0 && (ser->max_p99_ms == 0 || p99 <= ser->max_p99_ms);
+
+        cJSON *stage = cJSON_AddObjectToObject(latency, stage_names[s]);
+        cJSON_AddNumberToObject(stage, "samples", ser->count);
+        cJSON_AddNumberToObject(stage, "missed", ser->missed);
+        cJSON_AddNumberToObject(stage, "p50", p50);
+        cJSON_AddNumberToObject(stage, "p99", p99);
+        cJSON_AddNumberToObject(stage, "max", max);
+        ESP_LOGI(TAG, "%-8s %4" PRIu32 " samples, %3" PRIu32 " missed, p50 %.1f ms, p99 %.1f ms, max %.1f ms%s",
+                 stage_names[s], ser->count, ser->missed, p50, p99, max, ok ? "" : "  FAIL");
+        pass = pass && ok;
+    }
+
+    cJSON *ports = cJSON_AddArrayToObject(root, "ports");
+    for (int port = 1; port <= BENCH_PORT_COUNT; port++) {
+        rtu_port_t *rtu = rtu_pty_port(rtu_pty_uart_num(port));
+        rtu_port_stats_t stats;
+        if (rtu == NULL) {
+            continue;
+        }
+        rtu_port_stats(rtu, &stats);
+        uint32_t frames = stats.tx_frames - start_stats[port].tx_frames;
+        uint32_t timeouts = stats.rx_timeouts - start_stats[port].rx_timeouts;
+        if (frames == 0) {
+            continue;
+        }
+        cJSON *item = cJSON_CreateObject();
+        cJSON_AddNumberToObject(item, "port", port);
+        cJSON_AddNumberToObject(item, "transactions_per_s", frames / elapsed_s);
+        cJSON_AddNumberToObject(item, "timeouts", timeouts);
+        cJSON_AddNumberToObject(item, "rx_bytes", stats.rx_bytes - start_stats[port].rx_bytes);
+        cJSON_AddItemToArray(ports, item);
+        ESP_LOGI(TAG, "Port %d: %.1f transactions/s, %" PRIu32 " timeouts", port, frames / elapsed_s, timeouts);
+    }
+
+    cJSON *tcp = cJSON_AddObjectToObject(root, "tcp_clients");
+    cJSON_AddNumberToObject(tcp, "clients", tcp_clients);
+    cJSON_AddNumberToObject(tcp, "requests_per_s", tcp_requests / elapsed_s);
+    cJSON_AddNumberToObject(tcp, "errors", tcp_errors);
+
+    // CPU占用为阶段CPU时间占测试时长的百分比，多个任务同时执行同一阶段时可超过100
+    cJSON *cpu = cJSON_AddArrayToObject(root, "cpu");
+    for (int s = 0; s < PERF_STAGE_COUNT; s++) {
+        perf_stage_stats_t stats;
+        perf_stage_get(s, &stats);
+        uint64_t cpu_us = stats.cpu_us - start_cpu[s].cpu_us;
+        uint32_t calls = stats.calls - start_cpu[s].calls;
+        if (calls == 0) {
+            continue;
+        }
+        cJSON *item = cJSON_CreateObject();
+        cJSON_AddStringToObject(item, "stage", perf_stage_name(s));
+        cJSON_AddNumberToObject(item, "cpu_ms", cpu_us / 1000.0);
+        cJSON_AddNumberToObject(item, "calls", calls);
+        cJSON_AddNumberToObject(item, "us_per_call", (double)cpu_us / calls);
+        cJSON_AddNumberToObject(item, "cpu_percent", cpu_us / 1e4 / elapsed_s);
+        cJSON_AddItemToArray(cpu, item);
+        ESP_LOGI(TAG, "%-12s %8" PRIu32 " calls, %.1f us/call, %.2f%% CPU",
+                 perf_stage_name(s), calls, (double)cpu_us / calls, cpu_us / 1e4 / elapsed_s);
+    }
+    cJSON_AddBoolToObject(root, "pass", pass);
+    xSemaphoreGive(bench_mutex);
+
+    char *text = cJSON_PrintUnformatted(root);
+    cJSON_Delete(root);
+    if (text == NULL) {
+        return false;
+    }
+    // 结果单独成行，CI可直接从日志中取出
+    printf("BENCH_RESULT %s\n", text);
+    if (results_path[0] != '\0') {
+        FILE *f = fopen(results_path, "w");
+        if (f == NULL) {
+            ESP_LOGE(TAG, "Failed to write %s", results_path);
+            pass = false;
+        } else {
+            fprintf(f, "%s\n", text);
+            fclose(f);
+        }
+    }
+    free(text);
+    return pass;
+}
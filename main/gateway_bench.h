@@ -0,0 +1,43 @@
+#ifndef GATEWAY_BENCH_H
+#define GATEWAY_BENCH_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "cJSON.h"
+#include "mqtt.h"
+
+// 主机构建的端到端性能测试：周期性改写模拟从站的探针寄存器，测量数值变化到
+// 采集时间戳、TCP客户端FC03/FC04读到、MQTT负载中出现的延迟，
+// 同时统计各串口事务数和各处理阶段的CPU时间，结束时输出JSON结果
+
+#define GATEWAY_BENCH_MAX_PROBES 8
+#define GATEWAY_BENCH_MAX_SAMPLES 4096     // 每个阶段保留的延迟样本数
+
+// 测量的阶段
+typedef enum {
+    GATEWAY_BENCH_ACQUIRE,      // 变化到采集时间戳(收到包含新值的响应)
+    GATEWAY_BENCH_TCP,          // 变化到TCP客户端读到新值
+    GATEWAY_BENCH_MQTT,         // 变化到新值出现在生成的MQTT负载中
+    GATEWAY_BENCH_STAGE_COUNT
+} gateway_bench_stage_t;
+
+// 按JSON配置测试，须在轮询、TCP从站、MQTT配置和模拟从站都加载之后调用：
+// {"change_interval_ms":500,"tcp_clients":2,"tcp_interval_ms":20,
+//  "probes":[{"group":0,"offset":0}],"results":"bench_results.json",
+//  "max_p99_ms":{"acquire":300,"tcp":500,"mqtt":800}}
+// 探针为功能码03/04组中的一个寄存器，TCP和MQTT阶段按现有映射和发布配置(mqtt)自动确定
+esp_err_t gateway_bench_from_json(const cJSON *bench, const mqtt_config_t *mqtt);
+
+bool gateway_bench_enabled(void);
+
+// 启动改写探针和观察采集结果的任务以及TCP客户端任务，在轮询和TCP从站启动之后调用
+esp_err_t gateway_bench_start(void);
+
+// MQTT代理替身：接收一条生成的负载，查找其中的探针新值
+void gateway_bench_mqtt_payload(const char *payload, int64_t now_us);
+
+// 结束测试：统计结果写入配置的文件并打印，返回是否满足 max_p99_ms 等要求
+bool gateway_bench_finish(void);
+
+#endif
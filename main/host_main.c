@@ -0,0 +1,273 @@
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "cJSON.h"
+#include "gateway_bench.h"
+#include "modbus_config.h"
+#include "modbus_microbench.h"
+#include "modbus_task.h"
+#include "mqtt_payload.h"
+#include "perf_stage.h"
+#include "rtu_pty.h"
+#include "rtu_timing_test.h"
+#include "agile_modbus_test.h"
+#include "slave_sim.h"
+#include "tcp_server.h"
+#include "tcp_slave_regs.h"
+#include "write_queue.h"
+
+// 主机构建(linux target)入口：串口换成伪终端，另一端由模拟从站应答，
+// MQTT负载生成后打印到日志(性能测试时交给测试的代理替身)。配置文件路径由环境变量 GATEWAY_SIM_CONFIG 指定
+
+static const char *TAG = "host_main";
+
+#define HOST_CONFIG_ENV "GATEWAY_SIM_CONFIG"
+#define HOST_PORT_COUNT 3
+#define HOST_DEFAULT_BAUD 115200
+#define HOST_REPORT_INTERVAL_MS 5000
+#define HOST_LOOP_MS 10
+#define HOST_PAYLOAD_SIZE 8192
+
+// 主机上没有MQTT客户端，只生成负载，默认不发布
+static mqtt_config_t host_mqtt_config = {
+    .topic = "modbus/data",
+    .publish_interval = 5000,
+    .parse_methods = {[0 ... MAX_POLL_GROUPS - 1] = PARSE_INT16_UNSIGNED},
+};
+static mqtt_payload_state_t payload_state;
+static char payload_buf[HOST_PAYLOAD_SIZE];
+
+// 上次报告时各串口的统计，用于计算每秒事务数
+static rtu_port_stats_t last_stats[HOST_PORT_COUNT + 1];
+
+static cJSON *load_config_file(const char *path)
+{
+    FILE *f = fopen(path, "rb");
+    if (f == NULL) {
+        ESP_LOGE(TAG, "Failed to open %s", path);
+        return NULL;
+    }
+
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    char *content = malloc(size + 1);
+    if (content == NULL || fread(content, 1, size, f) != (size_t)size) {
+        fclose(f);
+        free(content);
+        return NULL;
+    }
+    content[size] = '\0';
+    fclose(f);
+
+    cJSON *root = cJSON_Parse(content);
+    free(content);
+    if (root == NULL) {
+        ESP_LOGE(TAG, "Invalid JSON in %s", path);
+    }
+    return root;
+}
+
+// 打开三个串口："ports":[{"port":1,"baud":9600,"device":"/dev/ttyUSB0"}]，
+// 未给出 device 时使用伪终端，有模拟从站的串口在伪终端另一端启动模拟从站
+static esp_err_t open_ports(const cJSON *ports)
+{
+    uint32_t baud[HOST_PORT_COUNT + 1];
+    const char *device[HOST_PORT_COUNT + 1] = {NULL};
+
+    for (int port = 1; port <= HOST_PORT_COUNT; port++) {
+        baud[port] = HOST_DEFAULT_BAUD;
+    }
+
+    const cJSON *item;
+    cJSON_ArrayForEach(item, ports) {
+        cJSON *port = cJSON_GetObjectItem(item, "port");
+        cJSON *baud_rate = cJSON_GetObjectItem(item, "baud");
+        cJSON *dev = cJSON_GetObjectItem(item, "device");
+        if (!cJSON_IsNumber(port) || port->valueint < 1 || port->valueint > HOST_PORT_COUNT) {
+            continue;
+        }
+        if (cJSON_IsNumber(baud_rate) && baud_rate->valueint > 0) {
+            baud[port->valueint] = baud_rate->valueint;
+        }
+        if (cJSON_IsString(dev)) {
+            device[port->valueint] = dev->valuestring;
+        }
+    }
+
+    for (int port = 1; port <= HOST_PORT_COUNT; port++) {
+        int uart_num = rtu_pty_uart_num(port);
+        esp_err_t err = rtu_pty_open(uart_num, baud[port], device[port]);
+        if (err != ESP_OK) {
+            return err;
+        }
+        if (slave_sim_count(port) == 0) {
+            continue;
+        }
+        if (rtu_pty_peer_name(uart_num) == NULL) {
+            ESP_LOGW(TAG, "Port %d uses %s, simulated slaves ignored", port, device[port]);
+            continue;
+        }
+        err = slave_sim_start(port, rtu_pty_peer_name(uart_num), baud[port]);
+        if (err != ESP_OK) {
+            return err;
+        }
+    }
+    return ESP_OK;
+}
+
+// 打印各串口每秒事务数和模拟从站统计
+static void report(int64_t elapsed_us)
+{
+    for (int port = 1; port <= HOST_PORT_COUNT; port++) {
+        rtu_port_t *rtu = rtu_pty_port(rtu_pty_uart_num(port));
+        rtu_port_stats_t stats;
+
+        rtu_port_stats(rtu, &stats);
+        uint32_t frames = stats.tx_frames - last_stats[port].tx_frames;
+        uint32_t timeouts = stats.rx_timeouts - last_stats[port].rx_timeouts;
+        last_stats[port] = stats;
+        if (frames == 0 || elapsed_us <= 0) {
+            continue;
+        }
+        ESP_LOGI(TAG, "Port %d: %.1f transactions/s, %" PRIu32 " timeouts, %" PRIu32 " bytes received",
+                 port, frames * 1e6 / elapsed_us, timeouts, stats.rx_bytes);
+    }
+    slave_sim_log_stats();
+}
+
+// 所有启用的组是否都至少采集过一次
+static bool all_groups_sampled(void)
+{
+    bool ok = true;
+    for (int i = 0; i < modbus_config.group_count; i++) {
+        if (modbus_config.groups[i].enabled && modbus_data_sample_seq(i) == 0) {
+            ESP_LOGE(TAG, "Group %d was never polled", i);
+            ok = false;
+        }
+    }
+    return ok;
+}
+
+void app_main(void)
+{
+    const char *path = getenv(HOST_CONFIG_ENV);
+    if (path == NULL) {
+        ESP_LOGE(TAG, "Set %s to the simulation config file", HOST_CONFIG_ENV);
+        exit(2);
+    }
+    cJSON *root = load_config_file(path);
+    if (root == NULL) {
+        exit(2);
+    }
+
+    // 微基准只测协议库本身，不启动网关
+    cJSON *item = cJSON_GetObjectItem(root, "microbench");
+    if (item) {
+        bool ok = modbus_microbench_run(item);
+        cJSON_Delete(root);
+        exit(ok ? 0 : 1);
+    }
+
+    // 时序测试只测 rtu_timing 的计算，不启动网关
+    item = cJSON_GetObjectItem(root, "rtu_timing_test");
+    if (item) {
+        bool ok = rtu_timing_test_run();
+        cJSON_Delete(root);
+        exit(ok ? 0 : 1);
+    }
+
+    // 协议库测试只测CRC和位复制，不启动网关
+    item = cJSON_GetObjectItem(root, "agile_modbus_test");
+    if (item) {
+        bool ok = agile_modbus_test_run();
+        cJSON_Delete(root);
+        exit(ok ? 0 : 1);
+    }
+
+    // 配置文件各部分与对应的 HTTP 接口字段相同
+    item = cJSON_GetObjectItem(root, "modbus");
+    if (item) {
+        modbus_config_from_json(item);
+    }
+    item = cJSON_GetObjectItem(root, "tcp_slave");
+    if (item) {
+        tcp_slave_config_from_json(&tcp_slave, item);
+    }
+    item = cJSON_GetObjectItem(root, "mqtt");
+    if (item) {
+        mqtt_config_from_json(&host_mqtt_config, item);
+    }
+
+    item = cJSON_GetObjectItem(root, "seed");
+    uint32_t seed = cJSON_IsNumber(item) ? (uint32_t)item->valueint : 1;
+    item = cJSON_GetObjectItem(root, "duration_ms");
+    int64_t duration_us = cJSON_IsNumber(item) ? (int64_t)item->valueint * 1000 : 0;
+    item = cJSON_GetObjectItem(root, "report_interval_ms");
+    int64_t report_us = (cJSON_IsNumber(item) && item->valueint > 0 ? item->valueint : HOST_REPORT_INTERVAL_MS) * 1000LL;
+
+    item = cJSON_GetObjectItem(root, "slaves");
+    if (item && slave_sim_from_json(item, seed) != ESP_OK) {
+        exit(2);
+    }
+    if (open_ports(cJSON_GetObjectItem(root, "ports")) != ESP_OK) {
+        exit(2);
+    }
+    // 性能测试按运行时长结束并输出结果
+    item = cJSON_GetObjectItem(root, "bench");
+    if (item && (duration_us == 0 || gateway_bench_from_json(item, &host_mqtt_config) != ESP_OK)) {
+        ESP_LOGE(TAG, "Invalid benchmark config (duration_ms is required)");
+        exit(2);
+    }
+    cJSON_Delete(root);
+
+    ESP_ERROR_CHECK(write_queue_init());
+    start_modbus();
+    if (tcp_slave.enabled) {
+        ESP_LOGI(TAG, "Starting Modbus tcp on port %d", tcp_slave.server_port);
+        start_tcp_server();
+    }
+    if (gateway_bench_enabled()) {
+        ESP_ERROR_CHECK(gateway_bench_start());
+    }
+
+    int64_t start_us = esp_timer_get_time();
+    int64_t last_report_us = start_us;
+    int64_t last_publish_us = start_us;
+
+    while (1) {
+        vTaskDelay(pdMS_TO_TICKS(HOST_LOOP_MS));
+        int64_t now = esp_timer_get_time();
+
+        if (host_mqtt_config.enabled && host_mqtt_config.group_count > 0 &&
+            now - last_publish_us >= (int64_t)host_mqtt_config.publish_interval * 1000) {
+            last_publish_us = now;
+            int64_t cpu = perf_stage_begin();
+            int len = mqtt_payload_build(&host_mqtt_config, &payload_state, payload_buf, sizeof(payload_buf), now);
+            perf_stage_end(PERF_STAGE_MQTT_BUILD, cpu);
+            if (len > 0 && gateway_bench_enabled()) {
+                gateway_bench_mqtt_payload(payload_buf, now);
+            } else if (len > 0) {
+                ESP_LOGI(TAG, "MQTT %s: %s", host_mqtt_config.topic, payload_buf);
+            }
+        }
+
+        if (now - last_report_us >= report_us) {
+            report(now - last_report_us);
+            last_report_us = now;
+        }
+
+        // 指定运行时长时到期退出，供CI判断：所有启用的组都采集过才算成功
+        if (duration_us > 0 && now - start_us >= duration_us) {
+            report(now - last_report_us);
+            bool ok = all_groups_sampled();
+            ok = gateway_bench_finish() && ok;
+            exit(ok ? 0 : 1);
+        }
+    }
+}
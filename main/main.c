@@ -12,6 +12,7 @@
 #include "mqtt.h" 
 #include "tcp_server.h"
 #include "tcp_slave_regs.h"
+#include "write_queue.h"
 
 // 日志标签
 static const char* TAG = "main";
@@ -90,6 +91,8 @@ void app_main(void) {
 
     // 初始化串口
     ESP_ERROR_CHECK(uart_init());
+    // 初始化写命令队列(HTTP/MQTT/TCP写入现场设备)
+    ESP_ERROR_CHECK(write_queue_init());
     
     // 创建事件组用于 WiFi 连接同步
     s_wifi_ev = xEventGroupCreate();
@@ -1,6 +1,21 @@
+#include <stdlib.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "sdkconfig.h"
+#include "esp_heap_caps.h"
+#if !CONFIG_IDF_TARGET_LINUX
+#include "esp_memory_utils.h"
+#endif
 #include "modbus_config.h"
+#include "agile_modbus.h"
 #include "nvs_flash.h"
 #include "esp_log.h"
+#include "esp_timer.h"
+
+// 读端连续重试多少次仍未得到一致快照(写端等待切换数据区多少次)后让出CPU，避免同核低优先级的一方无法完成
+#define SEQLOCK_SPIN_LIMIT 16
 
 // 日志标签
 static const char* TAG = "modbus_config";
@@ -8,6 +23,9 @@ static const char* TAG = "modbus_config";
 // 定义modbus默认配置
 modbus_config_t modbus_config = {
     .poll_interval = 300,
+    .coalesce = true,
+    .coalesce_gap = 0,
+    .broadcast_delay_ms = BROADCAST_DELAY_DEFAULT_MS,
     .group_count = 3,
     .groups = {
         {.enabled = true, .slave_addr = 10, .function_code = 1, .start_addr = 0, .reg_count = 20, .uart_port = 1},
@@ -18,6 +36,348 @@ modbus_config_t modbus_config = {
 
 modbus_data_t modbus_data = {0};
 
+volatile uint32_t modbus_config_generation = 0;
+
+uint32_t modbus_group_period_ms(const poll_group_config_t *group)
+{
+    return group->poll_period ? group->poll_period : modbus_config.poll_interval;
+}
+
+void modbus_config_changed(void)
+{
+    modbus_data_layout();
+    modbus_config_generation++;
+}
+
+// 所有组数据区所在的内存块
+static uint8_t *data_arena = NULL;
+// 串行化数据区重新划分(只在配置变更时使用，写端和读端都不取)
+static SemaphoreHandle_t layout_lock = NULL;
+// 读端纪元：读端开始前在当前纪元的计数上加一，结束后减一。
+// 重新划分后切换纪元，等旧纪元的读端全部结束才释放旧数据区
+static volatile uint32_t arena_epoch;
+static volatile uint32_t arena_readers[2];
+
+// 本次写区间内变化的个数，写端在 write_end 时据此更新版本号
+static int pending_changes[MAX_POLL_GROUPS];
+// 各消费者登记的通知任务
+static TaskHandle_t listeners[MODBUS_CONSUMER_COUNT];
+
+// 取得组的写端：计数由偶数原子地变为奇数后再写数据，读端看到奇数或前后计数不同即重读。
+// 每组只有所属的轮询任务写入，只在重新划分切换该组数据区的几次赋值期间会等待，不涉及其他组
+static void seq_begin(int group)
+{
+    int spins = 0;
+
+    while (1) {
+        uint32_t seq = __atomic_load_n(&modbus_data.seq[group], __ATOMIC_RELAXED);
+        if (!(seq & 1) && __atomic_compare_exchange_n(&modbus_data.seq[group], &seq, seq + 1, false,
+                                                      __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+            break;
+        }
+        // 切换方可能被抢占，自旋若干次后让出CPU
+        if (++spins > SEQLOCK_SPIN_LIMIT) {
+            vTaskDelay(1);
+            spins = 0;
+        }
+    }
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+static void seq_end(int group)
+{
+    __atomic_store_n(&modbus_data.seq[group], modbus_data.seq[group] + 1, __ATOMIC_RELEASE);
+}
+
+// 组数据区字节数：位按字节打包，寄存器每个2字节
+static size_t group_area_size(const poll_group_config_t *group)
+{
+    switch (group->function_code) {
+    case 1:
+    case 2:
+        return (group->reg_count < MAX_BITS ? group->reg_count + 7 : MAX_BITS + 7) / 8;
+    case 3:
+    case 4:
+        return (group->reg_count < MAX_REGS ? group->reg_count : MAX_REGS) * sizeof(uint16_t);
+    default:
+        return 0;
+    }
+}
+
+// 数据区所在内存，仅用于日志
+static const char *arena_location(const void *arena)
+{
+#if CONFIG_IDF_TARGET_LINUX
+    return "host memory";
+#else
+    return (arena && esp_ptr_external_ram(arena)) ? "PSRAM" : "internal RAM";
+#endif
+}
+
+esp_err_t modbus_data_layout(void)
+{
+    size_t offsets[MAX_POLL_GROUPS] = {0};
+    size_t total = 0;
+    int count = modbus_config.group_count < MAX_POLL_GROUPS ? modbus_config.group_count : MAX_POLL_GROUPS;
+
+    if (layout_lock == NULL) {
+        layout_lock = xSemaphoreCreateMutex();
+        if (layout_lock == NULL) {
+            return ESP_ERR_NO_MEM;
+        }
+    }
+
+    // 各组数据区按4字节对齐紧密排列，只分配配置实际需要的大小
+    for (int g = 0; g < count; g++) {
+        offsets[g] = total;
+        total += (group_area_size(&modbus_config.groups[g]) + 3) & ~(size_t)3;
+    }
+
+    uint8_t *arena = NULL;
+    if (total > 0) {
+        arena = heap_caps_calloc(1, total, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+        if (arena == NULL) {
+            arena = heap_caps_calloc(1, total, MALLOC_CAP_8BIT);
+        }
+        if (arena == NULL) {
+            ESP_LOGE(TAG, "Failed to allocate %u bytes for group data", (unsigned)total);
+            return ESP_ERR_NO_MEM;
+        }
+    }
+
+    // 逐组取得该组的写端后切换数据区：正在写该组的轮询任务写完后才切换，
+    // 之后的写入和读取都使用新数据区。其他组的写入不受影响
+    xSemaphoreTake(layout_lock, portMAX_DELAY);
+    for (int g = 0; g < MAX_POLL_GROUPS; g++) {
+        size_t size = (g < count) ? group_area_size(&modbus_config.groups[g]) : 0;
+        seq_begin(g);
+        modbus_data.area[g] = size ? arena + offsets[g] : NULL;
+        modbus_data.area_size[g] = size;
+        modbus_data.area_fc[g] = size ? modbus_config.groups[g].function_code : 0;
+        modbus_data.register_ready[g] = false;
+        seq_end(g);
+    }
+    uint8_t *old = data_arena;
+    data_arena = arena;
+
+    // 此后开始的读端只能取到新数据区；旧纪元中的读端可能仍在拷贝旧数据区，等它们结束再释放
+    uint32_t old_epoch = __atomic_fetch_add(&arena_epoch, 1, __ATOMIC_SEQ_CST) & 1;
+    while (__atomic_load_n(&arena_readers[old_epoch], __ATOMIC_ACQUIRE) != 0) {
+        vTaskDelay(1);
+    }
+    free(old);
+    xSemaphoreGive(layout_lock);
+
+    ESP_LOGI(TAG, "Group data: %d groups, %u bytes in %s", count, (unsigned)total, arena_location(arena));
+    return ESP_OK;
+}
+
+void modbus_data_write_begin(int group)
+{
+    seq_begin(group);
+    pending_changes[group] = 0;
+}
+
+void modbus_data_write_end(int group)
+{
+    bool changed = pending_changes[group] > 0;
+
+    if (changed) {
+        modbus_data.changed_us[group] = esp_timer_get_time();
+        __atomic_store_n(&modbus_data.version[group], modbus_data.version[group] + 1, __ATOMIC_RELAXED);
+    }
+    seq_end(group);
+
+    // 数据已对读端可见后再通知，消费者醒来即可读到新值
+    if (changed) {
+        for (int c = 0; c < MODBUS_CONSUMER_COUNT; c++) {
+            TaskHandle_t task = __atomic_load_n(&listeners[c], __ATOMIC_ACQUIRE);
+            if (task) {
+                xTaskNotifyGive(task);
+            }
+        }
+    }
+}
+
+void modbus_data_set_listener(modbus_consumer_t consumer, TaskHandle_t task)
+{
+    __atomic_store_n(&listeners[consumer], task, __ATOMIC_RELEASE);
+}
+
+void *modbus_data_area(int group, uint8_t function_code, size_t *size)
+{
+    if (modbus_data.area[group] == NULL || modbus_data.area_fc[group] != function_code) {
+        *size = 0;
+        return NULL;
+    }
+    *size = modbus_data.area_size[group];
+    return modbus_data.area[group];
+}
+
+// 为所有消费者标记第 unit 个单元已变化
+static void mark_dirty(int group, int unit)
+{
+    if (unit >= DIRTY_UNITS) {
+        return;
+    }
+    for (int c = 0; c < MODBUS_CONSUMER_COUNT; c++) {
+        __atomic_fetch_or(&modbus_data.dirty[c][group][unit / 32], 1UL << (unit % 32), __ATOMIC_RELAXED);
+    }
+}
+
+int modbus_data_update_regs(int group, uint16_t *dst, const uint8_t *src, int count, bool force)
+{
+    int changes = 0;
+
+    // 直接从响应帧中的大端数据解码比较，不经过中间缓冲区
+    for (int i = 0; i < count; i++) {
+        uint16_t value = (uint16_t)((src[2 * i] << 8) | src[2 * i + 1]);
+        if (force || dst[i] != value) {
+            dst[i] = value;
+            mark_dirty(group, i);
+            changes++;
+        }
+    }
+    pending_changes[group] += changes;
+    return changes;
+}
+
+int modbus_data_update_bits(int group, uint8_t *dst, const uint8_t *src, int src_bit, int count, bool force)
+{
+    int changes = 0;
+
+    // 每次取出32位与旧值比较，有变化的字节才写入并标记
+    for (int pos = 0; pos < count; pos += 32) {
+        int nb = (count - pos < 32) ? count - pos : 32;
+        int base = pos / 8;
+        int bytes = (nb + 7) / 8;
+        uint8_t chunk[4];
+
+        memcpy(chunk, &dst[base], bytes);
+        agile_modbus_copy_packed_bits(chunk, src, src_bit + pos, nb);
+        for (int i = 0; i < bytes; i++) {
+            if (force || dst[base + i] != chunk[i]) {
+                dst[base + i] = chunk[i];
+                mark_dirty(group, base + i);
+                changes++;
+            }
+        }
+    }
+    pending_changes[group] += changes;
+    return changes;
+}
+
+void modbus_data_set_sample(int group, modbus_quality_t quality, int64_t sample_us, uint32_t latency_us)
+{
+    modbus_sample_t *sample = &modbus_data.sample[group];
+
+    // 离线跳过时没有新的采集，只更新质量
+    if (quality != MODBUS_QUALITY_STALE) {
+        __atomic_store_n(&sample->seq, sample->seq + 1, __ATOMIC_RELEASE);
+        sample->sample_us = sample_us;
+        sample->latency_us = latency_us;
+    }
+    sample->quality = quality;
+}
+
+uint32_t modbus_data_sample_seq(int group)
+{
+    return __atomic_load_n(&modbus_data.sample[group].seq, __ATOMIC_ACQUIRE);
+}
+
+const char *modbus_quality_name(uint8_t quality)
+{
+    switch (quality) {
+    case MODBUS_QUALITY_GOOD:
+        return "good";
+    case MODBUS_QUALITY_STALE:
+        return "stale";
+    case MODBUS_QUALITY_TIMEOUT:
+        return "timeout";
+    case MODBUS_QUALITY_EXCEPTION:
+        return "exception";
+    default:
+        return "none";
+    }
+}
+
+bool modbus_data_take_dirty(modbus_consumer_t consumer, int group, uint32_t dirty[DIRTY_WORDS])
+{
+    bool any = false;
+
+    for (int w = 0; w < DIRTY_WORDS; w++) {
+        uint32_t bits = __atomic_exchange_n(&modbus_data.dirty[consumer][group][w], 0, __ATOMIC_ACQUIRE);
+        if (dirty) {
+            dirty[w] = bits;
+        }
+        any |= (bits != 0);
+    }
+    return any;
+}
+
+uint32_t modbus_data_version(int group)
+{
+    return __atomic_load_n(&modbus_data.version[group], __ATOMIC_ACQUIRE);
+}
+
+bool modbus_data_read(int group, uint8_t function_code, size_t offset, void *dest, size_t len)
+{
+    return modbus_data_read_sample(group, function_code, offset, dest, len, NULL);
+}
+
+bool modbus_data_read_sample(int group, uint8_t function_code, size_t offset, void *dest, size_t len,
+                             modbus_sample_t *sample)
+{
+    uint32_t begin, end;
+    bool ready = false;
+    int spins = 0;
+
+    if (group < 0 || group >= MAX_POLL_GROUPS) {
+        return false;
+    }
+
+    // 登记为当前纪元的读端，重新划分在本次读取结束前不会释放读到的数据区。
+    // 读取纪元和登记之间可能已有重新划分切换纪元并释放了旧数据区，登记后纪元未变才有效，否则撤销重试
+    uint32_t epoch;
+    while (1) {
+        uint32_t current = __atomic_load_n(&arena_epoch, __ATOMIC_SEQ_CST);
+        epoch = current & 1;
+        __atomic_fetch_add(&arena_readers[epoch], 1, __ATOMIC_SEQ_CST);
+        if (__atomic_load_n(&arena_epoch, __ATOMIC_SEQ_CST) == current) {
+            break;
+        }
+        __atomic_fetch_sub(&arena_readers[epoch], 1, __ATOMIC_RELEASE);
+    }
+
+    do {
+        if (++spins > SEQLOCK_SPIN_LIMIT) {
+            vTaskDelay(1);
+            spins = 0;
+        }
+        begin = __atomic_load_n(&modbus_data.seq[group], __ATOMIC_ACQUIRE);
+        if (begin & 1) {
+            continue;
+        }
+        // 数据区可能被重新划分，位置和大小也在顺序锁内读取
+        const uint8_t *area = modbus_data.area[group];
+        size_t size = modbus_data.area_size[group];
+        ready = area != NULL && modbus_data.area_fc[group] == function_code &&
+                offset <= size && len <= size - offset;
+        if (ready) {
+            memcpy(dest, area + offset, len);
+            if (sample) {
+                *sample = modbus_data.sample[group];
+            }
+            ready = modbus_data.register_ready[group];
+        }
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        end = __atomic_load_n(&modbus_data.seq[group], __ATOMIC_RELAXED);
+    } while ((begin & 1) || begin != end);
+
+    __atomic_fetch_sub(&arena_readers[epoch], 1, __ATOMIC_RELEASE);
+    return ready;
+}
+
 // 保存配置到NVS
 esp_err_t save_modbus_config_to_nvs(void)
 {
@@ -46,6 +406,15 @@ esp_err_t save_modbus_config_to_nvs(void)
         return err;
     }
 
+    err = nvs_set_u8(nvs_handle, "coalesce", modbus_config.coalesce);
+    err |= nvs_set_u16(nvs_handle, "coalesce_gap", modbus_config.coalesce_gap);
+    err |= nvs_set_u16(nvs_handle, "bcast_delay", modbus_config.broadcast_delay_ms);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Error saving coalesce config: %s", esp_err_to_name(err));
+        nvs_close(nvs_handle);
+        return err;
+    }
+
     // 保存每个轮询组的配置
     for (int i = 0; i < modbus_config.group_count; i++) {
         char key[32];
@@ -68,6 +437,12 @@ esp_err_t save_modbus_config_to_nvs(void)
         
         snprintf(key, sizeof(key), "group%d_uart", i);
         err |= nvs_set_u8(nvs_handle, key, modbus_config.groups[i].uart_port);
+
+        snprintf(key, sizeof(key), "group%d_period", i);
+        err |= nvs_set_u32(nvs_handle, key, modbus_config.groups[i].poll_period);
+
+        snprintf(key, sizeof(key), "group%d_prio", i);
+        err |= nvs_set_u8(nvs_handle, key, modbus_config.groups[i].priority);
         
         if (err != ESP_OK) {
             ESP_LOGE(TAG, "Error saving group %d config: %s", i, esp_err_to_name(err));
@@ -106,6 +481,21 @@ esp_err_t load_modbus_config_from_nvs(void)
         modbus_config.poll_interval = poll_interval;
     }
 
+    uint8_t coalesce;
+    if (nvs_get_u8(nvs_handle, "coalesce", &coalesce) == ESP_OK) {
+        modbus_config.coalesce = coalesce;
+    }
+
+    uint16_t coalesce_gap;
+    if (nvs_get_u16(nvs_handle, "coalesce_gap", &coalesce_gap) == ESP_OK) {
+        modbus_config.coalesce_gap = coalesce_gap;
+    }
+
+    uint16_t broadcast_delay_ms;
+    if (nvs_get_u16(nvs_handle, "bcast_delay", &broadcast_delay_ms) == ESP_OK) {
+        modbus_config.broadcast_delay_ms = broadcast_delay_ms;
+    }
+
     uint8_t group_count;
     err = nvs_get_u8(nvs_handle, "group_count", &group_count);
     if (err == ESP_OK && group_count <= MAX_POLL_GROUPS) {
@@ -117,6 +507,7 @@ esp_err_t load_modbus_config_from_nvs(void)
         char key[32];
         uint8_t u8_val;
         uint16_t u16_val;
+        uint32_t u32_val;
         
         // 读取每个字段
         snprintf(key, sizeof(key), "group%d_enabled", i);
@@ -148,8 +539,134 @@ esp_err_t load_modbus_config_from_nvs(void)
         if (nvs_get_u8(nvs_handle, key, &u8_val) == ESP_OK) {
             modbus_config.groups[i].uart_port = u8_val;
         }
+
+        snprintf(key, sizeof(key), "group%d_period", i);
+        if (nvs_get_u32(nvs_handle, key, &u32_val) == ESP_OK) {
+            modbus_config.groups[i].poll_period = u32_val;
+        }
+
+        snprintf(key, sizeof(key), "group%d_prio", i);
+        if (nvs_get_u8(nvs_handle, key, &u8_val) == ESP_OK) {
+            modbus_config.groups[i].priority = u8_val;
+        }
     }
 
     nvs_close(nvs_handle);
     return ESP_OK;
-}
\ No newline at end of file
+}
+
+// 从JSON更新轮询配置，缺少的字段保持不变
+void modbus_config_from_json(const cJSON *root)
+{
+    cJSON *poll_interval = cJSON_GetObjectItem(root, "poll_interval");
+    cJSON *coalesce = cJSON_GetObjectItem(root, "coalesce");
+    cJSON *coalesce_gap = cJSON_GetObjectItem(root, "coalesce_gap");
+    cJSON *broadcast_delay_ms = cJSON_GetObjectItem(root, "broadcast_delay_ms");
+    cJSON *groups = cJSON_GetObjectItem(root, "groups");
+
+    if (poll_interval)
+        modbus_config.poll_interval = poll_interval->valueint;
+    if (coalesce)
+        modbus_config.coalesce = cJSON_IsTrue(coalesce);
+    if (coalesce_gap && coalesce_gap->valueint >= 0)
+        modbus_config.coalesce_gap = coalesce_gap->valueint;
+    if (broadcast_delay_ms && broadcast_delay_ms->valueint >= 0)
+        modbus_config.broadcast_delay_ms = broadcast_delay_ms->valueint;
+
+    if (groups && cJSON_IsArray(groups))
+    {
+        int array_size = cJSON_GetArraySize(groups);
+        // 直接使用数组大小作为group_count
+        modbus_config.group_count = array_size;
+        if (modbus_config.group_count > MAX_POLL_GROUPS)
+        {
+            modbus_config.group_count = MAX_POLL_GROUPS;
+        }
+
+        for (int i = 0; i < modbus_config.group_count; i++)
+        {
+            cJSON *group = cJSON_GetArrayItem(groups, i);
+            cJSON *enabled = cJSON_GetObjectItem(group, "enabled");
+            cJSON *slave_addr = cJSON_GetObjectItem(group, "slave_addr");
+            cJSON *function_code = cJSON_GetObjectItem(group, "function_code");
+            cJSON *start_addr = cJSON_GetObjectItem(group, "start_addr");
+            cJSON *reg_count = cJSON_GetObjectItem(group, "reg_count");
+            cJSON *uart_port = cJSON_GetObjectItem(group, "uart_port");
+            cJSON *poll_period = cJSON_GetObjectItem(group, "poll_period");
+            cJSON *priority = cJSON_GetObjectItem(group, "priority");
+
+            if (enabled)
+                modbus_config.groups[i].enabled = enabled->valueint;
+            if (slave_addr)
+            {
+                int addr = slave_addr->valueint;
+                if (addr >= 1 && addr <= 247)
+                {
+                    modbus_config.groups[i].slave_addr = addr;
+                }
+            }
+            if (function_code)
+            {
+                int fc = 0;
+                if (cJSON_IsNumber(function_code))
+                {
+                    fc = function_code->valueint;
+                }
+                else if (cJSON_IsString(function_code))
+                {
+                    fc = atoi(function_code->valuestring);
+                }
+
+                if (fc >= 1 && fc <= 4)
+                {
+                    modbus_config.groups[i].function_code = fc;
+                }
+            }
+            if (start_addr)
+            {
+                // 处理空字符串的情况
+                if (cJSON_IsString(start_addr) && strlen(start_addr->valuestring) == 0)
+                {
+                    modbus_config.groups[i].start_addr = 0;
+                }
+                else if (cJSON_IsNumber(start_addr))
+                {
+                    modbus_config.groups[i].start_addr = start_addr->valueint;
+                }
+                else if (cJSON_IsString(start_addr))
+                {
+                    modbus_config.groups[i].start_addr = atoi(start_addr->valuestring);
+                }
+            }
+            if (reg_count)
+            {
+                // 线圈/离散输入每组最多2000位，寄存器每组最多125个
+                int max_count = (modbus_config.groups[i].function_code == 1 ||
+                                 modbus_config.groups[i].function_code == 2) ? MAX_BITS : MAX_REGS;
+                modbus_config.groups[i].reg_count = reg_count->valueint;
+                if (modbus_config.groups[i].reg_count > max_count)
+                {
+                    modbus_config.groups[i].reg_count = max_count;
+                }
+            }
+            if (uart_port)
+            {
+                int port = uart_port->valueint;
+                if (port == 1 || port == 2 || port == 3)
+                {
+                    modbus_config.groups[i].uart_port = port;
+                }
+            }
+            if (poll_period && cJSON_IsNumber(poll_period))
+            {
+                // 0 表示使用全局轮询间隔
+                modbus_config.groups[i].poll_period = poll_period->valueint > 0 ? poll_period->valueint : 0;
+            }
+            if (priority && cJSON_IsNumber(priority))
+            {
+                int prio = priority->valueint;
+                modbus_config.groups[i].priority = prio < 0 ? 0 : (prio > 255 ? 255 : prio);
+            }
+        }
+    }
+}
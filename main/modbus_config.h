@@ -2,12 +2,18 @@
 #define MODBUS_CONFIG_H
 
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
 #include "esp_err.h"
+#include "cJSON.h"
 
 #define MAX_REGS 125       //一次轮询读取最大寄存器个数
-#define MAX_BITS 256   // 最大位数
-#define MAX_POLL_GROUPS 10 //最大轮询组
+#define MAX_BITS 2000  // 单组最大位数(协议上限)
+#define MAX_BIT_BYTES ((MAX_BITS + 7) / 8)  // 单组位数据打包后的最大字节数
+#define MAX_POLL_GROUPS 64 //最大轮询组
+#define BROADCAST_DELAY_DEFAULT_MS 100  // 广播转换延时默认值，协议建议100~200ms
 
 // 轮询组配置结构体
 typedef struct {
@@ -17,27 +23,110 @@ typedef struct {
     uint16_t start_addr;
     uint16_t reg_count;
     uint8_t uart_port;
+    uint32_t poll_period;   // 轮询周期(ms)，0 表示使用全局 poll_interval
+    uint8_t priority;       // 优先级，截止时间相同时数值大的先轮询
 } poll_group_config_t;
 
 // Modbus总体配置结构体
 typedef struct {
     uint32_t poll_interval;
+    bool coalesce;          // 是否合并相邻的轮询组
+    uint16_t coalesce_gap;  // 合并时允许跨越的未配置寄存器/位数
+    uint16_t broadcast_delay_ms; // 广播写入发送完毕并经过t3.5后，再留给从站处理的转换延时
     uint8_t group_count;
     poll_group_config_t groups[MAX_POLL_GROUPS];
 } modbus_config_t;
 
+// 变化跟踪粒度：寄存器组按寄存器，线圈/离散输入组按字节(8个位)
+#define DIRTY_UNITS 256
+#define DIRTY_WORDS (DIRTY_UNITS / 32)
+
+// 需要逐寄存器增量处理的数据消费者，各自维护独立的脏位图，互不影响；
+// 只需判断整组是否变化的消费者比较 version 即可
+typedef enum {
+    MODBUS_CONSUMER_TCP,
+    MODBUS_CONSUMER_COUNT
+} modbus_consumer_t;
+
+// 采样质量
+typedef enum {
+    MODBUS_QUALITY_NONE = 0,    // 尚未采集
+    MODBUS_QUALITY_GOOD,        // 正常响应
+    MODBUS_QUALITY_STALE,       // 从站离线暂停轮询，数据为最后一次采集结果
+    MODBUS_QUALITY_TIMEOUT,     // 读取超时
+    MODBUS_QUALITY_EXCEPTION,   // 异常响应或响应解析失败
+} modbus_quality_t;
+
+// 每组最近一次采集的采样信息
+typedef struct {
+    uint32_t seq;           // 采样序号，每次采集(无论成功失败)递增，离线跳过不递增
+    int64_t sample_us;      // 采集时间(esp_timer)，成功时为收到响应的时刻
+    uint32_t latency_us;    // 从发出请求到收到响应(或判定超时)的时间
+    uint8_t quality;        // modbus_quality_t
+} modbus_sample_t;
+
 // Modbus数据存储结构体
 typedef struct {
-    uint8_t coils[MAX_POLL_GROUPS][MAX_BITS];         // 功能码01 - 线圈状态
-    uint8_t discrete_inputs[MAX_POLL_GROUPS][MAX_BITS];// 功能码02 - 离散输入状态
-    uint16_t holding_regs[MAX_POLL_GROUPS][MAX_REGS];   // 功能码03 - 保持寄存器
-    uint16_t input_regs[MAX_POLL_GROUPS][MAX_REGS];     // 功能码04 - 输入寄存器
+    // 各组数据区，按当前配置从同一块内存(优先PSRAM)中按需划分：
+    // 功能码01/02按位打包，功能码03/04为寄存器数组
+    uint8_t *area[MAX_POLL_GROUPS];
+    uint16_t area_size[MAX_POLL_GROUPS];                // 数据区字节数
+    uint8_t area_fc[MAX_POLL_GROUPS];                   // 数据区对应的功能码
     bool register_ready[MAX_POLL_GROUPS];               // 数据就绪标志
+    volatile uint32_t seq[MAX_POLL_GROUPS];             // 每组的顺序锁计数，奇数表示正在写入
+    volatile uint32_t version[MAX_POLL_GROUPS];         // 每组数据版本，数值变化时递增
+    volatile int64_t changed_us[MAX_POLL_GROUPS];       // 每组最近一次数值变化的时间(us)
+    modbus_sample_t sample[MAX_POLL_GROUPS];            // 每组最近一次采集的采样信息
+    uint32_t dirty[MODBUS_CONSUMER_COUNT][MAX_POLL_GROUPS][DIRTY_WORDS]; // 各消费者的脏位图
 } modbus_data_t;
 
 // 外部变量声明
 extern modbus_config_t modbus_config;
 extern modbus_data_t modbus_data;
+// 配置版本号，每次修改轮询配置后递增，轮询任务据此重建调度表
+extern volatile uint32_t modbus_config_generation;
+
+// 获取轮询组的实际轮询周期(ms)
+uint32_t modbus_group_period_ms(const poll_group_config_t *group);
+// 通知轮询任务配置已变更，并按新配置重新划分数据区
+void modbus_config_changed(void);
+// 按当前配置重新划分各组数据区，启动时和配置变更时调用；划分后所有组数据变为未就绪。
+// 逐组切换到新数据区，等切换前开始的读取全部结束后释放旧数据区
+esp_err_t modbus_data_layout(void);
+
+// 顺序锁写端：轮询任务更新组数据前后调用。各组的写端互不等待，没有全局锁，
+// 只在重新划分切换本组数据区的几次赋值期间短暂等待
+void modbus_data_write_begin(int group);
+void modbus_data_write_end(int group);
+// 写区间内调用：取得组数据区，功能码与当前划分不符时返回 NULL
+void *modbus_data_area(int group, uint8_t function_code, size_t *size);
+// 写区间内调用：与旧值比较后写入并标记变化的寄存器/字节，force 为 true 时全部视为变化。
+// 返回变化的个数。update_regs 的 src 为响应帧中的大端寄存器数据；
+// update_bits 从打包位数据 src 的第 src_bit 位起取 count 位写入 dst
+int modbus_data_update_regs(int group, uint16_t *dst, const uint8_t *src, int count, bool force);
+int modbus_data_update_bits(int group, uint8_t *dst, const uint8_t *src, int src_bit, int count, bool force);
+// 写区间内调用：记录本次采集的质量、时间和延迟，除 STALE 外采样序号加一
+void modbus_data_set_sample(int group, modbus_quality_t quality, int64_t sample_us, uint32_t latency_us);
+// 登记消费者的任务：任一组数据有变化时，在该组写入结束后向任务发送通知(xTaskNotifyGive)，
+// 消费者用 ulTaskNotifyTake 等待后再取各组脏位图。task 为 NULL 时取消登记
+void modbus_data_set_listener(modbus_consumer_t consumer, TaskHandle_t task);
+// 取出并清空消费者在该组上的脏位图(dirty 可为 NULL)，返回是否有变化
+bool modbus_data_take_dirty(modbus_consumer_t consumer, int group, uint32_t dirty[DIRTY_WORDS]);
+// 组数据版本，消费者比较版本即可知道组是否有变化
+uint32_t modbus_data_version(int group);
+// 顺序锁读端：按功能码选择组的数据区，从 offset 字节处复制 len 字节到 dest，
+// 保证得到一次完整更新后的一致快照，不需要互斥量。返回数据是否就绪
+bool modbus_data_read(int group, uint8_t function_code, size_t offset, void *dest, size_t len);
+// 同 modbus_data_read，同时取得与数据一致的采样信息(sample 可为 NULL)
+bool modbus_data_read_sample(int group, uint8_t function_code, size_t offset, void *dest, size_t len,
+                             modbus_sample_t *sample);
+// 组最近一次采样序号，消费者与已处理的序号比较即可跳过没有新采样的组
+uint32_t modbus_data_sample_seq(int group);
+// 采样质量名称
+const char *modbus_quality_name(uint8_t quality);
+
+// 从JSON更新轮询配置(字段与 /api/modbus/config 相同)，之后需调用 modbus_config_changed
+void modbus_config_from_json(const cJSON *root);
 
 esp_err_t save_modbus_config_to_nvs(void);
 esp_err_t load_modbus_config_from_nvs(void);
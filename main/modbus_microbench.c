@@ -0,0 +1,503 @@
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "esp_log.h"
+#include "agile_modbus.h"
+#include "agile_modbus_rtu.h"
+#include "agile_modbus_tcp.h"
+#include "agile_modbus_slave_util.h"
+#include "modbus_microbench.h"
+
+static const char *TAG = "microbench";
+
+#define MB_BENCH_MAX_SIZES 8
+#define MB_BENCH_MAX_CASES 512
+#define MB_BENCH_NAME_LEN 48
+#define MB_BENCH_PATH_LEN 128
+#define MB_BENCH_ROUNDS 5           // 每个用例测量的轮数，取最快一轮
+
+// 一个被测的请求/响应对：serialize 生成请求，deserialize 解析从机对该请求的响应
+typedef struct {
+    const char *name;
+    bool bits;              // 大小单位为位
+    int max_nb;             // 单个请求最多的个数，1 表示大小固定
+    bool decode_only;       // 与上一项是同一请求的另一种解析方式，只测 deserialize
+    int (*serialize)(agile_modbus_t *ctx, int nb);
+    int (*deserialize)(agile_modbus_t *ctx, int msg_length);
+} mb_op_t;
+
+// 一个用例的结果
+typedef struct {
+    char name[MB_BENCH_NAME_LEN];
+    int size;               // 寄存器/位个数或字节数
+    double ns_per_op;
+    int bytes_per_op;       // 每次操作处理的帧字节数
+    double baseline_ns;     // 基线 ns/op，0 表示没有基线
+} mb_result_t;
+
+static uint8_t dest_bits[AGILE_MODBUS_MAX_READ_BITS];
+static uint16_t dest_regs[AGILE_MODBUS_MAX_READ_REGISTERS];
+static uint8_t src_bits[AGILE_MODBUS_MAX_WRITE_BITS];
+static uint16_t src_regs[AGILE_MODBUS_MAX_WRITE_REGISTERS];
+static volatile uintptr_t sink;     // 防止被测调用的结果被优化掉
+
+// 从机寄存器表，线圈和离散输入共用按位打包的位表，保持和输入寄存器共用寄存器表
+static uint8_t slave_bits[(AGILE_MODBUS_MAX_READ_BITS + 7) / 8];
+static uint16_t slave_regs[AGILE_MODBUS_MAX_READ_REGISTERS];
+
+static mb_result_t results[MB_BENCH_MAX_CASES];
+static int result_count = 0;
+
+static int ser_read_bits(agile_modbus_t *ctx, int nb) { return agile_modbus_serialize_read_bits(ctx, 0, nb); }
+static int ser_read_input_bits(agile_modbus_t *ctx, int nb) { return agile_modbus_serialize_read_input_bits(ctx, 0, nb); }
+static int ser_read_registers(agile_modbus_t *ctx, int nb) { return agile_modbus_serialize_read_registers(ctx, 0, nb); }
+static int ser_read_input_registers(agile_modbus_t *ctx, int nb) { return agile_modbus_serialize_read_input_registers(ctx, 0, nb); }
+static int ser_write_bit(agile_modbus_t *ctx, int nb) { return agile_modbus_serialize_write_bit(ctx, 0, 1); }
+static int ser_write_register(agile_modbus_t *ctx, int nb) { return agile_modbus_serialize_write_register(ctx, 0, 0x1234); }
+static int ser_write_bits(agile_modbus_t *ctx, int nb) { return agile_modbus_serialize_write_bits(ctx, 0, nb, src_bits); }
+static int ser_write_registers(agile_modbus_t *ctx, int nb) { return agile_modbus_serialize_write_registers(ctx, 0, nb, src_regs); }
+static int ser_mask_write_register(agile_modbus_t *ctx, int nb) { return agile_modbus_serialize_mask_write_register(ctx, 0, 0xFF00, 0x0012); }
+static int ser_write_and_read_registers(agile_modbus_t *ctx, int nb) { return agile_modbus_serialize_write_and_read_registers(ctx, 0, nb, src_regs, 0, nb); }
+static int ser_report_slave_id(agile_modbus_t *ctx, int nb) { return agile_modbus_serialize_report_slave_id(ctx); }
+
+static int de_read_bits(agile_modbus_t *ctx, int len) { return agile_modbus_deserialize_read_bits(ctx, len, dest_bits); }
+static int de_read_input_bits(agile_modbus_t *ctx, int len) { return agile_modbus_deserialize_read_input_bits(ctx, len, dest_bits); }
+static int de_read_registers(agile_modbus_t *ctx, int len) { return agile_modbus_deserialize_read_registers(ctx, len, dest_regs); }
+static int de_read_input_registers(agile_modbus_t *ctx, int len) { return agile_modbus_deserialize_read_input_registers(ctx, len, dest_regs); }
+static int de_write_bit(agile_modbus_t *ctx, int len) { return agile_modbus_deserialize_write_bit(ctx, len); }
+static int de_write_register(agile_modbus_t *ctx, int len) { return agile_modbus_deserialize_write_register(ctx, len); }
+static int de_write_bits(agile_modbus_t *ctx, int len) { return agile_modbus_deserialize_write_bits(ctx, len); }
+static int de_write_registers(agile_modbus_t *ctx, int len) { return agile_modbus_deserialize_write_registers(ctx, len); }
+static int de_mask_write_register(agile_modbus_t *ctx, int len) { return agile_modbus_deserialize_mask_write_register(ctx, len); }
+static int de_write_and_read_registers(agile_modbus_t *ctx, int len) { return agile_modbus_deserialize_write_and_read_registers(ctx, len, dest_regs); }
+static int de_report_slave_id(agile_modbus_t *ctx, int len) { return agile_modbus_deserialize_report_slave_id(ctx, len, sizeof(dest_bits), dest_bits); }
+
+// 零拷贝解析只返回指向响应帧的指针
+static int de_read_bits_packed(agile_modbus_t *ctx, int len)
+{
+    const uint8_t *bits;
+    int rc = agile_modbus_deserialize_read_bits_packed(ctx, len, &bits);
+    sink = (uintptr_t)bits;
+    return rc;
+}
+
+static int de_read_input_bits_packed(agile_modbus_t *ctx, int len)
+{
+    const uint8_t *bits;
+    int rc = agile_modbus_deserialize_read_input_bits_packed(ctx, len, &bits);
+    sink = (uintptr_t)bits;
+    return rc;
+}
+
+static int de_read_registers_raw(agile_modbus_t *ctx, int len)
+{
+    const uint8_t *regs;
+    int rc = agile_modbus_deserialize_read_registers_raw(ctx, len, &regs);
+    sink = (uintptr_t)regs;
+    return rc;
+}
+
+static int de_read_input_registers_raw(agile_modbus_t *ctx, int len)
+{
+    const uint8_t *regs;
+    int rc = agile_modbus_deserialize_read_input_registers_raw(ctx, len, &regs);
+    sink = (uintptr_t)regs;
+    return rc;
+}
+
+static const mb_op_t ops[] = {
+    {"read_bits", true, AGILE_MODBUS_MAX_READ_BITS, false, ser_read_bits, de_read_bits},
+    {"read_bits_packed", true, AGILE_MODBUS_MAX_READ_BITS, true, ser_read_bits, de_read_bits_packed},
+    {"read_input_bits", true, AGILE_MODBUS_MAX_READ_BITS, false, ser_read_input_bits, de_read_input_bits},
+    {"read_input_bits_packed", true, AGILE_MODBUS_MAX_READ_BITS, true, ser_read_input_bits, de_read_input_bits_packed},
+    {"read_registers", false, AGILE_MODBUS_MAX_READ_REGISTERS, false, ser_read_registers, de_read_registers},
+    {"read_registers_raw", false, AGILE_MODBUS_MAX_READ_REGISTERS, true, ser_read_registers, de_read_registers_raw},
+    {"read_input_registers", false, AGILE_MODBUS_MAX_READ_REGISTERS, false, ser_read_input_registers, de_read_input_registers},
+    {"read_input_registers_raw", false, AGILE_MODBUS_MAX_READ_REGISTERS, true, ser_read_input_registers, de_read_input_registers_raw},
+    {"write_bit", false, 1, false, ser_write_bit, de_write_bit},
+    {"write_register", false, 1, false, ser_write_register, de_write_register},
+    {"write_bits", true, AGILE_MODBUS_MAX_WRITE_BITS, false, ser_write_bits, de_write_bits},
+    {"write_registers", false, AGILE_MODBUS_MAX_WRITE_REGISTERS, false, ser_write_registers, de_write_registers},
+    {"mask_write_register", false, 1, false, ser_mask_write_register, de_mask_write_register},
+    {"write_and_read_registers", false, AGILE_MODBUS_MAX_WR_WRITE_REGISTERS, false, ser_write_and_read_registers, de_write_and_read_registers},
+    {"report_slave_id", false, 1, false, ser_report_slave_id, de_report_slave_id},
+};
+
+// 从机工具直接读写从机表，写入后的通知无需处理
+static int set_noop(int index, int len, void *buf, int bufsz)
+{
+    return 0;
+}
+
+static const agile_modbus_slave_util_map_t bench_bit_maps[1] = {
+    {0, AGILE_MODBUS_MAX_READ_BITS - 1, NULL, set_noop, slave_bits, NULL},
+};
+
+static const agile_modbus_slave_util_map_t bench_register_maps[1] = {
+    {0, AGILE_MODBUS_MAX_READ_REGISTERS - 1, NULL, set_noop, slave_regs, NULL},
+};
+
+// 与网关的TCP从站一样使用从机工具的映射表
+static const agile_modbus_slave_util_t bench_slave_util = {
+    bench_bit_maps, 1,
+    bench_bit_maps, 1,
+    bench_register_maps, 1,
+    bench_register_maps, 1,
+    NULL, NULL, NULL,
+};
+
+typedef struct {
+    const mb_op_t *op;
+    agile_modbus_t *master;
+    agile_modbus_t *slave;
+    agile_modbus_parser_t *parser;  // 响应帧流式解析器
+    int nb;
+    int req_len;
+    int rsp_len;
+} mb_case_t;
+
+typedef enum {
+    MB_STEP_SERIALIZE,
+    MB_STEP_DESERIALIZE,
+    MB_STEP_PARSE,
+    MB_STEP_RECEIVE_JUDGE,
+    MB_STEP_SLAVE_HANDLE,
+} mb_step_t;
+
+static int run_step(const mb_case_t *c, mb_step_t step)
+{
+    switch (step) {
+    case MB_STEP_SERIALIZE:
+        return c->op->serialize(c->master, c->nb);
+    case MB_STEP_DESERIALIZE:
+        return c->op->deserialize(c->master, c->rsp_len);
+    case MB_STEP_PARSE:
+        return agile_modbus_parser_feed(c->parser, c->master->read_buf, c->rsp_len, NULL);
+    case MB_STEP_RECEIVE_JUDGE:
+        return agile_modbus_receive_judge(c->master, c->rsp_len, AGILE_MODBUS_MSG_CONFIRMATION);
+    case MB_STEP_SLAVE_HANDLE:
+        return agile_modbus_slave_handle(c->slave, c->req_len, 0, agile_modbus_slave_util_callback,
+                                         &bench_slave_util, NULL);
+    }
+    return -1;
+}
+
+static int run_crc(const mb_case_t *c, mb_step_t step)
+{
+    return agile_modbus_rtu_crc16(c->master->send_buf, c->req_len);
+}
+
+// 本线程消耗的CPU时间(ns)，不计入模拟调度器的tick线程和其他任务抢占的时间
+static int64_t thread_time_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+// 先逐次加倍批量直到一批耗时达到最短时间的 1/MB_BENCH_ROUNDS(同时预热缓存)，
+// 再按该批量测 MB_BENCH_ROUNDS 轮取最快一轮，减少调度和频率波动对基线比较的影响，返回 ns/op
+static double time_ns(int (*fn)(const mb_case_t *c, mb_step_t step), const mb_case_t *c, mb_step_t step,
+                      uint32_t min_time_us)
+{
+    uint32_t batch = 16;
+    int64_t round_ns = (int64_t)min_time_us * 1000 / MB_BENCH_ROUNDS;
+    double best = 0;
+
+    for (;;) {
+        int64_t start = thread_time_ns();
+        for (uint32_t i = 0; i < batch; i++) {
+            sink += fn(c, step);
+        }
+        if (thread_time_ns() - start >= round_ns || batch >= (1u << 24)) {
+            break;
+        }
+        batch *= 2;
+    }
+    for (int r = 0; r < MB_BENCH_ROUNDS; r++) {
+        int64_t start = thread_time_ns();
+        for (uint32_t i = 0; i < batch; i++) {
+            sink += fn(c, step);
+        }
+        double ns = (double)(thread_time_ns() - start) / batch;
+        if (r == 0 || ns < best) {
+            best = ns;
+        }
+    }
+    return best;
+}
+
+static void add_result(const char *name, int size, double ns_per_op, int bytes_per_op)
+{
+    if (result_count >= MB_BENCH_MAX_CASES) {
+        return;
+    }
+    mb_result_t *r = &results[result_count++];
+    snprintf(r->name, sizeof(r->name), "%s", name);
+    r->size = size;
+    r->ns_per_op = ns_per_op;
+    r->bytes_per_op = bytes_per_op;
+    r->baseline_ns = 0;
+}
+
+// CRC16 按RTU帧的典型长度测：短请求、中等响应和最大帧
+static void bench_crc(agile_modbus_t *ctx, uint32_t min_time_us)
+{
+    static const int sizes[] = {6, 64, AGILE_MODBUS_RTU_MAX_ADU_LENGTH - 2};
+    mb_case_t c = {.master = ctx};
+
+    for (int i = 0; i < ctx->send_bufsz; i++) {
+        ctx->send_buf[i] = (uint8_t)(i * 7 + 1);
+    }
+    for (int s = 0; s < (int)(sizeof(sizes) / sizeof(sizes[0])); s++) {
+        c.req_len = sizes[s];
+        add_result("rtu.crc16", sizes[s], time_ns(run_crc, &c, 0, min_time_us), sizes[s]);
+    }
+}
+
+// 生成一个用例的请求和响应：主站组帧，请求交给从机处理，响应再交回主站
+static bool prepare_case(mb_case_t *c)
+{
+    c->req_len = c->op->serialize(c->master, c->nb);
+    if (c->req_len <= 0) {
+        return false;
+    }
+    memcpy(c->slave->read_buf, c->master->send_buf, c->req_len);
+    c->rsp_len = agile_modbus_slave_handle(c->slave, c->req_len, 0, agile_modbus_slave_util_callback,
+                                           &bench_slave_util, NULL);
+    if (c->rsp_len <= 0) {
+        return false;
+    }
+    memcpy(c->master->read_buf, c->slave->send_buf, c->rsp_len);
+    if (agile_modbus_parser_feed(c->parser, c->master->read_buf, c->rsp_len, NULL) != AGILE_MODBUS_PARSE_COMPLETE ||
+        c->parser->frame_length != c->rsp_len) {
+        return false;
+    }
+    return c->op->deserialize(c->master, c->rsp_len) >= 0;
+}
+
+static bool bench_backend(const char *backend, agile_modbus_t *master, agile_modbus_t *slave,
+                          const int *reg_sizes, int reg_count, const int *bit_sizes, int bit_count,
+                          uint32_t min_time_us)
+{
+    static const char *step_names[] = {"serialize", "deserialize", "parse", "receive_judge", "slave_handle"};
+    agile_modbus_parser_t parser;
+    bool ok = true;
+
+    agile_modbus_parser_init(&parser, master, AGILE_MODBUS_MSG_CONFIRMATION);
+    agile_modbus_set_slave(master, 1);
+    agile_modbus_set_slave(slave, 1);
+
+    for (int o = 0; o < (int)(sizeof(ops) / sizeof(ops[0])); o++) {
+        const mb_op_t *op = &ops[o];
+        const int *sizes = op->bits ? bit_sizes : reg_sizes;
+        int count = (op->max_nb == 1) ? 1 : (op->bits ? bit_count : reg_count);
+        int last_nb = 0;
+
+        for (int s = 0; s < count; s++) {
+            mb_case_t c = {.op = op, .master = master, .slave = slave, .parser = &parser};
+            c.nb = (op->max_nb == 1) ? 1 : (sizes[s] < op->max_nb ? sizes[s] : op->max_nb);
+            if (c.nb == last_nb) {
+                continue;   // 超过本功能码上限的大小截断后与上一个相同
+            }
+            last_nb = c.nb;
+
+            for (int step = MB_STEP_SERIALIZE; step <= MB_STEP_SLAVE_HANDLE; step++) {
+                if (op->decode_only && step != MB_STEP_DESERIALIZE) {
+                    continue;
+                }
+                // 每一步前重新生成请求和响应：TCP每次组帧事务号都会递增，响应须与最近的请求对应
+                if (!prepare_case(&c)) {
+                    ESP_LOGE(TAG, "%s.%s nb=%d: request/response round trip failed", backend, op->name, c.nb);
+                    ok = false;
+                    break;
+                }
+                char name[MB_BENCH_NAME_LEN];
+                snprintf(name, sizeof(name), "%s.%s.%s", backend, op->name, step_names[step]);
+                int bytes = (step == MB_STEP_SERIALIZE) ? c.req_len :
+                            (step == MB_STEP_SLAVE_HANDLE) ? c.req_len + c.rsp_len : c.rsp_len;
+                add_result(name, c.nb, time_ns(run_step, &c, step, min_time_us), bytes);
+            }
+        }
+    }
+    return ok;
+}
+
+static int load_sizes(const cJSON *config, const char *key, int *sizes, const int *defaults, int default_count)
+{
+    cJSON *array = cJSON_GetObjectItem(config, key);
+    int count = 0;
+
+    if (cJSON_IsArray(array)) {
+        const cJSON *item;
+        cJSON_ArrayForEach(item, array) {
+            if (cJSON_IsNumber(item) && item->valueint > 0 && count < MB_BENCH_MAX_SIZES) {
+                sizes[count++] = item->valueint;
+            }
+        }
+    }
+    if (count == 0) {
+        memcpy(sizes, defaults, default_count * sizeof(int));
+        count = default_count;
+    }
+    return count;
+}
+
+static cJSON *load_json_file(const char *path)
+{
+    FILE *f = fopen(path, "rb");
+    if (f == NULL) {
+        return NULL;
+    }
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    char *content = malloc(size + 1);
+    if (content == NULL || fread(content, 1, size, f) != (size_t)size) {
+        fclose(f);
+        free(content);
+        return NULL;
+    }
+    content[size] = '\0';
+    fclose(f);
+
+    cJSON *root = cJSON_Parse(content);
+    free(content);
+    return root;
+}
+
+// 按名称和大小在基线结果中查找对应用例的 ns/op
+static void apply_baseline(const char *path)
+{
+    cJSON *root = load_json_file(path);
+    if (root == NULL) {
+        ESP_LOGW(TAG, "No usable baseline at %s", path);
+        return;
+    }
+
+    const cJSON *item;
+    cJSON_ArrayForEach(item, cJSON_GetObjectItem(root, "cases")) {
+        cJSON *name = cJSON_GetObjectItem(item, "name");
+        cJSON *size = cJSON_GetObjectItem(item, "size");
+        cJSON *ns = cJSON_GetObjectItem(item, "ns_per_op");
+        if (!cJSON_IsString(name) || !cJSON_IsNumber(size) || !cJSON_IsNumber(ns)) {
+            continue;
+        }
+        for (int i = 0; i < result_count; i++) {
+            if (results[i].size == size->valueint && strcmp(results[i].name, name->valuestring) == 0) {
+                results[i].baseline_ns = ns->valuedouble;
+                break;
+            }
+        }
+    }
+    cJSON_Delete(root);
+}
+
+bool modbus_microbench_run(const cJSON *config)
+{
+    static const int default_reg_sizes[] = {1, 16, 64, 125};
+    static const int default_bit_sizes[] = {1, 64, 512, 2000};
+    uint8_t master_send[AGILE_MODBUS_MAX_ADU_LENGTH], master_read[AGILE_MODBUS_MAX_ADU_LENGTH];
+    uint8_t slave_send[AGILE_MODBUS_MAX_ADU_LENGTH], slave_read[AGILE_MODBUS_MAX_ADU_LENGTH];
+    int reg_sizes[MB_BENCH_MAX_SIZES], bit_sizes[MB_BENCH_MAX_SIZES];
+    char results_path[MB_BENCH_PATH_LEN] = "";
+    char baseline_path[MB_BENCH_PATH_LEN] = "";
+    bool ok = true;
+
+    cJSON *item = cJSON_GetObjectItem(config, "min_time_ms");
+    uint32_t min_time_us = (cJSON_IsNumber(item) && item->valueint > 0 ? item->valueint : 20) * 1000;
+    item = cJSON_GetObjectItem(config, "max_regression");
+    double max_regression = cJSON_IsNumber(item) && item->valuedouble > 0 ? item->valuedouble : 0.25;
+    item = cJSON_GetObjectItem(config, "results");
+    if (cJSON_IsString(item)) {
+        snprintf(results_path, sizeof(results_path), "%s", item->valuestring);
+    }
+    item = cJSON_GetObjectItem(config, "baseline");
+    if (cJSON_IsString(item)) {
+        snprintf(baseline_path, sizeof(baseline_path), "%s", item->valuestring);
+    }
+    int reg_count = load_sizes(config, "register_sizes", reg_sizes, default_reg_sizes, 4);
+    int bit_count = load_sizes(config, "bit_sizes", bit_sizes, default_bit_sizes, 4);
+
+    cJSON *backends = cJSON_GetObjectItem(config, "backends");
+    bool rtu = !cJSON_IsArray(backends);
+    bool tcp = !cJSON_IsArray(backends);
+    cJSON_ArrayForEach(item, backends) {
+        rtu |= cJSON_IsString(item) && strcmp(item->valuestring, "rtu") == 0;
+        tcp |= cJSON_IsString(item) && strcmp(item->valuestring, "tcp") == 0;
+    }
+
+    for (int i = 0; i < AGILE_MODBUS_MAX_WRITE_BITS; i++) {
+        src_bits[i] = (i % 3) == 0;
+    }
+    for (int i = 0; i < AGILE_MODBUS_MAX_WRITE_REGISTERS; i++) {
+        src_regs[i] = (uint16_t)(i * 257);
+    }
+    for (int i = 0; i < AGILE_MODBUS_MAX_READ_BITS; i++) {
+        agile_modbus_slave_io_set(slave_bits, i, (i % 5) == 0);
+    }
+
+    result_count = 0;
+    if (rtu) {
+        agile_modbus_rtu_t master, slave;
+        agile_modbus_rtu_init(&master, master_send, sizeof(master_send), master_read, sizeof(master_read));
+        agile_modbus_rtu_init(&slave, slave_send, sizeof(slave_send), slave_read, sizeof(slave_read));
+        bench_crc(&master._ctx, min_time_us);
+        ok &= bench_backend("rtu", &master._ctx, &slave._ctx, reg_sizes, reg_count, bit_sizes, bit_count,
+                            min_time_us);
+    }
+    if (tcp) {
+        agile_modbus_tcp_t master, slave;
+        agile_modbus_tcp_init(&master, master_send, sizeof(master_send), master_read, sizeof(master_read));
+        agile_modbus_tcp_init(&slave, slave_send, sizeof(slave_send), slave_read, sizeof(slave_read));
+        ok &= bench_backend("tcp", &master._ctx, &slave._ctx, reg_sizes, reg_count, bit_sizes, bit_count,
+                            min_time_us);
+    }
+    if (baseline_path[0] != '\0') {
+        apply_baseline(baseline_path);
+    }
+
+    cJSON *root = cJSON_CreateObject();
+    cJSON *cases = cJSON_AddArrayToObject(root, "cases");
+    int regressions = 0;
+    for (int i = 0; i < result_count; i++) {
+        const mb_result_t *r = &results[i];
+        bool regressed = r->baseline_ns > 0 && r->ns_per_op > r->baseline_ns * (1 + max_regression);
+        cJSON *c = cJSON_CreateObject();
+        cJSON_AddStringToObject(c, "name", r->name);
+        cJSON_AddNumberToObject(c, "size", r->size);
+        cJSON_AddNumberToObject(c, "ns_per_op", r->ns_per_op);
+        cJSON_AddNumberToObject(c, "bytes_per_op", r->bytes_per_op);
+        if (r->baseline_ns > 0) {
+            cJSON_AddNumberToObject(c, "baseline_ns_per_op", r->baseline_ns);
+        }
+        cJSON_AddItemToArray(cases, c);
+        ESP_LOGI(TAG, "%-48s %5d %10.1f ns/op %5d bytes/op%s", r->name, r->size, r->ns_per_op,
+                 r->bytes_per_op, regressed ? "  REGRESSION" : "");
+        regressions += regressed;
+    }
+    ok = ok && regressions == 0;
+    cJSON_AddNumberToObject(root, "regressions", regressions);
+    cJSON_AddBoolToObject(root, "pass", ok);
+
+    char *text = cJSON_PrintUnformatted(root);
+    cJSON_Delete(root);
+    if (text == NULL) {
+        return false;
+    }
+    if (results_path[0] != '\0') {
+        FILE *f = fopen(results_path, "w");
+        if (f == NULL) {
+            ESP_LOGE(TAG, "Failed to write %s", results_path);
+            ok = false;
+        } else {
+            fprintf(f, "%s\n", text);
+            fclose(f);
+        }
+    }
+    free(text);
+    ESP_LOGI(TAG, "%d cases, %d regressions", result_count, regressions);
+    return ok;
+}
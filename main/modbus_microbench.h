@@ -0,0 +1,18 @@
+#ifndef MODBUS_MICROBENCH_H
+#define MODBUS_MICROBENCH_H
+
+#include <stdbool.h>
+#include "cJSON.h"
+
+// agile_modbus 微基准：CRC16、各功能码的 serialize/deserialize、流式解析、receive_judge，
+// 以及配合 agile_modbus_slave_util_callback 的 slave_handle，按帧大小给出 ns/op 和 bytes/op。
+// 只在主机构建中使用，配置与结果均为JSON：
+// {"min_time_ms":20,"backends":["rtu","tcp"],"register_sizes":[1,16,64,125],
+//  "bit_sizes":[1,64,512,2000],"results":"microbench_results.json",
+//  "baseline":"microbench_baseline.json","max_regression":0.25}
+// 给出 baseline(以前的结果文件)时，任一用例比基线慢超过 max_regression 即判为回退
+
+// 运行所有用例，结果打印并写入配置的文件，返回是否没有失败和回退
+bool modbus_microbench_run(const cJSON *config);
+
+#endif
@@ -3,8 +3,19 @@
 #include "freertos/task.h"
 #include "modbus_task.h"
 #include "modbus_config.h"
+#include "sdkconfig.h"
+#if CONFIG_IDF_TARGET_LINUX
+// 主机构建用伪终端代替物理UART，编号规则相同
+#include "rtu_pty.h"
+#define uart_rtu_port rtu_pty_port
+#else
 #include "uart_rtu.h"
+#endif
+#include "write_queue.h"
+#include "perf_stage.h"
 #include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_heap_caps.h"
 
 // 日志标签
 static const char *TAG = "modbus_task";
@@ -17,293 +28,534 @@ static uint8_t master2_recv_buf[AGILE_MODBUS_MAX_ADU_LENGTH];
 static uint8_t master3_send_buf[AGILE_MODBUS_MAX_ADU_LENGTH];
 static uint8_t master3_recv_buf[AGILE_MODBUS_MAX_ADU_LENGTH];
 
-// 初始化三个UART的Modbus上下文
-static modbus_context_t mb_ctx1 = {0};
-static modbus_context_t mb_ctx2 = {0};
-static modbus_context_t mb_ctx3 = {0};
+// 三个UART的Modbus上下文，轮询计划和调度表随组数增长，放在PSRAM中
+static modbus_context_t *mb_ctx1 = NULL;
+static modbus_context_t *mb_ctx2 = NULL;
+static modbus_context_t *mb_ctx3 = NULL;
 
-// 自适应超时配置
-#define TIMEOUT_INITIAL 200  // 初始超时时间 (ms)
-#define TIMEOUT_MIN 90       // 最小超时时间 (ms)
-#define TIMEOUT_MAX 400      // 最大超时时间 (ms)
-#define TIMEOUT_ADJUST_UP 10  // 超时增量 (ms)
-#define TIMEOUT_ADJUST_DOWN 10  // 超时减量 (ms)
+// 应答超时配置，实际超时由各从站的应答时间估计得出
+#define TIMEOUT_INITIAL 200  // 尚无应答样本时的超时时间 (ms)
+#define TIMEOUT_MAX 1000     // 最大超时时间 (ms)
+_Static_assert(WRITE_WAIT_MS >= WRITE_EXPIRE_MS + TIMEOUT_MAX, "同步写等待须覆盖排队期限和一次事务超时");
 
-// 每组的自适应超时存储
-static uint32_t group_timeouts[MAX_POLL_GROUPS] = {0};
-static uint8_t timeout_failure_count[MAX_POLL_GROUPS] = {0};
-static uint8_t timeout_success_count[MAX_POLL_GROUPS] = {0};
+// 估算事务耗时时预留的从站应答时间 (us)，运行后由实测值修正
+#define SLAVE_TURNAROUND_US 5000
+
+// 分配一个清零的Modbus上下文，优先使用PSRAM
+static modbus_context_t *alloc_context(void)
+{
+    modbus_context_t *ctx = heap_caps_calloc(1, sizeof(modbus_context_t), MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    if (ctx == NULL) {
+        ctx = heap_caps_calloc(1, sizeof(modbus_context_t), MALLOC_CAP_8BIT);
+    }
+    return ctx;
+}
 
 void start_modbus(void)
-{ 
-    // 初始化组超时
-    for (int i = 0; i < MAX_POLL_GROUPS; i++) {
-        group_timeouts[i] = TIMEOUT_INITIAL;
+{
+    // 按当前配置划分各组数据区
+    modbus_data_layout();
+
+    mb_ctx1 = alloc_context();
+    mb_ctx2 = alloc_context();
+    mb_ctx3 = alloc_context();
+    if (mb_ctx1 == NULL || mb_ctx2 == NULL || mb_ctx3 == NULL) {
+        ESP_LOGE(TAG, "Modbus 上下文内存分配失败");
+        return;
     }
-    
+
     // 初始化UART1的Modbus
-    agile_modbus_rtu_init(&mb_ctx1.ctx_rtu, master1_send_buf, sizeof(master1_send_buf),
+    agile_modbus_rtu_init(&mb_ctx1->ctx_rtu, master1_send_buf, sizeof(master1_send_buf),
                           master1_recv_buf, sizeof(master1_recv_buf));
-    mb_ctx1.uart_port = 1;
+    mb_ctx1->uart_port = 1;
+    mb_ctx1->port = uart_rtu_port(1);
 
     // 初始化UART2的Modbus
-    agile_modbus_rtu_init(&mb_ctx2.ctx_rtu, master2_send_buf, sizeof(master2_send_buf),
+    agile_modbus_rtu_init(&mb_ctx2->ctx_rtu, master2_send_buf, sizeof(master2_send_buf),
                           master2_recv_buf, sizeof(master2_recv_buf));
-    mb_ctx2.uart_port = 2;
+    mb_ctx2->uart_port = 2;
+    mb_ctx2->port = uart_rtu_port(2);
 
     // 初始化UART3的Modbus（使用UART0的物理接口）
-    agile_modbus_rtu_init(&mb_ctx3.ctx_rtu, master3_send_buf, sizeof(master3_send_buf),
+    agile_modbus_rtu_init(&mb_ctx3->ctx_rtu, master3_send_buf, sizeof(master3_send_buf),
                           master3_recv_buf, sizeof(master3_recv_buf));
-    mb_ctx3.uart_port = 3;
+    mb_ctx3->uart_port = 3;
+    mb_ctx3->port = uart_rtu_port(0);
 
     // 创建三个Modbus任务
     xTaskCreate(modbus_poll_task,
                 "modbus_task1",
                 MODBUS_TASK_STACK_SIZE,
-                &mb_ctx1,
+                mb_ctx1,
                 10,
                 NULL);
 
     xTaskCreate(modbus_poll_task,
                 "modbus_task2",
                 MODBUS_TASK_STACK_SIZE,
-                &mb_ctx2,
+                mb_ctx2,
                 10,
                 NULL);
 
     xTaskCreate(modbus_poll_task,
                 "modbus_task3", 
                 MODBUS_TASK_STACK_SIZE,
-                &mb_ctx3,
+                mb_ctx3,
                 10,
                 NULL);
 }
 
-// 自适应调整超时函数
-static void adjust_timeout(int group_index, bool success) {
-    if (success) {
-        // 通信成功，增加成功计数
-        timeout_success_count[group_index]++;
-        timeout_failure_count[group_index] = 0;
-        
-        // 连续多次成功后减少超时时间
-        if (timeout_success_count[group_index] >= 3) {
-            if (group_timeouts[group_index] > TIMEOUT_MIN + TIMEOUT_ADJUST_DOWN) {
-                group_timeouts[group_index] -= TIMEOUT_ADJUST_DOWN;
-                //ESP_LOGI(TAG, "组 %d 通信稳定，减少超时至 %" PRIu32 " ms", group_index, group_timeouts[group_index]);
-            }
-            timeout_success_count[group_index] = 0;
+// 读请求失败时标记所有成员组数据无效，并记录失败原因
+static void read_failed(const poll_read_t *read, modbus_quality_t quality, int64_t sample_us, uint32_t latency_us)
+{
+    for (int k = 0; k < read->group_count; k++) {
+        modbus_data_write_begin(read->groups[k]);
+        modbus_data.register_ready[read->groups[k]] = false;
+        modbus_data_set_sample(read->groups[k], quality, sample_us, latency_us);
+        modbus_data_write_end(read->groups[k]);
+    }
+}
+
+// 从站离线跳过轮询时，把成员组标记为过期
+static void read_stale(const poll_read_t *read)
+{
+    for (int k = 0; k < read->group_count; k++) {
+        int g = read->groups[k];
+        if (modbus_data.sample[g].quality == MODBUS_QUALITY_STALE) {
+            continue;
+        }
+        modbus_data_write_begin(g);
+        modbus_data_set_sample(g, MODBUS_QUALITY_STALE, 0, 0);
+        modbus_data_write_end(g);
+    }
+}
+
+// 根据从站应答时间估计计算本次事务的超时(ms)，frame_bytes 为请求和响应帧的总长度：请求和响应的传输时间 + srtt + k*rttvar，
+// 应答时间部分不小于两个t3.5
+static uint32_t read_timeout_ms(const rtu_timing_t *timing, const rtt_est_t *rtt, int frame_bytes)
+{
+    uint32_t wire_us = rtu_timing_bytes_us(timing, frame_bytes);
+    uint32_t rto_us = TIMEOUT_INITIAL * 1000;
+
+    if (rtt) {
+        rto_us = rtt_est_rto_us(rtt, 2 * timing->t35_us, TIMEOUT_INITIAL * 1000, TIMEOUT_MAX * 1000);
+    }
+    return (wire_us + rto_us + 999) / 1000;
+}
+
+// 用本次事务的请求延迟更新从站应答时间估计，扣除请求和响应帧本身的传输时间
+static void update_rtt(const rtu_timing_t *timing, rtt_est_t *rtt, const poll_read_t *read, int read_len,
+                       uint32_t latency_us)
+{
+    if (rtt == NULL) {
+        return;
+    }
+
+    uint32_t wire_us = rtu_timing_bytes_us(timing, read->frame_len + read_len);
+    rtt_est_sample(rtt, (latency_us > wire_us) ? latency_us - wire_us : 0);
+}
+
+// 将合并读取的结果直接从响应帧拆分到各成员组的数据区，data 为响应中的数据字段
+static void distribute_read(const poll_read_t *read, const uint8_t *data, int64_t sample_us, uint32_t latency_us)
+{
+    for (int k = 0; k < read->group_count; k++)
+    {
+        int g = read->groups[k];
+        const poll_group_config_t *group = &modbus_config.groups[g];
+        int offset = group->start_addr - read->start_addr;
+
+        // 配置已变更但计划尚未重建时，组不再落在本次读取的范围内
+        if (offset < 0 || offset + group->reg_count > read->count) {
+            continue;
         }
-    } else {
-        // 通信失败，增加失败计数并立即增加超时时间
-        timeout_failure_count[group_index]++;
-        timeout_success_count[group_index] = 0;
-        
-        // 失败后立即增加超时时间
-        if (group_timeouts[group_index] < TIMEOUT_MAX - TIMEOUT_ADJUST_UP) {
-            group_timeouts[group_index] += TIMEOUT_ADJUST_UP;
-            //ESP_LOGI(TAG, "组 %d 通信失败，增加超时至 %" PRIu32 " ms", group_index, group_timeouts[group_index]);
+
+        // 由未就绪变为就绪时所有数据都视为变化
+        bool force = !modbus_data.register_ready[g];
+
+        // 更新期间读端会重读，保证读到的是完整的一次采集结果
+        modbus_data_write_begin(g);
+        size_t size;
+        void *area = modbus_data_area(g, read->function_code, &size);
+        if (area == NULL) {
+            modbus_data_write_end(g);
+            continue;
+        }
+        switch (read->function_code)
+        {
+        case 1:
+        case 2:
+        {
+            /* 确保不超过数据区边界 */
+            int num_bits = group->reg_count < (int)size * 8 ? group->reg_count : (int)size * 8;
+
+            /* 响应中的位已按字节打包，从组的起始位整字取出 */
+            modbus_data_update_bits(g, area, data, offset, num_bits, force);
+            break;
         }
+        case 3:
+        case 4:
+        {
+            int num_regs = group->reg_count < (int)(size / 2) ? group->reg_count : (int)(size / 2);
+            modbus_data_update_regs(g, area, data + offset * 2, num_regs, force);
+            break;
+        }
+        }
+
+        modbus_data.register_ready[g] = true;
+        modbus_data_set_sample(g, MODBUS_QUALITY_GOOD, sample_us, latency_us);
+        modbus_data_write_end(g);
     }
 }
 
-void modbus_poll_task(void *pvParameters)
+// 串口驱动边收边解析出的完整帧CRC已校验，解析响应时不必再算一遍
+static void mark_crc_verified(modbus_context_t *mb_ctx)
+{
+    const agile_modbus_parser_t *parser = &mb_ctx->parser;
+    agile_modbus_rtu_set_crc_verified(&mb_ctx->ctx_rtu,
+                                      parser->status == AGILE_MODBUS_PARSE_COMPLETE ? parser->frame_length : 0);
+}
+
+// 对一个(可能由多个组合并而成的)读请求执行一次请求/响应事务，返回是否采集成功
+static bool poll_read(modbus_context_t *mb_ctx, const poll_read_t *read)
 {
-    // 获取传入的 Modbus 上下文指针
-    modbus_context_t *mb_ctx = (modbus_context_t *)pvParameters;
     // 获取 Modbus RTU 上下文
     agile_modbus_t *ctx = &mb_ctx->ctx_rtu._ctx;
-    uint8_t target_uart = mb_ctx->uart_port;
+    int first = read->groups[0];
 
-    while (1)
+    // 请求帧在生成轮询计划时已缓存(含CRC)
+    if (read->frame_len == 0)
+    {
+        ESP_LOGE(TAG, "UART%d 组 %d FC%d 请求打包失败",
+                 mb_ctx->uart_port, first, read->function_code);
+        read_failed(read, MODBUS_QUALITY_EXCEPTION, esp_timer_get_time(), 0);
+        return false;
+    }
+
+    rtu_port_t *port = mb_ctx->port;
+    const rtu_timing_t *timing = rtu_port_timing(port);
+    rtt_est_t *rtt = slave_health_rtt(&mb_ctx->health, read->slave_addr);
+    uint32_t current_timeout = read_timeout_ms(timing, rtt, read->frame_len + read->rsp_len);
+
+    // 直接发送缓存的请求帧并等待响应
+    rtu_port_send(port, read->frame, read->frame_len);
+    int read_len = rtu_port_receive(port, ctx->read_buf, ctx->read_bufsz, current_timeout, &mb_ctx->parser);
+    mark_crc_verified(mb_ctx);
+
+    // 采集时间取收到响应帧的时刻，超时则取判定超时的时刻
+    int64_t tx_us, rx_us;
+    rtu_port_frame_times(port, &tx_us, &rx_us);
+    if (read_len <= 0 || rx_us < tx_us) {
+        rx_us = esp_timer_get_time();
+    }
+    uint32_t latency_us = (uint32_t)(rx_us - tx_us);
+
+    // 记录从站是否有应答(异常响应也算在线)，状态切换时打印
+    if (slave_health_report(&mb_ctx->health, read->slave_addr, read_len > 0, esp_timer_get_time()))
     {
-        // 遍历所有的 Modbus 组
-        for (int i = 0; i < modbus_config.group_count; i++)
+        if (read_len > 0) {
+            ESP_LOGI(TAG, "UART%d 从站 %d 恢复应答，恢复正常轮询", mb_ctx->uart_port, read->slave_addr);
+        } else {
+            ESP_LOGW(TAG, "UART%d 从站 %d 连续 %d 次无应答，判定离线，改为间隔探测",
+                     mb_ctx->uart_port, read->slave_addr, SLAVE_DOWN_THRESHOLD);
+        }
+    }
+
+    if (read_len <= 0)
+    {
+        ESP_LOGE(TAG, "UART%d 组 %d FC%d 读取超时 (timeout: %" PRIu32 " ms)",
+                 mb_ctx->uart_port, first, read->function_code, current_timeout);
+        // 超时后下次超时值加倍，直到得到新的应答样本
+        if (rtt) {
+            rtt_est_timeout(rtt);
+        }
+        read_failed(read, MODBUS_QUALITY_TIMEOUT, rx_us, latency_us);
+        return false;
+    }
+
+    int rc = -1;
+    const uint8_t *data = NULL;
+
+    // 响应校验以缓存帧作为请求进行比对，解析后恢复原发送缓冲区
+    uint8_t *send_buf = ctx->send_buf;
+    int send_bufsz = ctx->send_bufsz;
+    ctx->send_buf = (uint8_t *)read->frame;
+    ctx->send_bufsz = read->frame_len;
+
+    // 根据功能码校验响应，只取得数据字段在接收缓冲区中的位置，不展开
+    switch (read->function_code)
+    {
+    case 1: // Read Coils
+        rc = agile_modbus_deserialize_read_bits_packed(ctx, read_len, &data);
+        break;
+    case 2: // Read Discrete Inputs
+        rc = agile_modbus_deserialize_read_input_bits_packed(ctx, read_len, &data);
+        break;
+    case 3: // Read Holding Registers
+        rc = agile_modbus_deserialize_read_registers_raw(ctx, read_len, &data);
+        break;
+    case 4: // Read Input Registers
+        rc = agile_modbus_deserialize_read_input_registers_raw(ctx, read_len, &data);
+        break;
+    }
+
+    ctx->send_buf = send_buf;
+    ctx->send_bufsz = send_bufsz;
+
+    // 只有完整有效的响应(包括异常响应)才作为应答时间样本
+    if (rc >= 0 || rc <= -128) {
+        update_rtt(timing, rtt, read, read_len, latency_us);
+    }
+
+    if (rc < 0)
+    {
+        ESP_LOGE(TAG, "UART%d 组 %d FC%d 数据解析失败，接收数据长度: %d",
+                 mb_ctx->uart_port, first, read->function_code, read_len);
+        // 合并后的读取跨越了从站不存在的地址，拆开成员组重新规划
+        if (rc == -128 - AGILE_MODBUS_EXCEPTION_ILLEGAL_DATA_ADDRESS && read->group_count > 1)
         {
-            // 直接跳过不匹配的 UART 组
-            if (!modbus_config.groups[i].enabled || 
-                modbus_config.groups[i].uart_port != target_uart) {
-                continue;
+            ESP_LOGW(TAG, "UART%d 从站 %d FC%d 合并读取 %d-%d 地址非法，成员组改为单独读取",
+                     mb_ctx->uart_port, read->slave_addr, read->function_code,
+                     read->start_addr, read->start_addr + read->count - 1);
+            for (int k = 0; k < read->group_count; k++) {
+                mb_ctx->no_merge[read->groups[k]] = true;
             }
+            mb_ctx->replan = true;
+        }
+        read_failed(read, MODBUS_QUALITY_EXCEPTION, rx_us, latency_us);
+        return false;
+    }
 
-            // 设置当前组的从设备地址
-            agile_modbus_set_slave(ctx, modbus_config.groups[i].slave_addr);
-
-            int send_len = 0;
-            // 根据功能码选择合适的 Modbus 请求序列化方式
-            switch (modbus_config.groups[i].function_code)
-            {
-            case 1: // Read Coils
-                send_len = agile_modbus_serialize_read_bits(ctx,
-                                                            modbus_config.groups[i].start_addr,
-                                                            modbus_config.groups[i].reg_count);
-                break;
-            case 2: // Read Discrete Inputs
-                send_len = agile_modbus_serialize_read_input_bits(ctx,
-                                                                  modbus_config.groups[i].start_addr,
-                                                                  modbus_config.groups[i].reg_count);
-                break;
-            case 3: // Read Holding Registers
-                send_len = agile_modbus_serialize_read_registers(ctx,
-                                                                 modbus_config.groups[i].start_addr,
-                                                                 modbus_config.groups[i].reg_count);
-                break;
-            case 4: // Read Input Registers
-                send_len = agile_modbus_serialize_read_input_registers(ctx,
-                                                                       modbus_config.groups[i].start_addr,
-                                                                       modbus_config.groups[i].reg_count);
-                break;
-            default:
-                ESP_LOGE(TAG, "UART%d 组 %d 不支持的功能码: %d",
-                         mb_ctx->uart_port, i, modbus_config.groups[i].function_code);
-                continue;
-            }
+    distribute_read(read, data, rx_us, latency_us);
+    ESP_LOGI(TAG, "UART%d 组 %d FC%d 数据采集成功 (合并 %d 组, timeout: %" PRIu32 " ms)，接收数据长度: %d",
+             mb_ctx->uart_port, first, read->function_code, read->group_count, current_timeout, read_len);
+    return true;
+}
 
-            // 如果请求序列化成功
-            if (send_len > 0)
-            {
-                int read_len = -1;  // 初始化为-1
-                // 获取当前组的超时时间
-                uint32_t current_timeout = group_timeouts[i];
-                
-                // 根据 UART 端口选择不同的发送和接收函数
-                if (mb_ctx->uart_port == 1)
-                {
-                    send_data1(ctx->send_buf, send_len);
-                    read_len = receive_data1(ctx->read_buf, ctx->read_bufsz, current_timeout);
-                }
-                else if (mb_ctx->uart_port == 2)
-                {
-                    send_data2(ctx->send_buf, send_len);
-                    read_len = receive_data2(ctx->read_buf, ctx->read_bufsz, current_timeout);
-                }
-                else if (mb_ctx->uart_port == 3)  // UART3 使用 UART0 的物理接口
-                {
-                    send_data0(ctx->send_buf, send_len);
-                    read_len = receive_data0(ctx->read_buf, ctx->read_bufsz, current_timeout);
-                }
-                else 
-                {
-                    ESP_LOGE(TAG, "无效的 UART 端口: %d", mb_ctx->uart_port);
-                }
-
-                if (read_len > 0)
-                {
-                    int rc = -1;
-
-                    // 根据功能码选择合适的反序列化方式并存储到对应区域
-                    switch (modbus_config.groups[i].function_code)
-                    {
-                    case 1:
-                    {   // Read Coils
-                        /* 每个元素存储一个位 */
-                        uint8_t bit_values[MAX_BITS] = {0};
-                        rc = agile_modbus_deserialize_read_bits(ctx, read_len, bit_values);
-                        if (rc >= 0)
-                        {
-                            /* 确保不超过寄存器容量和数组边界 */
-                            int max_bits = sizeof(modbus_data.coils[i]) * 8;
-                            int num_bits = rc < max_bits ? rc : max_bits;
-
-                            /* 逐个位存储到对应字节的对应bit位 */
-                            for (int j = 0; j < num_bits; j++)
-                            {
-                                int byte_idx = j / 8;
-                                int bit_idx = j % 8;
-                                if (bit_values[j])
-                                {
-                                    modbus_data.coils[i][byte_idx] |= (1 << bit_idx);
-                                }
-                                else
-                                {
-                                    modbus_data.coils[i][byte_idx] &= ~(1 << bit_idx);
-                                }
-                            }
-                        }
-                        break;
-                    }
-                    case 2:
-                    { // Read Discrete Inputs
-                        uint8_t bit_values[MAX_BITS] = {0};
-                        rc = agile_modbus_deserialize_read_input_bits(ctx, read_len, bit_values);
-                        if (rc >= 0)
-                        {
-                            int max_bits = sizeof(modbus_data.discrete_inputs[i]) * 8;
-                            int num_bits = rc < max_bits ? rc : max_bits;
-
-                            for (int j = 0; j < num_bits; j++)
-                            {
-                                int byte_idx = j / 8;
-                                int bit_idx = j % 8;
-                                if (bit_values[j])
-                                {
-                                    modbus_data.discrete_inputs[i][byte_idx] |= (1 << bit_idx);
-                                }
-                                else
-                                {
-                                    modbus_data.discrete_inputs[i][byte_idx] &= ~(1 << bit_idx);
-                                }
-                            }
-                        }
-                        break;
-                    }
-                    case 3:
-                    { // Read Holding Registers
-                        uint16_t reg_values[MAX_REGS] = {0};
-                        rc = agile_modbus_deserialize_read_registers(ctx, read_len, reg_values);
-                        if (rc >= 0)
-                        {
-                            memcpy(modbus_data.holding_regs[i], reg_values,
-                                   sizeof(uint16_t) * modbus_config.groups[i].reg_count);
-                        }
-                        break;
-                    }
-                    case 4:
-                    { // Read Input Registers
-                        uint16_t reg_values[MAX_REGS] = {0};
-                        rc = agile_modbus_deserialize_read_input_registers(ctx, read_len, reg_values);
-                        if (rc >= 0)
-                        {
-                            memcpy(modbus_data.input_regs[i], reg_values,
-                                   sizeof(uint16_t) * modbus_config.groups[i].reg_count);
-                        }
-                        break;
-                    }
-                    }
-
-                    if (rc >= 0)
+// 广播帧之后的等待：驱动确认发送完毕，且从开始发送起经过帧传输时间、t3.5和广播转换延时。
+// 只按驱动的发送完成返回会让下一帧紧接在广播帧后面，从站会把两帧并成一帧或丢弃
+static void wait_broadcast_turnaround(rtu_port_t *port, int send_len)
 {
-    modbus_data.register_ready[i] = true;
-    // 通信成功，调整超时
-    adjust_timeout(i, true);
-    ESP_LOGI(TAG, "UART%d 组 %d FC%d 数据采集成功 (timeout: %" PRIu32 " ms)，接收数据长度: %d",
-             mb_ctx->uart_port, i, modbus_config.groups[i].function_code, current_timeout, read_len);
+    const rtu_timing_t *timing = rtu_port_timing(port);
+    uint32_t frame_us = rtu_timing_bytes_us(timing, send_len);
+    int64_t tx_us;
+
+    if (!rtu_port_wait_tx_done(port, frame_us / 1000 + TIMEOUT_MAX)) {
+        ESP_LOGW(TAG, "%s 广播帧发送未在超时内完成", port->name);
+    }
+    rtu_port_frame_times(port, &tx_us, NULL);
+
+    int64_t wait_us = tx_us + frame_us + timing->t35_us + (int64_t)modbus_config.broadcast_delay_ms * 1000 -
+                      esp_timer_get_time();
+    if (wait_us > 0) {
+        // 向上取整再加一个tick，vTaskDelay 的第一个tick可能不足一个周期
+        vTaskDelay((TickType_t)((wait_us + portTICK_PERIOD_MS * 1000 - 1) / (portTICK_PERIOD_MS * 1000)) + 1);
+    }
 }
-else
+
+// 执行一批写命令(FC05/06/15/16)，返回写命令结果
+static int execute_write(modbus_context_t *mb_ctx, const write_req_t *req)
 {
-    ESP_LOGE(TAG, "UART%d 组 %d FC%d 数据解析失败，接收数据长度: %d",
-             mb_ctx->uart_port, i, modbus_config.groups[i].function_code, read_len);
-    modbus_data.register_ready[i] = false;
-    // 通信失败，调整超时
-    adjust_timeout(i, false);
+    agile_modbus_t *ctx = &mb_ctx->ctx_rtu._ctx;
+    rtu_port_t *port = mb_ctx->port;
+    const rtu_timing_t *timing = rtu_port_timing(port);
+    int send_len = -1;
+    int rc = -1;
+
+    agile_modbus_set_slave(ctx, req->slave_addr);
+    switch (req->function_code)
+    {
+    case 5: // Write Single Coil
+        send_len = agile_modbus_serialize_write_bit(ctx, req->addr, req->bits[0] & 0x01);
+        break;
+    case 6: // Write Single Register
+        send_len = agile_modbus_serialize_write_register(ctx, req->addr, req->regs[0]);
+        break;
+    case 15: // Write Multiple Coils
+        send_len = agile_modbus_serialize_write_bits_packed(ctx, req->addr, req->count, req->bits);
+        break;
+    case 16: // Write Multiple Registers
+        send_len = agile_modbus_serialize_write_registers(ctx, req->addr, req->count, req->regs);
+        break;
+    }
+    if (send_len <= 0) {
+        return WRITE_ERR_FRAME;
+    }
+
+    rtu_port_send(port, ctx->send_buf, send_len);
+    // 广播写入从站不应答，等帧发完并留出转换延时后下一帧才能发送
+    if (req->slave_addr == 0) {
+        wait_broadcast_turnaround(port, send_len);
+        return WRITE_OK;
+    }
+
+    int rsp_len = agile_modbus_compute_response_length_from_request(ctx, ctx->send_buf);
+    rtt_est_t *rtt = slave_health_rtt(&mb_ctx->health, req->slave_addr);
+    uint32_t timeout = read_timeout_ms(timing, rtt, send_len + rsp_len);
+    int read_len = rtu_port_receive(port, ctx->read_buf, ctx->read_bufsz, timeout, &mb_ctx->parser);
+    mark_crc_verified(mb_ctx);
+
+    slave_health_report(&mb_ctx->health, req->slave_addr, read_len > 0, esp_timer_get_time());
+    if (read_len <= 0) {
+        if (rtt) {
+            rtt_est_timeout(rtt);
+        }
+        return WRITE_ERR_TIMEOUT;
+    }
+
+    switch (req->function_code)
+    {
+    case 5:
+        rc = agile_modbus_deserialize_write_bit(ctx, read_len);
+        break;
+    case 6:
+        rc = agile_modbus_deserialize_write_register(ctx, read_len);
+        break;
+    case 15:
+        rc = agile_modbus_deserialize_write_bits(ctx, read_len);
+        break;
+    case 16:
+        rc = agile_modbus_deserialize_write_registers(ctx, read_len);
+        break;
+    }
+
+    if (rc <= -128) {
+        return rc;
+    }
+    return (rc < 0) ? WRITE_ERR_FRAME : WRITE_OK;
 }
-                }
-                else
-                {
-                    ESP_LOGE(TAG, "UART%d 组 %d FC%d 读取超时 (timeout: %" PRIu32 " ms)",
-                             mb_ctx->uart_port, i, modbus_config.groups[i].function_code, current_timeout);
-                    modbus_data.register_ready[i] = false;
-                    // 通信失败，调整超时
-                    adjust_timeout(i, false);
-                }
-            }
-            else
-            {
-                ESP_LOGE(TAG, "UART%d 组 %d FC%d 请求打包失败",
-                         mb_ctx->uart_port, i, modbus_config.groups[i].function_code);
-                modbus_data.register_ready[i] = false;
+
+// 在两次轮询之间执行串口上排队的全部写命令，写命令优先于后台轮询
+static void process_writes(modbus_context_t *mb_ctx)
+{
+    write_batch_t *batch = &mb_ctx->write_batch;
+
+    while (write_queue_take(mb_ctx->uart_port, batch, modbus_config.coalesce))
+    {
+        const write_req_t *req = &batch->req;
+        int64_t now = esp_timer_get_time();
+        uint32_t waited_ms = (uint32_t)((now - batch->queued_us) / 1000);
+        int result;
+
+        if (waited_ms > WRITE_EXPIRE_MS) {
+            result = WRITE_ERR_EXPIRED;
+        } else {
+            if (waited_ms > WRITE_LATENCY_TARGET_MS) {
+                ESP_LOGW(TAG, "UART%d 写命令排队 %" PRIu32 " ms，超过目标 %d ms",
+                         mb_ctx->uart_port, waited_ms, WRITE_LATENCY_TARGET_MS);
             }
+            result = execute_write(mb_ctx, req);
+        }
+
+        if (result == WRITE_OK) {
+            ESP_LOGI(TAG, "UART%d 从站 %d FC%d 写入 %d-%d 成功 (合并 %d 条)",
+                     mb_ctx->uart_port, req->slave_addr, req->function_code,
+                     req->addr, req->addr + req->count - 1, batch->done_count);
+        } else {
+            ESP_LOGE(TAG, "UART%d 从站 %d FC%d 写入 %d-%d 失败: %d",
+                     mb_ctx->uart_port, req->slave_addr, req->function_code,
+                     req->addr, req->addr + req->count - 1, result);
         }
-        vTaskDelay(pdMS_TO_TICKS(modbus_config.poll_interval));
+        write_queue_complete(batch, result);
     }
-}
\ No newline at end of file
+}
+
+// 估算一次事务占用总线的时间(us)：请求帧 + 响应帧 + 两个t3.5帧间隔 + 从站应答余量
+static uint32_t estimate_transaction_us(rtu_port_t *port, const poll_read_t *read)
+{
+    const rtu_timing_t *timing = rtu_port_timing(port);
+
+    return rtu_timing_bytes_us(timing, read->frame_len + read->rsp_len) +
+           2 * timing->t35_us + SLAVE_TURNAROUND_US;
+}
+
+// 根据当前配置重建本串口的轮询计划和调度表
+static void build_schedule(modbus_context_t *mb_ctx)
+{
+    poll_plan_t *plan = &mb_ctx->plan;
+    poll_sched_t *sched = &mb_ctx->sched;
+    int64_t now = esp_timer_get_time();
+
+    poll_plan_build(plan, &modbus_config, mb_ctx->uart_port, mb_ctx->no_merge);
+
+    poll_sched_reset(sched);
+    int groups = 0;
+    for (int i = 0; i < plan->count; i++)
+    {
+        const poll_read_t *read = &plan->reads[i];
+        poll_sched_add(sched, i, read->period_ms * 1000, read->priority,
+                       estimate_transaction_us(mb_ctx->port, read), now);
+        groups += read->group_count;
+    }
+
+    uint32_t load = poll_sched_utilization(sched);
+    ESP_LOGI(TAG, "UART%d 调度表已更新: %d 个组合并为 %d 次读取，预计总线负载 %" PRIu32 ".%" PRIu32 "%%",
+             mb_ctx->uart_port, groups, plan->count, load / 10, load % 10);
+    if (load > 1000) {
+        ESP_LOGW(TAG, "UART%d 总线负载超过100%%，部分组将无法按周期轮询", mb_ctx->uart_port);
+    }
+}
+
+void modbus_poll_task(void *pvParameters)
+{
+    // 获取传入的 Modbus 上下文指针
+    modbus_context_t *mb_ctx = (modbus_context_t *)pvParameters;
+    poll_sched_t *sched = &mb_ctx->sched;
+    uint32_t generation = modbus_config_generation;
+
+    agile_modbus_parser_init(&mb_ctx->parser, &mb_ctx->ctx_rtu._ctx, AGILE_MODBUS_MSG_CONFIRMATION);
+    build_schedule(mb_ctx);
+    if (mb_ctx->port) {
+        write_queue_attach(mb_ctx->uart_port);
+    }
+
+    while (1)
+    {
+        // 配置变更后重建调度表，合并被拒绝的组保持单独读取直到下次配置变更
+        if (generation != modbus_config_generation) {
+            generation = modbus_config_generation;
+            memset(mb_ctx->no_merge, 0, sizeof(mb_ctx->no_merge));
+            mb_ctx->replan = true;
+        }
+        if (mb_ctx->replan) {
+            mb_ctx->replan = false;
+            build_schedule(mb_ctx);
+        }
+
+        process_writes(mb_ctx);
+
+        int64_t wait_us = 0;
+        int64_t start = esp_timer_get_time();
+        int index = poll_sched_next(sched, start, &wait_us);
+        if (index < 0)
+        {
+            // 没有到期的组，休眠到最近一次释放时间；调度表为空时按全局间隔等待配置变更
+            TickType_t ticks = (wait_us < 0) ? pdMS_TO_TICKS(modbus_config.poll_interval)
+                                             : (TickType_t)((wait_us + portTICK_PERIOD_MS * 1000 - 1) / (portTICK_PERIOD_MS * 1000));
+            // 等待期间有写命令入队时立即唤醒
+            write_queue_wait(mb_ctx->uart_port, ticks > 0 ? ticks : 1);
+            continue;
+        }
+
+        poll_sched_entry_t *entry = &sched->entries[index];
+        const poll_read_t *read = &mb_ctx->plan.reads[entry->item];
+
+        // 离线从站未到探测时间，跳过本周期，不占用总线
+        if (!slave_health_should_poll(&mb_ctx->health, read->slave_addr, start))
+        {
+            read_stale(read);
+            poll_sched_complete(sched, index, start, start);
+            continue;
+        }
+
+        int64_t cpu = perf_stage_begin();
+        poll_read(mb_ctx, read);
+        perf_stage_end(PERF_STAGE_RTU_POLL, cpu);
+
+        uint32_t missed = poll_sched_complete(sched, index, start, esp_timer_get_time());
+        if (missed > 0) {
+            ESP_LOGW(TAG, "UART%d 组 %d 错过截止时间 %" PRIu32 " 次 (累计 %" PRIu32 " 次，周期 %" PRIu32 " ms，单次耗时约 %" PRIu32 " us)",
+                     mb_ctx->uart_port, read->groups[0], missed, entry->misses,
+                     entry->period_us / 1000, entry->cost_us);
+        }
+    }
+}
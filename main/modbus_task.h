@@ -3,12 +3,25 @@
 
 #include "agile_modbus.h"
 #include "agile_modbus_rtu.h"
+#include "poll_plan.h"
+#include "rtu_port.h"
+#include "poll_sched.h"
+#include "slave_health.h"
+#include "write_queue.h"
 
 #define MODBUS_TASK_STACK_SIZE 4096
 
 typedef struct {
     agile_modbus_rtu_t ctx_rtu;
     uint8_t uart_port;
+    rtu_port_t *port;       // 本逻辑串口使用的串口驱动对象
+    agile_modbus_parser_t parser; // 响应帧流式解析器，串口驱动边收边解析
+    poll_plan_t plan;       // 本串口的轮询计划(合并后的读请求)
+    poll_sched_t sched;     // 本串口的轮询调度表
+    bool no_merge[MAX_POLL_GROUPS]; // 合并读取被从站拒绝的组
+    bool replan;            // 需要重建轮询计划
+    slave_health_t health;  // 本串口各从站的在线状态
+    write_batch_t write_batch; // 正在执行的写命令批次
 } modbus_context_t;
 
 void start_modbus(void);
@@ -1,8 +1,13 @@
 #include <string.h>
 #include "mqtt.h"
+#include "mqtt_payload.h"
+#include "mqtt_client.h"
 #include "esp_log.h"
 #include "modbus_config.h"
 #include "cJSON.h"
+#include "esp_timer.h"
+#include "write_queue.h"
+#include "perf_stage.h"
 #include "nvs_flash.h"
 #include "nvs.h"
 #include "esp_log.h"
@@ -14,6 +19,9 @@ static const char *TAG = "mqtt";
 #define JSON_BUFFER_SIZE 8192
 static char json_buffer[JSON_BUFFER_SIZE];
 
+// 各组已发布的版本和采样序号
+static mqtt_payload_state_t payload_state;
+
 // MQTT配置结构体的默认配置
 mqtt_config_t mqtt_config = {
     .broker_url = "",
@@ -34,6 +42,52 @@ static bool mqtt_connected = false;
 // 发布任务句柄
 static TaskHandle_t publish_task_handle = NULL;
 
+// 写命令主题：<topic>/write 接收写命令，结果发布到 <topic>/write/result
+static void write_topic(char *buf, size_t size, bool result)
+{
+    snprintf(buf, size, "%s/write%s", mqtt_config.topic, result ? "/result" : "");
+}
+
+// 写命令完成回调(在轮询任务中调用)，arg 为请求中的 id
+static void mqtt_write_done(int result, void *arg)
+{
+    char topic[80];
+    char payload[96];
+
+    if (mqtt_client == NULL) {
+        return;
+    }
+    write_topic(topic, sizeof(topic), true);
+    snprintf(payload, sizeof(payload), "{\"id\":%d,\"result\":\"%s\",\"code\":%d}",
+             (int)(intptr_t)arg, write_result_name(result), result);
+    // 只放入发送队列，不阻塞轮询任务
+    esp_mqtt_client_enqueue(mqtt_client, topic, payload, 0, 1, 0, true);
+}
+
+// 处理收到的写命令：{"id":1,"port":1,"slave":1,"fc":6,"addr":0,"values":[100]}
+static void mqtt_handle_write(const char *data, int len)
+{
+    static write_req_t write_req;
+    cJSON *root = cJSON_ParseWithLength(data, len);
+    if (root == NULL) {
+        ESP_LOGW(TAG, "Invalid write command JSON");
+        return;
+    }
+
+    cJSON *id = cJSON_GetObjectItem(root, "id");
+    intptr_t write_id = cJSON_IsNumber(id) ? id->valueint : 0;
+    esp_err_t err = write_req_from_json(root, &write_req);
+    cJSON_Delete(root);
+
+    if (err == ESP_OK) {
+        err = write_queue_submit(&write_req, mqtt_write_done, (void *)write_id);
+    }
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Write command %d rejected: %s", (int)write_id, esp_err_to_name(err));
+        mqtt_write_done(WRITE_ERR_FRAME, (void *)write_id);
+    }
+}
+
 // MQTT事件处理函数
 static void mqtt_event_handler(void *handler_args, esp_event_base_t base, int32_t event_id, void *event_data)
 {
@@ -44,8 +98,25 @@ static void mqtt_event_handler(void *handler_args, esp_event_base_t base, int32_
     case MQTT_EVENT_CONNECTED:
         ESP_LOGI(TAG, "MQTT Connected to broker");
         mqtt_connected = true;
+        {
+            char topic[80];
+            write_topic(topic, sizeof(topic), false);
+            esp_mqtt_client_subscribe(mqtt_client, topic, 1);
+        }
         break;
 
+    case MQTT_EVENT_DATA:
+    {
+        char topic[80];
+        write_topic(topic, sizeof(topic), false);
+        // 写命令不支持分片接收
+        if (event->current_data_offset == 0 && event->data_len == event->total_data_len &&
+            event->topic_len == (int)strlen(topic) && strncmp(event->topic, topic, event->topic_len) == 0) {
+            mqtt_handle_write(event->data, event->data_len);
+        }
+        break;
+    }
+
     case MQTT_EVENT_DISCONNECTED:
         ESP_LOGI(TAG, "MQTT Disconnected from broker");
         mqtt_connected = false;
@@ -68,210 +139,24 @@ static void mqtt_publish_task(void *pvParameters) {
     while (1) {
         if (mqtt_connected && mqtt_config.enabled) {
             ESP_LOGI(TAG, "Starting MQTT publish cycle");
-            
-            cJSON *root = cJSON_CreateObject();
-            if (!root) {
-                ESP_LOGE(TAG, "Failed to create root JSON object");
-                goto delay_continue;
-            }
 
-            bool any_group_ready = false;
-
-            for (int i = 0; i < mqtt_config.group_count; i++) {
-                uint8_t group_id = mqtt_config.group_ids[i];
-                if (group_id >= modbus_config.group_count ||
-                    !modbus_data.register_ready[group_id]) {
-                    ESP_LOGD(TAG, "Skipping group %d - not ready", group_id);
-                    continue;
-                }
-
-                ESP_LOGI(TAG, "Processing group %d", group_id);
-                
-                // 为每个组创建一个数组
-                cJSON *group_data = cJSON_CreateArray();
-                if (!group_data) {
-                    ESP_LOGE(TAG, "Failed to create group data array for group %d", group_id);
-                    continue;
-                }
-
-                bool success = true;
-                uint8_t function_code = modbus_config.groups[group_id].function_code;
-                uint16_t count = modbus_config.groups[group_id].reg_count;
-
-                //ESP_LOGI(TAG, "Processing function code %d with %d registers", function_code, count);
-
-                switch(function_code) {
-                    case 1:
-                    case 2: {
-                        //ESP_LOGI(TAG, "Processing coils/discrete inputs for group %d", group_id);
-                        uint8_t *bits = (function_code == 1) ?
-                                      modbus_data.coils[group_id] :
-                                      modbus_data.discrete_inputs[group_id];
-
-                        for (uint16_t j = 0; j < count && success; j++) {
-                            uint8_t byte_index = j / 8;
-                            uint8_t bit_index = j % 8;
-                            bool bit_value = (bits[byte_index] >> bit_index) & 0x01;
-                            cJSON *num = cJSON_CreateNumber(bit_value);
-                            if (!num) {
-                                ESP_LOGE(TAG, "Failed to create JSON number for bit %d", j);
-                                success = false;
-                            } else {
-                                cJSON_AddItemToArray(group_data, num);
-                            }
-                        }
-                        break;
-                    }
-
-                    case 3:
-                    case 4: {
-                        uint16_t *regs = (function_code == 3) ? 
-                                        modbus_data.holding_regs[group_id] :
-                                        modbus_data.input_regs[group_id];
-                        
-                        parse_method_t method = mqtt_config.parse_methods[group_id];
-                        //ESP_LOGI(TAG, "Using parse method %d", method);
-                        
-                        switch(method) {
-                            case PARSE_INT16_SIGNED:
-                            case PARSE_INT16_UNSIGNED: {
-                                for (uint16_t j = 0; j < count && success; j++) {
-                                    cJSON *num;
-                                    if (method == PARSE_INT16_SIGNED) {
-                                        num = cJSON_CreateNumber((int16_t)regs[j]);
-                                    } else {
-                                        num = cJSON_CreateNumber(regs[j]);
-                                    }
-                                    if (!num) {
-                                        ESP_LOGE(TAG, "Failed to create JSON number for register %d", j);
-                                        success = false;
-                                    } else {
-                                        cJSON_AddItemToArray(group_data, num);
-                                    }
-                                }
-                                break;
-                            }
-
-                            case PARSE_INT32_ABCD:
-                            case PARSE_INT32_CDAB:
-                            case PARSE_INT32_BADC:
-                            case PARSE_INT32_DCBA: {
-                                for (uint16_t j = 0; j < count && success; j += 2) {
-                                    uint32_t value;
-                                    switch(method) {
-                                        case PARSE_INT32_ABCD:
-                                            value = ((uint32_t)regs[j] << 16) | regs[j + 1];
-                                            break;
-                                        case PARSE_INT32_CDAB:
-                                            value = ((uint32_t)regs[j + 1] << 16) | regs[j];
-                                            break;
-                                        case PARSE_INT32_BADC:
-                                            value = ((uint32_t)(regs[j] & 0xFF00) << 8) |
-                                                   ((uint32_t)(regs[j] & 0x00FF) << 24) |
-                                                   ((uint32_t)(regs[j + 1] & 0xFF00) >> 8) |
-                                                   ((uint32_t)(regs[j + 1] & 0x00FF) << 8);
-                                            break;
-                                        case PARSE_INT32_DCBA:
-                                            value = ((uint32_t)(regs[j + 1] & 0xFF00) >> 8) |
-                                                   ((uint32_t)(regs[j + 1] & 0x00FF) << 8) |
-                                                   ((uint32_t)(regs[j] & 0xFF00) >> 24) |
-                                                   ((uint32_t)(regs[j] & 0x00FF) >> 8);
-                                            break;
-                                            default:
-                                            // 不会触发，但避免警告
-                                            break;
-                                    }
-                                    cJSON *num = cJSON_CreateNumber((int32_t)value);
-                                    if (!num) {
-                                        ESP_LOGE(TAG, "Failed to create JSON number for registers %d-%d", j, j+1);
-                                        success = false;
-                                    } else {
-                                        cJSON_AddItemToArray(group_data, num);
-                                    }
-                                }
-                                break;
-                            }
-
-                            case PARSE_FLOAT_ABCD:
-                            case PARSE_FLOAT_CDAB:
-                            case PARSE_FLOAT_BADC:
-                            case PARSE_FLOAT_DCBA: {
-                                for (uint16_t j = 0; j < count && success; j += 2) {
-                                    uint32_t raw;
-                                    switch(method) {
-                                        case PARSE_FLOAT_ABCD:
-                                            raw = ((uint32_t)regs[j] << 16) | regs[j + 1];
-                                            break;
-                                        case PARSE_FLOAT_CDAB:
-                                            raw = ((uint32_t)regs[j + 1] << 16) | regs[j];
-                                            break;
-                                        case PARSE_FLOAT_BADC:
-                                            raw = ((uint32_t)(regs[j] & 0xFF00) << 8) |
-                                                  ((uint32_t)(regs[j] & 0x00FF) << 24) |
-                                                  ((uint32_t)(regs[j + 1] & 0xFF00) >> 8) |
-                                                  ((uint32_t)(regs[j + 1] & 0x00FF) << 8);
-                                            break;
-                                        case PARSE_FLOAT_DCBA:
-                                            raw = ((uint32_t)(regs[j + 1] & 0xFF00) >> 8) |
-                                                  ((uint32_t)(regs[j + 1] & 0x00FF) << 8) |
-                                                  ((uint32_t)(regs[j] & 0xFF00) >> 24) |
-                                                  ((uint32_t)(regs[j] & 0x00FF) >> 8);
-                                            break;
-                                            default:
-                                            // 不会触发，但避免警告
-                                            break;
-                                    }
-                                    float value;
-                                    memcpy(&value, &raw, sizeof(float));
-                                    char number_buffer[32];
-                                    snprintf(number_buffer, sizeof(number_buffer), "%.4f", value); // 保留两位小数
-                                    cJSON *num = cJSON_CreateRaw(number_buffer);
-                                    if (!num) {
-                                        ESP_LOGE(TAG, "Failed to create JSON number for float registers %d-%d", j, j+1);
-                                        success = false;
-                                    } else {
-                                        cJSON_AddItemToArray(group_data, num);
-                                    }
-                                }
-                                break;
-                            }
-                        }
-                        break;
-                    }
-                }
-
-                if (success) {
-                    // 使用 group_id 作为键，直接添加到 root 对象中
-                    char group_key[16];
-                    snprintf(group_key, sizeof(group_key), "group%d", group_id);
-                    cJSON_AddItemToObject(root, group_key, group_data);
-                    any_group_ready = true;
-                    ESP_LOGI(TAG, "Successfully processed group %d", group_id);
-                } else {
-                    ESP_LOGE(TAG, "Failed to process group %d", group_id);
-                    cJSON_Delete(group_data);
-                }
-            }
-
-            if (any_group_ready) {
-                if (cJSON_PrintPreallocated(root, json_buffer, JSON_BUFFER_SIZE, 0)) {
-                    esp_mqtt_client_publish(mqtt_client,
-                                          mqtt_config.topic,
-                                          json_buffer,
-                                          0, 0, 0);
-                    ESP_LOGI(TAG, "Successfully published MQTT message");
-                } else {
-                    ESP_LOGE(TAG, "Failed to print JSON to buffer");
-                }
-            } else {
+            int64_t cpu = perf_stage_begin();
+            int len = mqtt_payload_build(&mqtt_config, &payload_state, json_buffer, JSON_BUFFER_SIZE,
+                                         esp_timer_get_time());
+            perf_stage_end(PERF_STAGE_MQTT_BUILD, cpu);
+            if (len > 0) {
+                esp_mqtt_client_publish(mqtt_client,
+                                      mqtt_config.topic,
+                                      json_buffer,
+                                      len, 0, 0);
+                ESP_LOGI(TAG, "Successfully published MQTT message");
+            } else if (len == 0) {
                 ESP_LOGW(TAG, "No groups were ready for publishing");
             }
-            cJSON_Delete(root);
         } else {
             ESP_LOGW(TAG, "MQTT not connected or disabled");
         }
 
-delay_continue:
         vTaskDelayUntil(&last_wake_time, pdMS_TO_TICKS(mqtt_config.publish_interval));
     }
 }
@@ -424,6 +309,11 @@ esp_err_t save_mqtt_config(mqtt_config_t *config) {
         goto end;
     }
 
+    if ((err = nvs_set_u8(nvs_handle, "pub_change", config->publish_on_change)) != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to save pub_change: %s", esp_err_to_name(err));
+        goto end;
+    }
+
     // 保存数组配置
     ESP_LOGI(TAG, "Saving group_ids, size: %d", sizeof(config->group_ids));
     err = nvs_set_blob(nvs_handle, "group_ids", config->group_ids, sizeof(config->group_ids));
@@ -509,6 +399,12 @@ esp_err_t load_mqtt_config(mqtt_config_t *config) {
     goto end;
     }
 
+    uint8_t publish_on_change;
+    err = nvs_get_u8(nvs_handle, "pub_change", &publish_on_change);
+    if (err == ESP_OK) {
+        config->publish_on_change = publish_on_change;
+    }
+
     // 读取数组配置
     size_t blob_size;
     
@@ -2,10 +2,10 @@
 #define _MQTT_H_
 
 #include <stdint.h>
+#include <stdbool.h>
 #include "esp_err.h"
-#include "mqtt_client.h"
 
-#define MAX_POLL_GROUPS 10
+#define MAX_POLL_GROUPS 64
 
 // 数据解析方式枚举
 typedef enum {
@@ -31,6 +31,7 @@ typedef struct {
     uint8_t group_ids[MAX_POLL_GROUPS];
     uint8_t group_count;
     uint32_t publish_interval;
+    bool publish_on_change;     // 只发布自上次发布以来数据有变化的组
     parse_method_t parse_methods[MAX_POLL_GROUPS];  // 每组的解析方式
 } mqtt_config_t;
 
@@ -0,0 +1,294 @@
+#include <stdio.h>
+#include <string.h>
+#include "mqtt_payload.h"
+#include "esp_log.h"
+
+static const char *TAG = "mqtt_payload";
+
+int mqtt_payload_build(const mqtt_config_t *config, mqtt_payload_state_t *state,
+                       char *buf, size_t size, int64_t now_us)
+{
+    cJSON *root = cJSON_CreateObject();
+    if (!root) {
+        ESP_LOGE(TAG, "Failed to create root JSON object");
+        return -1;
+    }
+
+    bool any_group_ready = false;
+    cJSON *samples = cJSON_CreateObject();
+
+    for (int i = 0; i < config->group_count; i++) {
+        uint8_t group_id = config->group_ids[i];
+        if (group_id >= modbus_config.group_count) {
+            continue;
+        }
+
+        // 只发布变化的组时，数据版本未变的组跳过
+        uint32_t version = modbus_data_version(group_id);
+        if (config->publish_on_change && version == state->published_version[group_id]) {
+            continue;
+        }
+
+        // 自上次发布后没有新的采样，跳过
+        if (modbus_data_sample_seq(group_id) == state->published_seq[group_id]) {
+            continue;
+        }
+
+        bool success = true;
+        uint8_t function_code = modbus_config.groups[group_id].function_code;
+        uint16_t count = modbus_config.groups[group_id].reg_count;
+        size_t snapshot_len = (function_code == 1 || function_code == 2) ?
+                              (count + 7) / 8 : count * sizeof(uint16_t);
+
+        modbus_sample_t sample;
+        if (snapshot_len > sizeof(state->snapshot) ||
+            !modbus_data_read_sample(group_id, function_code, 0, &state->snapshot, snapshot_len, &sample)) {
+            ESP_LOGD(TAG, "Skipping group %d - not ready", group_id);
+            continue;
+        }
+
+        ESP_LOGI(TAG, "Processing group %d", group_id);
+        
+        // 为每个组创建一个数组
+        cJSON *group_data = cJSON_CreateArray();
+        if (!group_data) {
+            ESP_LOGE(TAG, "Failed to create group data array for group %d", group_id);
+            continue;
+        }
+
+        //ESP_LOGI(TAG, "Processing function code %d with %d registers", function_code, count);
+
+        switch(function_code) {
+            case 1:
+            case 2: {
+                //ESP_LOGI(TAG, "Processing coils/discrete inputs for group %d", group_id);
+                const uint8_t *bits = state->snapshot.bits;
+
+                for (uint16_t j = 0; j < count && success; j++) {
+                    uint8_t byte_index = j / 8;
+                    uint8_t bit_index = j % 8;
+                    bool bit_value = (bits[byte_index] >> bit_index) & 0x01;
+                    cJSON *num = cJSON_CreateNumber(bit_value);
+                    if (!num) {
+                        ESP_LOGE(TAG, "Failed to create JSON number for bit %d", j);
+                        success = false;
+                    } else {
+                        cJSON_AddItemToArray(group_data, num);
+                    }
+                }
+                break;
+            }
+
+            case 3:
+            case 4: {
+                const uint16_t *regs = state->snapshot.regs;
+                
+                parse_method_t method = config->parse_methods[group_id];
+                //ESP_LOGI(TAG, "Using parse method %d", method);
+                
+                switch(method) {
+                    case PARSE_INT16_SIGNED:
+                    case PARSE_INT16_UNSIGNED: {
+                        for (uint16_t j = 0; j < count && success; j++) {
+                            cJSON *num;
+                            if (method == PARSE_INT16_SIGNED) {
+                                num = cJSON_CreateNumber((int16_t)regs[j]);
+                            } else {
+                                num = cJSON_CreateNumber(regs[j]);
+                            }
+                            if (!num) {
+                                ESP_LOGE(TAG, "Failed to create JSON number for register %d", j);
+                                success = false;
+                            } else {
+                                cJSON_AddItemToArray(group_data, num);
+                            }
+                        }
+                        break;
+                    }
+
+                    case PARSE_INT32_ABCD:
+                    case PARSE_INT32_CDAB:
+                    case PARSE_INT32_BADC:
+                    case PARSE_INT32_DCBA: {
+                        for (uint16_t j = 0; j < count && success; j += 2) {
+                            uint32_t value;
+                            switch(method) {
+                                case PARSE_INT32_ABCD:
+                                    value = ((uint32_t)regs[j] << 16) | regs[j + 1];
+                                    break;
+                                case PARSE_INT32_CDAB:
+                                    value = ((uint32_t)regs[j + 1] << 16) | regs[j];
+                                    break;
+                                case PARSE_INT32_BADC:
+                                    value = ((uint32_t)(regs[j] & 0xFF00) << 8) |
+                                           ((uint32_t)(regs[j] & 0x00FF) << 24) |
+                                           ((uint32_t)(regs[j + 1] & 0xFF00) >> 8) |
+                                           ((uint32_t)(regs[j + 1] & 0x00FF) << 8);
+                                    break;
+                                case PARSE_INT32_DCBA:
+                                    value = ((uint32_t)(regs[j + 1] & 0xFF00) >> 8) |
+                                           ((uint32_t)(regs[j + 1] & 0x00FF) << 8) |
+                                           ((uint32_t)(regs[j] & 0xFF00) >> 24) |
+                                           ((uint32_t)(regs[j] & 0x00FF) >> 8);
+                                    break;
+                                    default:
+                                    // 不会触发，但避免警告
+                                    break;
+                            }
+                            cJSON *num = cJSON_CreateNumber((int32_t)value);
+                            if (!num) {
+                                ESP_LOGE(TAG, "Failed to create JSON number for registers %d-%d", j, j+1);
+                                success = false;
+                            } else {
+                                cJSON_AddItemToArray(group_data, num);
+                            }
+                        }
+                        break;
+                    }
+
+                    case PARSE_FLOAT_ABCD:
+                    case PARSE_FLOAT_CDAB:
+                    case PARSE_FLOAT_BADC:
+                    case PARSE_FLOAT_DCBA: {
+                        for (uint16_t j = 0; j < count && success; j += 2) {
+                            uint32_t raw;
+                            switch(method) {
+                                case PARSE_FLOAT_ABCD:
+                                    raw = ((uint32_t)regs[j] << 16) | regs[j + 1];
+                                    break;
+                                case PARSE_FLOAT_CDAB:
+                                    raw = ((uint32_t)regs[j + 1] << 16) | regs[j];
+                                    break;
+                                case PARSE_FLOAT_BADC:
+                                    raw = ((uint32_t)(regs[j] & 0xFF00) << 8) |
+                                          ((uint32_t)(regs[j] & 0x00FF) << 24) |
+                                          ((uint32_t)(regs[j + 1] & 0xFF00) >> 8) |
+                                          ((uint32_t)(regs[j + 1] & 0x00FF) << 8);
+                                    break;
+                                case PARSE_FLOAT_DCBA:
+                                    raw = ((uint32_t)(regs[j + 1] & 0xFF00) >> 8) |
+                                          ((uint32_t)(regs[j + 1] & 0x00FF) << 8) |
+                                          ((uint32_t)(regs[j] & 0xFF00) >> 24) |
+                                          ((uint32_t)(regs[j] & 0x00FF) >> 8);
+                                    break;
+                                    default:
+                                    // 不会触发，但避免警告
+                                    break;
+                            }
+                            float value;
+                            memcpy(&value, &raw, sizeof(float));
+                            char number_buffer[32];
+                            snprintf(number_buffer, sizeof(number_buffer), "%.4f", value); // 保留两位小数
+                            cJSON *num = cJSON_CreateRaw(number_buffer);
+                            if (!num) {
+                                ESP_LOGE(TAG, "Failed to create JSON number for float registers %d-%d", j, j+1);
+                                success = false;
+                            } else {
+                                cJSON_AddItemToArray(group_data, num);
+                            }
+                        }
+                        break;
+                    }
+                }
+                break;
+            }
+        }
+
+        if (success) {
+            // 使用 group_id 作为键，直接添加到 root 对象中
+            char group_key[16];
+            snprintf(group_key, sizeof(group_key), "group%d", group_id);
+            cJSON_AddItemToObject(root, group_key, group_data);
+            any_group_ready = true;
+            state->published_version[group_id] = version;
+            state->published_seq[group_id] = sample.seq;
+
+            // 附带采样信息：采集时间(启动后ms)、距今时间、请求延迟和质量
+            cJSON *info = samples ? cJSON_AddObjectToObject(samples, group_key) : NULL;
+            if (info) {
+                cJSON_AddNumberToObject(info, "seq", sample.seq);
+                cJSON_AddNumberToObject(info, "ts_ms", (double)(sample.sample_us / 1000));
+                cJSON_AddNumberToObject(info, "age_ms", (double)((now_us - sample.sample_us) / 1000));
+                cJSON_AddNumberToObject(info, "latency_us", sample.latency_us);
+                cJSON_AddStringToObject(info, "quality", modbus_quality_name(sample.quality));
+            }
+            ESP_LOGI(TAG, "Successfully processed group %d", group_id);
+        } else {
+            ESP_LOGE(TAG, "Failed to process group %d", group_id);
+            cJSON_Delete(group_data);
+        }
+    }
+
+    if (samples) {
+        cJSON_AddItemToObject(root, "samples", samples);
+    }
+
+    int len = 0;
+    if (any_group_ready) {
+        if (cJSON_PrintPreallocated(root, buf, size, 0)) {
+            len = strlen(buf);
+        } else {
+            ESP_LOGE(TAG, "Failed to print JSON to buffer");
+            len = -1;
+        }
+    }
+    cJSON_Delete(root);
+    return len;
+}
+
+void mqtt_config_from_json(mqtt_config_t *config, const cJSON *root)
+{
+    cJSON *enabled = cJSON_GetObjectItem(root, "enabled");
+    cJSON *broker_url = cJSON_GetObjectItem(root, "broker_url");
+    cJSON *username = cJSON_GetObjectItem(root, "username");
+    cJSON *password = cJSON_GetObjectItem(root, "password");
+    cJSON *topic = cJSON_GetObjectItem(root, "topic");
+    cJSON *group_ids = cJSON_GetObjectItem(root, "group_ids");
+    cJSON *parse_methods = cJSON_GetObjectItem(root, "parse_methods");
+    cJSON *publish_interval = cJSON_GetObjectItem(root, "publish_interval");
+    cJSON *publish_on_change = cJSON_GetObjectItem(root, "publish_on_change");
+
+    if (enabled)
+        config->enabled = enabled->valueint;
+    if (broker_url && cJSON_IsString(broker_url)) {
+        strncpy(config->broker_url, broker_url->valuestring, sizeof(config->broker_url) - 1);
+    }
+    if (username && cJSON_IsString(username)) {
+        strncpy(config->username, username->valuestring, sizeof(config->username) - 1);
+    }
+    if (password && cJSON_IsString(password)) {
+        strncpy(config->password, password->valuestring, sizeof(config->password) - 1);
+    }
+    if (topic && cJSON_IsString(topic)) {
+        strncpy(config->topic, topic->valuestring, sizeof(config->topic) - 1);
+    }
+
+    // 处理组ID和解析方式数组
+    if (group_ids && cJSON_IsArray(group_ids) && parse_methods && cJSON_IsArray(parse_methods)) {
+        int count = cJSON_GetArraySize(group_ids);
+        int parse_count = cJSON_GetArraySize(parse_methods);
+
+        // 使用较小的数组大小作为实际数量
+        count = (count < parse_count) ? count : parse_count;
+        if (count > MAX_POLL_GROUPS)
+            count = MAX_POLL_GROUPS;
+        config->group_count = count;
+
+        for (int i = 0; i < count; i++) {
+            cJSON *group_id = cJSON_GetArrayItem(group_ids, i);
+            cJSON *parse_method = cJSON_GetArrayItem(parse_methods, i);
+
+            if (group_id && cJSON_IsNumber(group_id)) {
+                config->group_ids[i] = group_id->valueint;
+            }
+            if (parse_method && cJSON_IsNumber(parse_method)) {
+                config->parse_methods[i] = parse_method->valueint;
+            }
+        }
+    }
+
+    if (publish_interval)
+        config->publish_interval = publish_interval->valueint;
+    if (publish_on_change)
+        config->publish_on_change = cJSON_IsTrue(publish_on_change);
+}
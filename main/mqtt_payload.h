@@ -0,0 +1,29 @@
+#ifndef MQTT_PAYLOAD_H
+#define MQTT_PAYLOAD_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "cJSON.h"
+#include "mqtt.h"
+#include "modbus_config.h"
+
+// 负载生成状态：记录各组已发布的版本和采样序号，每个发布者一份
+typedef struct {
+    uint32_t published_version[MAX_POLL_GROUPS];    // 各组上次发布时的数据版本
+    uint32_t published_seq[MAX_POLL_GROUPS];        // 每组已发布的采样序号，同一次采样不重复发布
+    // 组数据快照，生成时从中读取，避免轮询任务更新到一半时读到撕裂的数据
+    union {
+        uint8_t bits[MAX_BIT_BYTES];
+        uint16_t regs[MAX_REGS];
+    } snapshot;
+} mqtt_payload_state_t;
+
+// 按配置把有新采样的组生成为一条JSON负载写入 buf，now_us 用于计算采样距今时间。
+// 返回负载长度；没有可发布的组返回0，生成失败返回-1
+int mqtt_payload_build(const mqtt_config_t *config, mqtt_payload_state_t *state,
+                       char *buf, size_t size, int64_t now_us);
+
+// 从JSON更新MQTT配置，字段与 /api/mqtt/config 相同，缺少的字段保持不变
+void mqtt_config_from_json(mqtt_config_t *config, const cJSON *root);
+
+#endif
@@ -0,0 +1,37 @@
+#include <time.h>
+#include "perf_stage.h"
+
+static perf_stage_stats_t stage_stats[PERF_STAGE_COUNT];
+
+static const char *stage_names[PERF_STAGE_COUNT] = {
+    [PERF_STAGE_RTU_POLL] = "rtu_poll",
+    [PERF_STAGE_TCP_REFRESH] = "tcp_refresh",
+    [PERF_STAGE_TCP_REQUEST] = "tcp_request",
+    [PERF_STAGE_MQTT_BUILD] = "mqtt_build",
+};
+
+// POSIX 模拟的 FreeRTOS 中每个任务是一个线程，线程CPU时钟不计入阻塞和休眠的时间
+int64_t perf_stage_begin(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+void perf_stage_end(perf_stage_t stage, int64_t begin)
+{
+    int64_t used = perf_stage_begin() - begin;
+    __atomic_fetch_add(&stage_stats[stage].cpu_us, used > 0 ? (uint64_t)used : 0, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&stage_stats[stage].calls, 1, __ATOMIC_RELAXED);
+}
+
+void perf_stage_get(perf_stage_t stage, perf_stage_stats_t *stats)
+{
+    stats->cpu_us = __atomic_load_n(&stage_stats[stage].cpu_us, __ATOMIC_RELAXED);
+    stats->calls = __atomic_load_n(&stage_stats[stage].calls, __ATOMIC_RELAXED);
+}
+
+const char *perf_stage_name(perf_stage_t stage)
+{
+    return stage < PERF_STAGE_COUNT ? stage_names[stage] : "unknown";
+}
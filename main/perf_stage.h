@@ -0,0 +1,41 @@
+#ifndef PERF_STAGE_H
+#define PERF_STAGE_H
+
+#include <stdint.h>
+#include "sdkconfig.h"
+
+// 数据通路各处理阶段的CPU时间统计，供主机构建的性能测试使用；
+// 设备固件中为空操作，不影响轮询和TCP处理的开销
+
+typedef enum {
+    PERF_STAGE_RTU_POLL,        // 一次串口读事务：组帧、收发、解析、写入数据存储
+    PERF_STAGE_TCP_REFRESH,     // 从数据存储刷新TCP从站寄存器表
+    PERF_STAGE_TCP_REQUEST,     // 处理一个TCP请求
+    PERF_STAGE_MQTT_BUILD,      // 生成一条MQTT负载
+    PERF_STAGE_COUNT
+} perf_stage_t;
+
+typedef struct {
+    uint64_t cpu_us;        // 累计CPU时间
+    uint32_t calls;         // 累计次数
+} perf_stage_stats_t;
+
+#if CONFIG_IDF_TARGET_LINUX
+// 取得当前任务(线程)已用的CPU时间，作为 perf_stage_end 的起点
+int64_t perf_stage_begin(void);
+// 把从 begin 起当前任务用掉的CPU时间计入阶段 stage，可在多个任务中同时调用
+void perf_stage_end(perf_stage_t stage, int64_t begin);
+void perf_stage_get(perf_stage_t stage, perf_stage_stats_t *stats);
+const char *perf_stage_name(perf_stage_t stage);
+#else
+static inline int64_t perf_stage_begin(void)
+{
+    return 0;
+}
+
+static inline void perf_stage_end(perf_stage_t stage, int64_t begin)
+{
+}
+#endif
+
+#endif
@@ -0,0 +1,147 @@
+#include <string.h>
+#include "poll_plan.h"
+
+// 单次读取允许的最大数量
+static int max_read_count(uint8_t function_code)
+{
+    return (function_code == 1 || function_code == 2) ? AGILE_MODBUS_MAX_READ_BITS : MAX_REGS;
+}
+
+// 排序比较：从站地址、功能码、周期、起始地址
+static bool group_before(const modbus_config_t *config, int a, int b)
+{
+    const poll_group_config_t *ga = &config->groups[a];
+    const poll_group_config_t *gb = &config->groups[b];
+
+    if (ga->slave_addr != gb->slave_addr)
+        return ga->slave_addr < gb->slave_addr;
+    if (ga->function_code != gb->function_code)
+        return ga->function_code < gb->function_code;
+    if (modbus_group_period_ms(ga) != modbus_group_period_ms(gb))
+        return modbus_group_period_ms(ga) < modbus_group_period_ms(gb);
+    return ga->start_addr < gb->start_addr;
+}
+
+// 以组新建一个读请求，member 指向该组在成员表中的位置
+static void start_read(poll_read_t *read, const poll_group_config_t *group, const uint8_t *member)
+{
+    memset(read, 0, sizeof(*read));
+    read->slave_addr = group->slave_addr;
+    read->function_code = group->function_code;
+    read->start_addr = group->start_addr;
+    read->count = group->reg_count;
+    read->period_ms = modbus_group_period_ms(group);
+    read->priority = group->priority;
+    read->groups = member;
+    read->group_count = 1;
+}
+
+// 尝试把组并入已有读请求，成功返回 true；组在成员表中紧跟在读请求已有成员之后
+static bool try_merge(poll_read_t *read, const poll_group_config_t *group, uint16_t gap)
+{
+    if (read->slave_addr != group->slave_addr ||
+        read->function_code != group->function_code ||
+        read->period_ms != modbus_group_period_ms(group)) {
+        return false;
+    }
+
+    uint32_t read_end = (uint32_t)read->start_addr + read->count;     // 不含
+    uint32_t group_end = (uint32_t)group->start_addr + group->reg_count;
+    if (group->start_addr > read_end + gap) {
+        return false;
+    }
+
+    uint32_t new_end = group_end > read_end ? group_end : read_end;
+    if (new_end - read->start_addr > (uint32_t)max_read_count(read->function_code)) {
+        return false;
+    }
+
+    read->count = new_end - read->start_addr;
+    if (group->priority > read->priority) {
+        read->priority = group->priority;
+    }
+    read->group_count++;
+    return true;
+}
+
+// 生成读请求的完整RTU帧，CRC只在配置变更时计算一次
+static void build_frame(poll_read_t *read)
+{
+    agile_modbus_rtu_t rtu;
+    agile_modbus_t *ctx = &rtu._ctx;
+    int len = -1;
+
+    agile_modbus_rtu_init(&rtu, read->frame, sizeof(read->frame), NULL, 0);
+    agile_modbus_set_slave(ctx, read->slave_addr);
+
+    switch (read->function_code) {
+    case 1:
+        len = agile_modbus_serialize_read_bits(ctx, read->start_addr, read->count);
+        break;
+    case 2:
+        len = agile_modbus_serialize_read_input_bits(ctx, read->start_addr, read->count);
+        break;
+    case 3:
+        len = agile_modbus_serialize_read_registers(ctx, read->start_addr, read->count);
+        break;
+    case 4:
+        len = agile_modbus_serialize_read_input_registers(ctx, read->start_addr, read->count);
+        break;
+    }
+
+    read->frame_len = (len > 0) ? len : 0;
+    // 主站知道请求内容，预先算出响应长度，接收时收满即可返回
+    read->rsp_len = (len > 0) ? agile_modbus_compute_response_length_from_request(ctx, read->frame) : 0;
+}
+
+int poll_plan_build(poll_plan_t *plan, const modbus_config_t *config, uint8_t uart_port, const bool *no_merge)
+{
+    int order[MAX_POLL_GROUPS];
+    int n = 0;
+
+    memset(plan, 0, sizeof(*plan));
+
+    // 收集本串口的有效组，并按插入排序整理
+    for (int i = 0; i < config->group_count && i < MAX_POLL_GROUPS; i++) {
+        const poll_group_config_t *group = &config->groups[i];
+        if (!group->enabled || group->uart_port != uart_port ||
+            group->function_code < 1 || group->function_code > 4 ||
+            group->reg_count == 0 || group->reg_count > max_read_count(group->function_code)) {
+            continue;
+        }
+
+        int pos = n++;
+        while (pos > 0 && group_before(config, i, order[pos - 1])) {
+            order[pos] = order[pos - 1];
+            pos--;
+        }
+        order[pos] = i;
+    }
+
+    // 合并只发生在排序后相邻的组之间，每个读请求的成员在排序结果中是连续的一段
+    poll_read_t *current = NULL;
+    for (int k = 0; k < n; k++) {
+        int index = order[k];
+        const poll_group_config_t *group = &config->groups[index];
+        bool mergeable = config->coalesce && (no_merge == NULL || !no_merge[index]);
+
+        plan->members[k] = index;
+        if (current && mergeable &&
+            try_merge(current, group, config->coalesce_gap)) {
+            continue;
+        }
+
+        current = &plan->reads[plan->count++];
+        start_read(current, group, &plan->members[k]);
+        // 禁止合并的组独占一个读请求，后续组不能再并入
+        if (!mergeable) {
+            current = NULL;
+        }
+    }
+
+    for (int i = 0; i < plan->count; i++) {
+        build_frame(&plan->reads[i]);
+    }
+
+    return plan->count;
+}
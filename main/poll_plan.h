@@ -0,0 +1,41 @@
+#ifndef POLL_PLAN_H
+#define POLL_PLAN_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "modbus_config.h"
+#include "agile_modbus.h"
+#include "agile_modbus_rtu.h"
+
+// 读请求RTU帧长度：从站地址 + 功能码 + 起始地址 + 数量 + CRC
+#define POLL_FRAME_LENGTH (AGILE_MODBUS_RTU_PRESET_REQ_LENGTH + AGILE_MODBUS_RTU_CHECKSUM_LENGTH)
+
+// 合并后的单次读请求，覆盖一个或多个轮询组
+typedef struct {
+    uint8_t slave_addr;
+    uint8_t function_code;
+    uint16_t start_addr;
+    uint16_t count;                     // 寄存器或位的个数
+    uint32_t period_ms;                 // 成员组共同的轮询周期
+    uint8_t priority;                   // 成员组中的最高优先级
+    uint8_t group_count;
+    const uint8_t *groups;              // 成员轮询组索引，指向 poll_plan_t.members 中的连续一段
+    uint8_t frame[POLL_FRAME_LENGTH];   // 预先生成的完整请求帧(含CRC)
+    uint8_t frame_len;                  // 请求帧长度，0表示生成失败
+    uint16_t rsp_len;                   // 预期正常响应帧长度(含CRC)
+} poll_read_t;
+
+// 单个串口的轮询计划
+typedef struct {
+    poll_read_t reads[MAX_POLL_GROUPS];
+    uint8_t members[MAX_POLL_GROUPS];   // 按读请求顺序排列的成员组索引
+    int count;
+} poll_plan_t;
+
+// 根据配置生成指定串口的轮询计划：同一从站、功能码和周期且地址相邻/重叠(间隔不超过
+// coalesce_gap)的组合并为一次读取，合并后不超过125个寄存器/2000个位。
+// no_merge 为 NULL 或对应组为 true 时该组单独读取。同时为每个读请求生成请求帧缓存，
+// 配置不变时轮询直接发送缓存帧。返回读请求个数
+int poll_plan_build(poll_plan_t *plan, const modbus_config_t *config, uint8_t uart_port, const bool *no_merge);
+
+#endif
@@ -0,0 +1,96 @@
+#include <string.h>
+#include "poll_sched.h"
+
+void poll_sched_reset(poll_sched_t *sched)
+{
+    memset(sched, 0, sizeof(*sched));
+}
+
+int poll_sched_add(poll_sched_t *sched, uint8_t item, uint32_t period_us,
+                   uint8_t priority, uint32_t cost_us, int64_t now_us)
+{
+    if (sched->count >= MAX_POLL_GROUPS || period_us == 0) {
+        return -1;
+    }
+
+    poll_sched_entry_t *entry = &sched->entries[sched->count];
+    entry->item = item;
+    entry->priority = priority;
+    entry->period_us = period_us;
+    entry->cost_us = cost_us;
+    entry->release_us = now_us;
+    entry->deadline_us = now_us + period_us;
+    entry->misses = 0;
+
+    return sched->count++;
+}
+
+int poll_sched_next(const poll_sched_t *sched, int64_t now_us, int64_t *wait_us)
+{
+    int best = -1;
+    int64_t next_release = INT64_MAX;
+
+    for (int i = 0; i < sched->count; i++) {
+        const poll_sched_entry_t *entry = &sched->entries[i];
+
+        // 尚未释放，记录最近的释放时间
+        if (entry->release_us > now_us) {
+            if (entry->release_us < next_release) {
+                next_release = entry->release_us;
+            }
+            continue;
+        }
+
+        if (best < 0 ||
+            entry->deadline_us < sched->entries[best].deadline_us ||
+            (entry->deadline_us == sched->entries[best].deadline_us &&
+             entry->priority > sched->entries[best].priority)) {
+            best = i;
+        }
+    }
+
+    if (best < 0 && wait_us) {
+        *wait_us = (next_release == INT64_MAX) ? -1 : next_release - now_us;
+    }
+    return best;
+}
+
+uint32_t poll_sched_complete(poll_sched_t *sched, int index, int64_t start_us, int64_t end_us)
+{
+    poll_sched_entry_t *entry = &sched->entries[index];
+    uint32_t missed = 0;
+
+    // 用实测事务时间平滑修正总线占用估计
+    int64_t measured = end_us - start_us;
+    if (measured > 0) {
+        entry->cost_us = (uint32_t)((entry->cost_us * 7 + measured) / 8);
+    }
+
+    if (end_us > entry->deadline_us) {
+        missed++;
+    }
+
+    // 推进到下一周期，已整体错过的周期直接跳过，避免积压后连续突发轮询
+    int64_t release = entry->release_us + entry->period_us;
+    while (release + entry->period_us <= end_us) {
+        release += entry->period_us;
+        missed++;
+    }
+
+    entry->release_us = release;
+    entry->deadline_us = release + entry->period_us;
+    entry->misses += missed;
+
+    return missed;
+}
+
+uint32_t poll_sched_utilization(const poll_sched_t *sched)
+{
+    uint64_t permille = 0;
+
+    for (int i = 0; i < sched->count; i++) {
+        permille += (uint64_t)sched->entries[i].cost_us * 1000 / sched->entries[i].period_us;
+    }
+
+    return (uint32_t)permille;
+}
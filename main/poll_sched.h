@@ -0,0 +1,40 @@
+#ifndef POLL_SCHED_H
+#define POLL_SCHED_H
+
+#include <stdint.h>
+#include "modbus_config.h"
+
+// 单个串口上的轮询调度项
+typedef struct {
+    uint8_t item;           // 对应的轮询计划读请求索引
+    uint8_t priority;       // 优先级(截止时间相同时数值大的先执行)
+    uint32_t period_us;     // 轮询周期
+    uint32_t cost_us;       // 预计单次事务占用总线时间
+    int64_t release_us;     // 本周期释放时间
+    int64_t deadline_us;    // 本周期截止时间(=下一周期释放时间)
+    uint32_t misses;        // 累计错过截止时间次数
+} poll_sched_entry_t;
+
+// 最早截止时间优先(EDF)调度器
+typedef struct {
+    poll_sched_entry_t entries[MAX_POLL_GROUPS];
+    int count;
+} poll_sched_t;
+
+// 清空调度表
+void poll_sched_reset(poll_sched_t *sched);
+
+// 添加调度项，首次释放时间为 now_us，返回调度项索引，失败返回-1
+int poll_sched_add(poll_sched_t *sched, uint8_t item, uint32_t period_us,
+                   uint8_t priority, uint32_t cost_us, int64_t now_us);
+
+// 选出已释放且截止时间最早的调度项；没有可执行项时返回-1，并通过 wait_us 给出距最近释放的时间
+int poll_sched_next(const poll_sched_t *sched, int64_t now_us, int64_t *wait_us);
+
+// 事务结束后推进调度项到下一周期，返回本次错过的截止时间个数
+uint32_t poll_sched_complete(poll_sched_t *sched, int index, int64_t start_us, int64_t end_us);
+
+// 总线利用率(千分比)，超过1000表示该串口无法满足所有组的周期
+uint32_t poll_sched_utilization(const poll_sched_t *sched);
+
+#endif
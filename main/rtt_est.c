@@ -0,0 +1,49 @@
+#include <string.h>
+#include "rtt_est.h"
+
+void rtt_est_reset(rtt_est_t *est)
+{
+    memset(est, 0, sizeof(*est));
+}
+
+void rtt_est_sample(rtt_est_t *est, uint32_t rtt_us)
+{
+    if (!est->valid) {
+        // 首个样本：偏差取样本的一半
+        est->srtt_us = rtt_us;
+        est->rttvar_us = rtt_us / 2;
+        est->valid = true;
+    } else {
+        // rttvar = 3/4 rttvar + 1/4 |srtt - rtt|，srtt = 7/8 srtt + 1/8 rtt
+        uint32_t err = (est->srtt_us > rtt_us) ? est->srtt_us - rtt_us : rtt_us - est->srtt_us;
+        est->rttvar_us = est->rttvar_us - est->rttvar_us / 4 + err / 4;
+        est->srtt_us = est->srtt_us - est->srtt_us / 8 + rtt_us / 8;
+    }
+    est->backoff = 0;
+}
+
+void rtt_est_timeout(rtt_est_t *est)
+{
+    if (est->backoff < RTT_EST_MAX_BACKOFF) {
+        est->backoff++;
+    }
+}
+
+uint32_t rtt_est_rto_us(const rtt_est_t *est, uint32_t floor_us, uint32_t initial_us, uint32_t max_us)
+{
+    uint64_t rto;
+
+    if (est->valid) {
+        rto = (uint64_t)est->srtt_us + (uint64_t)RTT_EST_K * est->rttvar_us;
+    } else {
+        rto = initial_us;
+    }
+    if (rto < floor_us) {
+        rto = floor_us;
+    }
+
+    // 超时后按退避次数翻倍，避免慢速从站在估计收敛前被反复判为超时
+    rto <<= est->backoff;
+
+    return (rto > max_us) ? max_us : (uint32_t)rto;
+}
@@ -0,0 +1,32 @@
+#ifndef RTT_EST_H
+#define RTT_EST_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// 超时 = 平滑应答时间 + RTT_EST_K * 应答时间偏差
+#define RTT_EST_K           4
+// 连续超时时超时值翻倍的最大次数
+#define RTT_EST_MAX_BACKOFF 4
+
+// 从站应答时间估计(Jacobson/Karels)，样本为扣除收发帧传输时间后的从站处理时间
+typedef struct {
+    uint32_t srtt_us;       // 平滑应答时间
+    uint32_t rttvar_us;     // 应答时间平均偏差
+    uint8_t backoff;        // 连续超时次数，得到新样本后清零
+    bool valid;             // 是否已有样本
+} rtt_est_t;
+
+// 清空估计值
+void rtt_est_reset(rtt_est_t *est);
+
+// 加入一个应答时间样本
+void rtt_est_sample(rtt_est_t *est, uint32_t rtt_us);
+
+// 记录一次超时，下次超时值翻倍直到得到新样本
+void rtt_est_timeout(rtt_est_t *est);
+
+// 计算应答超时(us)：没有样本时为 initial_us，结果不小于 floor_us、不大于 max_us
+uint32_t rtt_est_rto_us(const rtt_est_t *est, uint32_t floor_us, uint32_t initial_us, uint32_t max_us);
+
+#endif
@@ -0,0 +1,76 @@
+#ifndef RTU_PORT_H
+#define RTU_PORT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "rtu_timing.h"
+#include "agile_modbus.h"
+
+typedef struct rtu_port rtu_port_t;
+
+// 串口收发统计
+typedef struct {
+    uint32_t tx_frames;     // 发送帧数
+    uint32_t rx_frames;     // 接收到数据的帧数
+    uint32_t rx_bytes;      // 接收字节数
+    uint32_t rx_timeouts;   // 超时且未收到任何数据的次数
+    uint32_t rx_overflows;  // 接收缓冲区/FIFO溢出次数
+} rtu_port_stats_t;
+
+// 串口驱动操作表，不同的硬件或模拟后端各自实现
+typedef struct {
+    // 发送一帧，返回写入的字节数
+    int (*send)(rtu_port_t *port, const uint8_t *buf, int len);
+    // 接收一帧，timeout 单位ms，返回接收字节数。parser 不为NULL时收到的数据边收边解析，
+    // 解析出完整帧即返回，不必等待t3.5空闲；解析出错或为NULL时按帧间隔判断帧结束。
+    // 后端须在字节到达后很快交给解析器(不能攒到t3.5空闲才送出)，否则帧尾照样要等帧间隔：
+    // UART 驱动为此把硬件接收超时设为两个字符，t3.5 改由软件计时
+    int (*receive)(rtu_port_t *port, uint8_t *buf, int bufsz, int timeout, agile_modbus_parser_t *parser);
+    // 等待已发送的数据全部移出到线路上，timeout 单位ms，返回是否在超时前发送完毕
+    bool (*wait_tx_done)(rtu_port_t *port, int timeout);
+    // 帧时序参数
+    const rtu_timing_t *(*timing)(rtu_port_t *port);
+    // 最近一次请求开始发送和响应最后一个字符到达的时间戳(us)
+    void (*frame_times)(rtu_port_t *port, int64_t *tx_us, int64_t *rx_us);
+    // 读取收发统计
+    void (*stats)(rtu_port_t *port, rtu_port_stats_t *stats);
+} rtu_port_ops_t;
+
+// 串口对象，具体驱动以它作为结构体的第一个成员
+struct rtu_port {
+    const rtu_port_ops_t *ops;
+    const char *name;
+};
+
+static inline int rtu_port_send(rtu_port_t *port, const uint8_t *buf, int len)
+{
+    return port->ops->send(port, buf, len);
+}
+
+static inline int rtu_port_receive(rtu_port_t *port, uint8_t *buf, int bufsz, int timeout,
+                                   agile_modbus_parser_t *parser)
+{
+    return port->ops->receive(port, buf, bufsz, timeout, parser);
+}
+
+static inline bool rtu_port_wait_tx_done(rtu_port_t *port, int timeout)
+{
+    return port->ops->wait_tx_done(port, timeout);
+}
+
+static inline const rtu_timing_t *rtu_port_timing(rtu_port_t *port)
+{
+    return port->ops->timing(port);
+}
+
+static inline void rtu_port_frame_times(rtu_port_t *port, int64_t *tx_us, int64_t *rx_us)
+{
+    port->ops->frame_times(port, tx_us, rx_us);
+}
+
+static inline void rtu_port_stats(rtu_port_t *port, rtu_port_stats_t *stats)
+{
+    port->ops->stats(port, stats);
+}
+
+#endif
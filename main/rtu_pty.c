@@ -0,0 +1,244 @@
+// posix_openpt/grantpt/unlockpt/ptsname 需要 XSI 扩展
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/ioctl.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <unistd.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "rtu_pty.h"
+
+static const char *TAG = "rtu_pty";
+
+// 伪终端/主机串口设备的串口对象
+typedef struct {
+    rtu_port_t base;
+    int fd;                         // 网关一端(伪终端主端或串口设备)，非阻塞
+    int hold_fd;                    // 保持伪终端从端打开，否则无人打开从端时主端读返回EIO
+    char peer_name[64];             // 伪终端从端路径
+    rtu_timing_t timing;            // 帧时序参数，按8N1计算
+    int64_t tx_start_us;            // 最近一次请求开始发送的时间戳
+    int64_t rx_frame_us;            // 最近一次响应最后一个字符的时间戳
+    rtu_port_stats_t stats;
+} pty_port_drv_t;
+
+static pty_port_drv_t pty_ports[RTU_PTY_PORT_COUNT] = {
+    [0 ... RTU_PTY_PORT_COUNT - 1] = {.fd = -1, .hold_fd = -1},
+};
+
+static const char *pty_port_names[RTU_PTY_PORT_COUNT] = {"PTY0", "PTY1", "PTY2"};
+
+static int pty_port_send(rtu_port_t *port, const uint8_t *buf, int len) {
+    pty_port_drv_t *drv = (pty_port_drv_t *)port;
+    int sent = 0;
+
+    drv->tx_start_us = esp_timer_get_time();
+    drv->stats.tx_frames++;
+    while (sent < len) {
+        int rc = write(drv->fd, buf + sent, len - sent);
+        if (rc > 0) {
+            sent += rc;
+        } else if (rc < 0 && errno == EAGAIN) {
+            vTaskDelay(1);
+        } else {
+            break;
+        }
+    }
+    return sent;
+}
+
+// 接收一帧数据：解析出完整帧、空闲达到t3.5或超时后返回。
+// POSIX 模拟的 FreeRTOS 任务中不能阻塞在系统调用上，因此非阻塞读取并按tick轮询，
+// 帧结束判断的精度为一个tick
+static int pty_port_receive(rtu_port_t *port, uint8_t *buf, int bufsz, int timeout, agile_modbus_parser_t *parser) {
+    pty_port_drv_t *drv = (pty_port_drv_t *)port;
+    int len = 0;
+    int64_t start = esp_timer_get_time();
+    int64_t deadline = start + (int64_t)timeout * 1000;
+    int64_t last_byte_us = start;
+    // 没有解析器或解析出错后只能依靠帧间隔判断帧结束
+    int status = parser ? AGILE_MODBUS_PARSE_NEED_MORE : AGILE_MODBUS_PARSE_ERROR;
+
+    if (parser) {
+        agile_modbus_parser_reset(parser);
+    }
+    while (len < bufsz) {
+        int rc = read(drv->fd, buf + len, bufsz - len);
+        int64_t now = esp_timer_get_time();
+
+        if (rc > 0) {
+            if (status == AGILE_MODBUS_PARSE_NEED_MORE) {
+                status = agile_modbus_parser_feed(parser, buf + len, rc, NULL);
+            }
+            len += rc;
+            last_byte_us = now;
+            if (status == AGILE_MODBUS_PARSE_COMPLETE) {
+                break; // 已解析出完整帧，无需等待帧间隔
+            }
+            continue;
+        }
+        if (rc < 0 && errno != EAGAIN && errno != EIO) {
+            ESP_LOGE(TAG, "%s read failed: %s", drv->base.name, strerror(errno));
+            break;
+        }
+
+        if (len > 0 && rtu_timing_frame_ended(&drv->timing, now - last_byte_us)) {
+            break;
+        }
+        if (now >= deadline) {
+            break;
+        }
+        vTaskDelay(1);
+    }
+
+    if (len > 0) {
+        drv->rx_frame_us = last_byte_us;
+        drv->stats.rx_frames++;
+        drv->stats.rx_bytes += len;
+    } else {
+        drv->stats.rx_timeouts++;
+    }
+    return len;
+}
+
+// 输出队列清空即视为发送完毕；同样不能阻塞在 tcdrain 上，按tick轮询
+static bool pty_port_wait_tx_done(rtu_port_t *port, int timeout) {
+    pty_port_drv_t *drv = (pty_port_drv_t *)port;
+    int64_t deadline = esp_timer_get_time() + (int64_t)timeout * 1000;
+
+    while (1) {
+        int pending = 0;
+        if (ioctl(drv->fd, TIOCOUTQ, &pending) != 0 || pending <= 0) {
+            return true;
+        }
+        if (esp_timer_get_time() >= deadline) {
+            return false;
+        }
+        vTaskDelay(1);
+    }
+}
+
+static const rtu_timing_t *pty_port_timing(rtu_port_t *port) {
+    return &((pty_port_drv_t *)port)->timing;
+}
+
+static void pty_port_frame_times(rtu_port_t *port, int64_t *tx_us, int64_t *rx_us) {
+    pty_port_drv_t *drv = (pty_port_drv_t *)port;
+
+    if (tx_us) {
+        *tx_us = drv->tx_start_us;
+    }
+    if (rx_us) {
+        *rx_us = drv->rx_frame_us;
+    }
+}
+
+static void pty_port_stats(rtu_port_t *port, rtu_port_stats_t *stats) {
+    *stats = ((pty_port_drv_t *)port)->stats;
+}
+
+static const rtu_port_ops_t pty_port_ops = {
+    .send = pty_port_send,
+    .receive = pty_port_receive,
+    .wait_tx_done = pty_port_wait_tx_done,
+    .timing = pty_port_timing,
+    .frame_times = pty_port_frame_times,
+    .stats = pty_port_stats,
+};
+
+static speed_t baud_to_speed(uint32_t baud_rate) {
+    switch (baud_rate) {
+    case 1200: return B1200;
+    case 2400: return B2400;
+    case 4800: return B4800;
+    case 9600: return B9600;
+    case 19200: return B19200;
+    case 38400: return B38400;
+    case 57600: return B57600;
+    case 115200: return B115200;
+    case 230400: return B230400;
+    default: return B9600;
+    }
+}
+
+// 设置为原始模式(不做行编辑和字符转换)，8N1
+static int set_raw_mode(int fd, uint32_t baud_rate) {
+    struct termios tio;
+
+    if (tcgetattr(fd, &tio) != 0) {
+        return -1;
+    }
+    cfmakeraw(&tio);
+    tio.c_cflag |= CLOCAL | CREAD;
+    cfsetispeed(&tio, baud_to_speed(baud_rate));
+    cfsetospeed(&tio, baud_to_speed(baud_rate));
+    return tcsetattr(fd, TCSANOW, &tio);
+}
+
+esp_err_t rtu_pty_open(int uart_num, uint32_t baud_rate, const char *device) {
+    if (uart_num < 0 || uart_num >= RTU_PTY_PORT_COUNT || baud_rate == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    pty_port_drv_t *drv = &pty_ports[uart_num];
+    if (drv->fd >= 0) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    if (device) {
+        drv->fd = open(device, O_RDWR | O_NOCTTY | O_NONBLOCK);
+        if (drv->fd < 0) {
+            ESP_LOGE(TAG, "Failed to open %s: %s", device, strerror(errno));
+            return ESP_FAIL;
+        }
+        drv->peer_name[0] = '\0';
+    } else {
+        drv->fd = posix_openpt(O_RDWR | O_NOCTTY | O_NONBLOCK);
+        if (drv->fd < 0 || grantpt(drv->fd) != 0 || unlockpt(drv->fd) != 0 || ptsname(drv->fd) == NULL) {
+            ESP_LOGE(TAG, "Failed to create pty for UART%d: %s", uart_num, strerror(errno));
+            if (drv->fd >= 0) {
+                close(drv->fd);
+                drv->fd = -1;
+            }
+            return ESP_FAIL;
+        }
+        snprintf(drv->peer_name, sizeof(drv->peer_name), "%s", ptsname(drv->fd));
+        drv->hold_fd = open(drv->peer_name, O_RDWR | O_NOCTTY);
+        if (drv->hold_fd >= 0) {
+            set_raw_mode(drv->hold_fd, baud_rate);
+        }
+    }
+    if (set_raw_mode(drv->fd, baud_rate) != 0) {
+        ESP_LOGW(TAG, "Failed to set raw mode on UART%d: %s", uart_num, strerror(errno));
+    }
+
+    drv->base.ops = &pty_port_ops;
+    drv->base.name = pty_port_names[uart_num];
+    rtu_timing_init(&drv->timing, baud_rate, 8, false, 2);
+    ESP_LOGI(TAG, "UART%d -> %s, %" PRIu32 " baud, 字符时间 %" PRIu32 " us, t3.5 %" PRIu32 " us",
+             uart_num, device ? device : drv->peer_name, baud_rate, drv->timing.char_us, drv->timing.t35_us);
+    return ESP_OK;
+}
+
+rtu_port_t *rtu_pty_port(int uart_num) {
+    if (uart_num < 0 || uart_num >= RTU_PTY_PORT_COUNT || pty_ports[uart_num].fd < 0) {
+        return NULL;
+    }
+    return &pty_ports[uart_num].base;
+}
+
+const char *rtu_pty_peer_name(int uart_num) {
+    if (uart_num < 0 || uart_num >= RTU_PTY_PORT_COUNT || pty_ports[uart_num].peer_name[0] == '\0') {
+        return NULL;
+    }
+    return pty_ports[uart_num].peer_name;
+}
@@ -0,0 +1,29 @@
+#ifndef RTU_PTY_H
+#define RTU_PTY_H
+
+#include <stdint.h>
+#include "esp_err.h"
+#include "rtu_port.h"
+
+// 主机构建(linux target)的串口后端：用伪终端代替物理UART，
+// 另一端由模拟从站或外部从站软件打开，也可以直接打开主机上的串口设备
+
+#define RTU_PTY_PORT_COUNT 3    // 与物理UART编号一致：UART0~2
+
+// 打开串口：device 为 NULL 时新建一对伪终端，否则打开指定的串口设备。
+// baud_rate 用于计算帧时序，伪终端本身没有传输延时
+esp_err_t rtu_pty_open(int uart_num, uint32_t baud_rate, const char *device);
+
+// 获取物理UART编号对应的串口对象(rtu_pty_open后有效)，未打开时返回NULL
+rtu_port_t *rtu_pty_port(int uart_num);
+
+// 伪终端从端的设备路径，供模拟从站或外部程序打开；打开的是串口设备时返回NULL
+const char *rtu_pty_peer_name(int uart_num);
+
+// 逻辑串口号(1~3)对应的物理UART编号，与 start_modbus 一致
+static inline int rtu_pty_uart_num(int port)
+{
+    return port == 3 ? 0 : port;
+}
+
+#endif
@@ -0,0 +1,46 @@
+#include "rtu_timing.h"
+
+void rtu_timing_init(rtu_timing_t *timing, uint32_t baud_rate, uint8_t data_bits,
+                     bool parity, uint8_t stop_half_bits)
+{
+    if (baud_rate == 0) {
+        baud_rate = 9600;
+    }
+
+    // 起始位 + 数据位 + 校验位 + 停止位
+    timing->baud_rate = baud_rate;
+    timing->char_bits_x2 = 2 * (1 + data_bits + (parity ? 1 : 0)) + stop_half_bits;
+    timing->char_us = (timing->char_bits_x2 * 1000000UL + baud_rate) / (2UL * baud_rate);
+
+    // 波特率高于19200时使用协议规定的固定值，否则按字符时间计算
+    if (baud_rate > 19200) {
+        timing->t15_us = RTU_T15_FIXED_US;
+        timing->t35_us = RTU_T35_FIXED_US;
+    } else {
+        timing->t15_us = timing->char_us * 3 / 2;
+        timing->t35_us = timing->char_us * 7 / 2;
+    }
+
+    // t3.5折合为字符时间，向上取整保证不短于t3.5
+    uint32_t symbols = (timing->t35_us + timing->char_us - 1) / timing->char_us;
+    if (symbols < 1) {
+        symbols = 1;
+    } else if (symbols > RTU_RX_TIMEOUT_MAX) {
+        symbols = RTU_RX_TIMEOUT_MAX;
+    }
+    timing->rx_timeout_symbols = symbols;
+}
+
+uint32_t rtu_timing_bytes_us(const rtu_timing_t *timing, int bytes)
+{
+    if (bytes <= 0) {
+        return 0;
+    }
+    return (uint32_t)(((uint64_t)bytes * timing->char_bits_x2 * 1000000UL + timing->baud_rate) /
+                      (2UL * timing->baud_rate));
+}
+
+bool rtu_timing_frame_ended(const rtu_timing_t *timing, int64_t idle_us)
+{
+    return idle_us >= (int64_t)timing->t35_us;
+}
@@ -0,0 +1,33 @@
+#ifndef RTU_TIMING_H
+#define RTU_TIMING_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// 波特率高于19200时协议规定的固定帧间隔(us)
+#define RTU_T15_FIXED_US    750
+#define RTU_T35_FIXED_US    1750
+// rx_timeout_symbols 上限(UART硬件接收超时阈值的上限，字符时间)
+#define RTU_RX_TIMEOUT_MAX  126
+
+// 单个串口的RTU帧时序参数，只依赖串口参数，不依赖硬件，可在主机上验证
+typedef struct {
+    uint32_t baud_rate;
+    uint32_t char_bits_x2;      // 每字符位数(以半位计，兼容1.5停止位)
+    uint32_t char_us;           // 单字符传输时间
+    uint32_t t15_us;            // 字符间最大间隔
+    uint32_t t35_us;            // 帧间最小间隔
+    uint8_t rx_timeout_symbols; // 不短于t3.5的空闲字符数；UART驱动的硬件超时取更短的值，只用于日志
+} rtu_timing_t;
+
+// 根据串口参数计算帧时序：data_bits 为 5~8，stop_half_bits 为停止位个数x2(2/3/4)
+void rtu_timing_init(rtu_timing_t *timing, uint32_t baud_rate, uint8_t data_bits,
+                     bool parity, uint8_t stop_half_bits);
+
+// 传输 bytes 个字符所需时间(us)
+uint32_t rtu_timing_bytes_us(const rtu_timing_t *timing, int bytes);
+
+// 距最后一个字符 idle_us 后帧是否已结束(空闲达到t3.5)
+bool rtu_timing_frame_ended(const rtu_timing_t *timing, int64_t idle_us);
+
+#endif
@@ -0,0 +1,100 @@
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_log.h"
+#include "rtu_timing.h"
+#include "rtu_timing_test.h"
+
+static const char *TAG = "rtu_timing_test";
+
+// 一组串口参数及期望的时序，期望值按协议手工算出，不复用被测公式
+typedef struct {
+    const char *name;
+    uint32_t baud_rate;
+    uint8_t data_bits;
+    bool parity;
+    uint8_t stop_half_bits;
+    uint32_t char_us;
+    uint32_t t15_us;
+    uint32_t t35_us;
+    uint8_t rx_timeout_symbols;
+} timing_case_t;
+
+static const timing_case_t timing_cases[] = {
+    // 19200及以下按字符时间计算：8N1 为10位，8E1/8N2 为11位
+    {"9600 8N1", 9600, 8, false, 2, 1042, 1563, 3647, 4},
+    {"9600 8E1", 9600, 8, true, 2, 1146, 1719, 4011, 4},
+    {"9600 8N2", 9600, 8, false, 4, 1146, 1719, 4011, 4},
+    {"9600 8N1.5", 9600, 8, false, 3, 1094, 1641, 3829, 4},
+    {"19200 8N1", 19200, 8, false, 2, 521, 781, 1823, 4},
+    {"19200 8E1", 19200, 8, true, 2, 573, 859, 2005, 4},
+    // 高于19200时t1.5/t3.5固定为750/1750us，硬件超时仍按字符时间向上取整
+    {"38400 8N1", 38400, 8, false, 2, 260, 750, 1750, 7},
+    {"38400 8E1", 38400, 8, true, 2, 286, 750, 1750, 7},
+    {"115200 8N1", 115200, 8, false, 2, 87, 750, 1750, 21},
+    {"115200 8E1", 115200, 8, true, 2, 95, 750, 1750, 19},
+    // 波特率为0时按9600处理
+    {"0 8N1", 0, 8, false, 2, 1042, 1563, 3647, 4},
+};
+
+// 多字符传输时间：整帧一起取整，不是逐字符累加
+typedef struct {
+    const char *name;
+    uint32_t baud_rate;
+    bool parity;
+    int bytes;
+    uint32_t bytes_us;
+} bytes_case_t;
+
+static const bytes_case_t bytes_cases[] = {
+    {"9600 8N1 x0", 9600, false, 0, 0},
+    {"9600 8N1 x-1", 9600, false, -1, 0},
+    {"9600 8N1 x1", 9600, false, 1, 1042},
+    {"9600 8N1 x8", 9600, false, 8, 8333},
+    {"9600 8E1 x256", 9600, true, 256, 293333},
+    {"19200 8N1 x8", 19200, false, 8, 4167},
+    {"19200 8E1 x256", 19200, true, 256, 146667},
+    {"115200 8N1 x256", 115200, false, 256, 22222},
+};
+
+static int check_u32(const char *name, const char *field, uint32_t got, uint32_t expected)
+{
+    if (got == expected) {
+        return 0;
+    }
+    ESP_LOGE(TAG, "%s: %s = %" PRIu32 ", expected %" PRIu32, name, field, got, expected);
+    return 1;
+}
+
+bool rtu_timing_test_run(void)
+{
+    int failures = 0;
+    int checks = 0;
+    rtu_timing_t timing;
+
+    for (size_t i = 0; i < sizeof(timing_cases) / sizeof(timing_cases[0]); i++) {
+        const timing_case_t *c = &timing_cases[i];
+        rtu_timing_init(&timing, c->baud_rate, c->data_bits, c->parity, c->stop_half_bits);
+        failures += check_u32(c->name, "char_us", timing.char_us, c->char_us);
+        failures += check_u32(c->name, "t15_us", timing.t15_us, c->t15_us);
+        failures += check_u32(c->name, "t35_us", timing.t35_us, c->t35_us);
+        failures += check_u32(c->name, "rx_timeout_symbols", timing.rx_timeout_symbols, c->rx_timeout_symbols);
+        // 单个字符的传输时间与 char_us 一致
+        failures += check_u32(c->name, "bytes_us(1)", rtu_timing_bytes_us(&timing, 1), c->char_us);
+        // 空闲恰好达到t3.5时帧结束，差1us时未结束
+        failures += check_u32(c->name, "frame_ended(t35 - 1)",
+                              rtu_timing_frame_ended(&timing, c->t35_us - 1), false);
+        failures += check_u32(c->name, "frame_ended(t35)", rtu_timing_frame_ended(&timing, c->t35_us), true);
+        checks += 7;
+    }
+
+    for (size_t i = 0; i < sizeof(bytes_cases) / sizeof(bytes_cases[0]); i++) {
+        const bytes_case_t *c = &bytes_cases[i];
+        rtu_timing_init(&timing, c->baud_rate, 8, c->parity, 2);
+        failures += check_u32(c->name, "bytes_us", rtu_timing_bytes_us(&timing, c->bytes), c->bytes_us);
+        checks++;
+    }
+
+    ESP_LOGI(TAG, "%d checks, %d failures", checks, failures);
+    return failures == 0;
+}
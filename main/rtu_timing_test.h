@@ -0,0 +1,12 @@
+#ifndef RTU_TIMING_TEST_H
+#define RTU_TIMING_TEST_H
+
+#include <stdbool.h>
+
+// rtu_timing 的主机测试：按已知串口参数核对字符时间、t1.5/t3.5、硬件接收超时、
+// 多字符传输时间和帧结束判断。只在主机构建中使用，配置 {"rtu_timing_test":{}} 时运行
+
+// 运行所有用例，逐项打印失败的字段，返回是否全部通过
+bool rtu_timing_test_run(void);
+
+#endif
@@ -0,0 +1,93 @@
+#include <string.h>
+#include "slave_health.h"
+
+void slave_health_reset(slave_health_t *health)
+{
+    memset(health, 0, sizeof(*health));
+}
+
+static slave_health_entry_t *find_entry(const slave_health_t *health, uint8_t slave_addr)
+{
+    for (int i = 0; i < health->count; i++) {
+        if (health->entries[i].slave_addr == slave_addr) {
+            return (slave_health_entry_t *)&health->entries[i];
+        }
+    }
+    return NULL;
+}
+
+// 查找从站状态，不存在时新建；表满时返回 NULL(该从站不做离线判断)
+static slave_health_entry_t *get_entry(slave_health_t *health, uint8_t slave_addr)
+{
+    slave_health_entry_t *entry = find_entry(health, slave_addr);
+    if (entry || health->count >= MAX_POLL_GROUPS) {
+        return entry;
+    }
+
+    entry = &health->entries[health->count++];
+    memset(entry, 0, sizeof(*entry));
+    entry->slave_addr = slave_addr;
+    return entry;
+}
+
+bool slave_health_should_poll(slave_health_t *health, uint8_t slave_addr, int64_t now_us)
+{
+    slave_health_entry_t *entry = find_entry(health, slave_addr);
+    if (entry == NULL || !entry->down) {
+        return true;
+    }
+    return now_us >= entry->next_probe_us;
+}
+
+bool slave_health_report(slave_health_t *health, uint8_t slave_addr, bool responded, int64_t now_us)
+{
+    slave_health_entry_t *entry = get_entry(health, slave_addr);
+    if (entry == NULL) {
+        return false;
+    }
+
+    // 有应答即恢复正常调度
+    if (responded) {
+        bool changed = entry->down;
+        entry->down = false;
+        entry->failures = 0;
+        entry->backoff_ms = 0;
+        return changed;
+    }
+
+    if (entry->failures < UINT8_MAX) {
+        entry->failures++;
+    }
+
+    if (entry->down) {
+        // 探测失败，间隔翻倍
+        entry->backoff_ms *= 2;
+        if (entry->backoff_ms > SLAVE_PROBE_MAX_MS) {
+            entry->backoff_ms = SLAVE_PROBE_MAX_MS;
+        }
+        entry->next_probe_us = now_us + (int64_t)entry->backoff_ms * 1000;
+        return false;
+    }
+
+    if (entry->failures >= SLAVE_DOWN_THRESHOLD) {
+        entry->down = true;
+        entry->down_count++;
+        entry->backoff_ms = SLAVE_PROBE_INITIAL_MS;
+        entry->next_probe_us = now_us + (int64_t)entry->backoff_ms * 1000;
+        return true;
+    }
+
+    return false;
+}
+
+rtt_est_t *slave_health_rtt(slave_health_t *health, uint8_t slave_addr)
+{
+    slave_health_entry_t *entry = get_entry(health, slave_addr);
+    return entry ? &entry->rtt : NULL;
+}
+
+bool slave_health_is_down(const slave_health_t *health, uint8_t slave_addr)
+{
+    const slave_health_entry_t *entry = find_entry(health, slave_addr);
+    return entry != NULL && entry->down;
+}
@@ -0,0 +1,47 @@
+#ifndef SLAVE_HEALTH_H
+#define SLAVE_HEALTH_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "modbus_config.h"
+#include "rtt_est.h"
+
+// 连续无应答多少次后判定从站离线
+#define SLAVE_DOWN_THRESHOLD    3
+// 离线后探测间隔：从初始值开始每次失败翻倍，直到上限 (ms)
+#define SLAVE_PROBE_INITIAL_MS  1000
+#define SLAVE_PROBE_MAX_MS      60000
+
+// 单个从站的健康状态
+typedef struct {
+    uint8_t slave_addr;
+    bool down;                  // 是否已判定离线
+    uint8_t failures;           // 连续无应答次数
+    uint32_t backoff_ms;        // 当前探测间隔
+    int64_t next_probe_us;      // 离线时下一次允许探测的时间
+    uint32_t down_count;        // 累计离线次数
+    rtt_est_t rtt;              // 应答时间估计
+} slave_health_entry_t;
+
+// 单个串口上所有从站的健康表
+typedef struct {
+    slave_health_entry_t entries[MAX_POLL_GROUPS];
+    int count;
+} slave_health_t;
+
+// 清空健康表
+void slave_health_reset(slave_health_t *health);
+
+// 从站当前是否允许轮询：在线时总是允许，离线时只在探测时间到达后允许一次
+bool slave_health_should_poll(slave_health_t *health, uint8_t slave_addr, int64_t now_us);
+
+// 记录一次事务结果(从站是否有应答)，状态在在线/离线之间切换时返回 true
+bool slave_health_report(slave_health_t *health, uint8_t slave_addr, bool responded, int64_t now_us);
+
+// 获取从站的应答时间估计，表满时返回 NULL
+rtt_est_t *slave_health_rtt(slave_health_t *health, uint8_t slave_addr);
+
+// 从站是否处于离线状态
+bool slave_health_is_down(const slave_health_t *health, uint8_t slave_addr);
+
+#endif
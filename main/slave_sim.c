@@ -0,0 +1,432 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <unistd.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "agile_modbus.h"
+#include "agile_modbus_rtu.h"
+#include "rtu_timing.h"
+#include "slave_sim.h"
+
+static const char *TAG = "slave_sim";
+
+#define SLAVE_SIM_PORTS 3
+#define SLAVE_SIM_TASK_STACK_SIZE 4096
+
+// 一个串口上的模拟从站总线
+typedef struct {
+    uint8_t port;
+    int fd;
+    rtu_timing_t timing;
+    agile_modbus_rtu_t ctx_rtu;
+    agile_modbus_parser_t parser;   // 请求帧流式解析器
+    uint8_t send_buf[AGILE_MODBUS_MAX_ADU_LENGTH];
+    uint8_t recv_buf[AGILE_MODBUS_MAX_ADU_LENGTH];
+} sim_bus_t;
+
+static slave_sim_t sim_slaves[SLAVE_SIM_MAX_SLAVES];
+static int sim_slave_count = 0;
+static sim_bus_t sim_buses[SLAVE_SIM_PORTS];
+static uint32_t sim_rand_state = 1;
+
+// xorshift32，错误注入只需要可复现，不需要高质量随机数
+static uint32_t sim_rand(void)
+{
+    uint32_t x = sim_rand_state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    sim_rand_state = x;
+    return x;
+}
+
+// 以概率 rate 返回 true
+static bool sim_chance(float rate)
+{
+    return rate > 0 && (sim_rand() >> 8) < (uint32_t)(rate * (float)(1 << 24));
+}
+
+static void load_u16_array(uint16_t *dest, uint32_t size, const cJSON *array)
+{
+    int n = cJSON_IsArray(array) ? cJSON_GetArraySize(array) : 0;
+    for (int i = 0; i < n && i < (int)size; i++) {
+        cJSON *item = cJSON_GetArrayItem(array, i);
+        if (cJSON_IsNumber(item)) {
+            dest[i] = (uint16_t)item->valueint;
+        }
+    }
+}
+
+static void load_bit_array(uint8_t *dest, uint32_t size, const cJSON *array)
+{
+    int n = cJSON_IsArray(array) ? cJSON_GetArraySize(array) : 0;
+    for (int i = 0; i < n && i < (int)size; i++) {
+        cJSON *item = cJSON_GetArrayItem(array, i);
+        dest[i] = cJSON_IsNumber(item) ? (item->valueint != 0) : cJSON_IsTrue(item);
+    }
+}
+
+static int json_int(const cJSON *obj, const char *key, int def)
+{
+    cJSON *item = cJSON_GetObjectItem(obj, key);
+    return cJSON_IsNumber(item) ? item->valueint : def;
+}
+
+static float json_rate(const cJSON *obj, const char *key)
+{
+    cJSON *item = cJSON_GetObjectItem(obj, key);
+    if (!cJSON_IsNumber(item) || item->valuedouble < 0) {
+        return 0;
+    }
+    return item->valuedouble > 1 ? 1 : (float)item->valuedouble;
+}
+
+esp_err_t slave_sim_from_json(const cJSON *slaves, uint32_t seed)
+{
+    if (!cJSON_IsArray(slaves)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    sim_rand_state = seed ? seed : 1;
+
+    const cJSON *item;
+    cJSON_ArrayForEach(item, slaves) {
+        int port = json_int(item, "port", 1);
+        int addr = json_int(item, "addr", 1);
+        int size = json_int(item, "size", SLAVE_SIM_DEFAULT_SIZE);
+
+        if (port < 1 || port > SLAVE_SIM_PORTS || addr < 1 || addr > 247 || size < 1 || size > 0x10000) {
+            ESP_LOGE(TAG, "Invalid simulated slave: port %d addr %d size %d", port, addr, size);
+            return ESP_ERR_INVALID_ARG;
+        }
+        if (slave_sim_find(port, addr) != NULL || sim_slave_count >= SLAVE_SIM_MAX_SLAVES) {
+            ESP_LOGE(TAG, "Duplicate or too many simulated slaves (port %d addr %d)", port, addr);
+            return ESP_ERR_INVALID_ARG;
+        }
+
+        slave_sim_t *slave = &sim_slaves[sim_slave_count];
+        memset(slave, 0, sizeof(*slave));
+        slave->port = port;
+        slave->addr = addr;
+        slave->size = size;
+        slave->delay_us = json_int(item, "delay_ms", 0) * 1000;
+        slave->jitter_us = json_int(item, "jitter_ms", 0) * 1000;
+        slave->timeout_rate = json_rate(item, "timeout_rate");
+        slave->crc_error_rate = json_rate(item, "crc_error_rate");
+        slave->exception_rate = json_rate(item, "exception_rate");
+        slave->ramp_ms = json_int(item, "ramp_ms", 0);
+
+        slave->bits = calloc(size, 1);
+        slave->input_bits = calloc(size, 1);
+        slave->registers = calloc(size, sizeof(uint16_t));
+        slave->input_registers = calloc(size, sizeof(uint16_t));
+        if (!slave->bits || !slave->input_bits || !slave->registers || !slave->input_registers) {
+            return ESP_ERR_NO_MEM;
+        }
+
+        // 默认寄存器值等于地址，便于核对映射和合并读取的结果
+        for (int i = 0; i < size; i++) {
+            slave->registers[i] = i;
+            slave->input_registers[i] = i;
+        }
+        load_u16_array(slave->registers, size, cJSON_GetObjectItem(item, "holding"));
+        load_u16_array(slave->input_registers, size, cJSON_GetObjectItem(item, "input"));
+        load_bit_array(slave->bits, size, cJSON_GetObjectItem(item, "coils"));
+        load_bit_array(slave->input_bits, size, cJSON_GetObjectItem(item, "discrete"));
+
+        sim_slave_count++;
+        ESP_LOGI(TAG, "Port %d slave %d: %d regs, delay %" PRIu32 " us, timeout %.3f, crc %.3f, exception %.3f",
+                 port, addr, size, slave->delay_us, slave->timeout_rate, slave->crc_error_rate,
+                 slave->exception_rate);
+    }
+    return ESP_OK;
+}
+
+int slave_sim_count(uint8_t port)
+{
+    int count = 0;
+    for (int i = 0; i < sim_slave_count; i++) {
+        if (sim_slaves[i].port == port) {
+            count++;
+        }
+    }
+    return count;
+}
+
+slave_sim_t *slave_sim_find(uint8_t port, uint8_t addr)
+{
+    for (int i = 0; i < sim_slave_count; i++) {
+        if (sim_slaves[i].port == port && sim_slaves[i].addr == addr) {
+            return &sim_slaves[i];
+        }
+    }
+    return NULL;
+}
+
+// 按经过的周期数递增保持/输入寄存器，模拟现场数据变化
+static void sim_ramp(slave_sim_t *slave, int64_t now_us)
+{
+    if (slave->ramp_ms == 0) {
+        return;
+    }
+    if (slave->ramp_us == 0) {
+        slave->ramp_us = now_us;
+        return;
+    }
+
+    int64_t period_us = (int64_t)slave->ramp_ms * 1000;
+    uint16_t steps = (uint16_t)((now_us - slave->ramp_us) / period_us);
+    if (steps == 0) {
+        return;
+    }
+    slave->ramp_us += steps * period_us;
+    for (uint32_t i = 0; i < slave->size; i++) {
+        slave->registers[i] += steps;
+        slave->input_registers[i] += steps;
+    }
+}
+
+// agile_modbus 从机回调：读写模拟从站的寄存器表
+static int sim_slave_callback(agile_modbus_t *ctx, struct agile_modbus_slave_info *slave_info, const void *data)
+{
+    slave_sim_t *slave = (slave_sim_t *)data;
+    int function = slave_info->sft->function;
+    int address = slave_info->address;
+    int nb = slave_info->nb;
+    uint8_t *rsp = ctx->send_buf + slave_info->send_index;
+
+    switch (function) {
+    case AGILE_MODBUS_FC_WRITE_SINGLE_COIL:
+    case AGILE_MODBUS_FC_WRITE_SINGLE_REGISTER:
+        nb = 1;
+        break;
+    case AGILE_MODBUS_FC_READ_COILS:
+    case AGILE_MODBUS_FC_READ_DISCRETE_INPUTS:
+    case AGILE_MODBUS_FC_READ_HOLDING_REGISTERS:
+    case AGILE_MODBUS_FC_READ_INPUT_REGISTERS:
+    case AGILE_MODBUS_FC_WRITE_MULTIPLE_COILS:
+    case AGILE_MODBUS_FC_WRITE_MULTIPLE_REGISTERS:
+        break;
+    default:
+        return -AGILE_MODBUS_EXCEPTION_ILLEGAL_FUNCTION;
+    }
+    if (address + nb > (int)slave->size) {
+        return -AGILE_MODBUS_EXCEPTION_ILLEGAL_DATA_ADDRESS;
+    }
+
+    switch (function) {
+    case AGILE_MODBUS_FC_READ_COILS:
+    case AGILE_MODBUS_FC_READ_DISCRETE_INPUTS: {
+        const uint8_t *table = (function == AGILE_MODBUS_FC_READ_COILS) ? slave->bits : slave->input_bits;
+        for (int i = 0; i < nb; i++) {
+            agile_modbus_slave_io_set(rsp, i, table[address + i]);
+        }
+        break;
+    }
+    case AGILE_MODBUS_FC_READ_HOLDING_REGISTERS:
+    case AGILE_MODBUS_FC_READ_INPUT_REGISTERS: {
+        const uint16_t *table = (function == AGILE_MODBUS_FC_READ_HOLDING_REGISTERS) ?
+                                slave->registers : slave->input_registers;
+        for (int i = 0; i < nb; i++) {
+            agile_modbus_slave_register_set(rsp, i, table[address + i]);
+        }
+        break;
+    }
+    case AGILE_MODBUS_FC_WRITE_SINGLE_COIL:
+        slave->bits[address] = (*((int *)slave_info->buf) != 0);
+        break;
+    case AGILE_MODBUS_FC_WRITE_SINGLE_REGISTER:
+        slave->registers[address] = (uint16_t)*((int *)slave_info->buf);
+        break;
+    case AGILE_MODBUS_FC_WRITE_MULTIPLE_COILS:
+        for (int i = 0; i < nb; i++) {
+            slave->bits[address + i] = agile_modbus_slave_io_get(slave_info->buf, i);
+        }
+        break;
+    case AGILE_MODBUS_FC_WRITE_MULTIPLE_REGISTERS:
+        for (int i = 0; i < nb; i++) {
+            slave->registers[address + i] = agile_modbus_slave_register_get(slave_info->buf, i);
+        }
+        break;
+    }
+    return 0;
+}
+
+// 故意返回从站设备故障，模拟现场设备偶发的异常应答
+static int sim_fault_callback(agile_modbus_t *ctx, struct agile_modbus_slave_info *slave_info, const void *data)
+{
+    return -AGILE_MODBUS_EXCEPTION_SLAVE_OR_SERVER_FAILURE;
+}
+
+// 接收一个请求帧：解析出完整帧即结束，解析出错时等到空闲达到t3.5
+static int sim_receive(sim_bus_t *bus, int64_t *first_byte_us)
+{
+    uint8_t *buf = bus->ctx_rtu._ctx.read_buf;
+    int bufsz = bus->ctx_rtu._ctx.read_bufsz;
+    int len = 0;
+    int64_t last_byte_us = 0;
+    int status = AGILE_MODBUS_PARSE_NEED_MORE;
+
+    agile_modbus_parser_reset(&bus->parser);
+    while (len < bufsz) {
+        int rc = read(bus->fd, buf + len, bufsz - len);
+        int64_t now = esp_timer_get_time();
+        if (rc > 0) {
+            if (len == 0) {
+                *first_byte_us = now;
+            }
+            if (status == AGILE_MODBUS_PARSE_NEED_MORE) {
+                status = agile_modbus_parser_feed(&bus->parser, buf + len, rc, NULL);
+            }
+            len += rc;
+            last_byte_us = now;
+            if (status == AGILE_MODBUS_PARSE_COMPLETE) {
+                break;
+            }
+            continue;
+        }
+        if (len > 0 && rtu_timing_frame_ended(&bus->timing, now - last_byte_us)) {
+            break;
+        }
+        vTaskDelay(1);
+    }
+    return len;
+}
+
+// 等到 target_us 时刻，精度为一个tick
+static void sim_wait_until(int64_t target_us)
+{
+    int64_t now = esp_timer_get_time();
+    if (target_us > now) {
+        TickType_t ticks = (TickType_t)((target_us - now) / (portTICK_PERIOD_MS * 1000));
+        vTaskDelay(ticks > 0 ? ticks : 1);
+    }
+}
+
+static void slave_sim_task(void *pvParameters)
+{
+    sim_bus_t *bus = (sim_bus_t *)pvParameters;
+    agile_modbus_t *ctx = &bus->ctx_rtu._ctx;
+
+    while (1) {
+        int64_t first_byte_us = 0;
+        int len = sim_receive(bus, &first_byte_us);
+        if (len <= 0) {
+            continue;
+        }
+
+        uint8_t addr = ctx->read_buf[0];
+        int rsp_len = 0;
+        slave_sim_t *responder = NULL;
+
+        for (int i = 0; i < sim_slave_count; i++) {
+            slave_sim_t *slave = &sim_slaves[i];
+            if (slave->port != bus->port || (addr != 0 && slave->addr != addr)) {
+                continue;
+            }
+
+            slave->stats.requests++;
+            sim_ramp(slave, first_byte_us);
+            if (addr != 0 && sim_chance(slave->timeout_rate)) {
+                slave->stats.timeouts++;
+                break;
+            }
+
+            // 广播请求每个从站都执行，但不应答
+            bool fault = addr != 0 && sim_chance(slave->exception_rate);
+            agile_modbus_set_slave(ctx, slave->addr);
+            rsp_len = agile_modbus_slave_handle(ctx, len, 1, fault ? sim_fault_callback : sim_slave_callback,
+                                                slave, NULL);
+            if (addr != 0) {
+                responder = slave;
+                break;
+            }
+        }
+
+        // 请求CRC错误或地址不存在时从站不应答
+        if (responder == NULL || rsp_len <= 0) {
+            continue;
+        }
+
+        if (ctx->send_buf[1] & 0x80) {
+            responder->stats.exceptions++;
+        } else {
+            responder->stats.responses++;
+        }
+        if (sim_chance(responder->crc_error_rate)) {
+            ctx->send_buf[rsp_len - 1] ^= 0xFF;
+            responder->stats.crc_errors++;
+        }
+
+        // 伪终端没有传输延时，按波特率补上请求和应答在线路上的时间，再加上从站处理时间
+        uint32_t jitter = responder->jitter_us ? sim_rand() % (responder->jitter_us + 1) : 0;
+        int64_t ready_us = first_byte_us + rtu_timing_bytes_us(&bus->timing, len) + bus->timing.t35_us +
+                           responder->delay_us + jitter + rtu_timing_bytes_us(&bus->timing, rsp_len);
+        sim_wait_until(ready_us);
+
+        int sent = 0;
+        while (sent < rsp_len) {
+            int rc = write(bus->fd, ctx->send_buf + sent, rsp_len - sent);
+            if (rc > 0) {
+                sent += rc;
+            } else if (rc < 0 && errno == EAGAIN) {
+                vTaskDelay(1);
+            } else {
+                break;
+            }
+        }
+    }
+}
+
+esp_err_t slave_sim_start(uint8_t port, const char *device, uint32_t baud_rate)
+{
+    if (port < 1 || port > SLAVE_SIM_PORTS || device == NULL || baud_rate == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    sim_bus_t *bus = &sim_buses[port - 1];
+    bus->port = port;
+    bus->fd = open(device, O_RDWR | O_NOCTTY | O_NONBLOCK);
+    if (bus->fd < 0) {
+        ESP_LOGE(TAG, "Failed to open %s: %s", device, strerror(errno));
+        return ESP_FAIL;
+    }
+
+    struct termios tio;
+    if (tcgetattr(bus->fd, &tio) == 0) {
+        cfmakeraw(&tio);
+        tcsetattr(bus->fd, TCSANOW, &tio);
+    }
+
+    rtu_timing_init(&bus->timing, baud_rate, 8, false, 2);
+    agile_modbus_rtu_init(&bus->ctx_rtu, bus->send_buf, sizeof(bus->send_buf),
+                          bus->recv_buf, sizeof(bus->recv_buf));
+    agile_modbus_parser_init(&bus->parser, &bus->ctx_rtu._ctx, AGILE_MODBUS_MSG_INDICATION);
+
+    char task_name[20];
+    snprintf(task_name, sizeof(task_name), "slave_sim%d", port);
+    if (xTaskCreate(slave_sim_task, task_name, SLAVE_SIM_TASK_STACK_SIZE, bus, 12, NULL) != pdPASS) {
+        close(bus->fd);
+        bus->fd = -1;
+        return ESP_ERR_NO_MEM;
+    }
+    ESP_LOGI(TAG, "Port %d: %d simulated slaves on %s", port, slave_sim_count(port), device);
+    return ESP_OK;
+}
+
+void slave_sim_log_stats(void)
+{
+    for (int i = 0; i < sim_slave_count; i++) {
+        const slave_sim_t *slave = &sim_slaves[i];
+        ESP_LOGI(TAG, "Port %d slave %d: requests %" PRIu32 ", responses %" PRIu32 ", timeouts %" PRIu32
+                 ", crc errors %" PRIu32 ", exceptions %" PRIu32,
+                 slave->port, slave->addr, slave->stats.requests, slave->stats.responses,
+                 slave->stats.timeouts, slave->stats.crc_errors, slave->stats.exceptions);
+    }
+}
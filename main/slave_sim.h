@@ -0,0 +1,61 @@
+#ifndef SLAVE_SIM_H
+#define SLAVE_SIM_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "cJSON.h"
+
+// 模拟从站：在伪终端另一端按配置应答网关的请求，用于主机构建的测试和性能评估
+
+#define SLAVE_SIM_MAX_SLAVES 32
+#define SLAVE_SIM_DEFAULT_SIZE 256  // 各寄存器表默认大小(从地址0开始)
+
+// 单个模拟从站的统计
+typedef struct {
+    uint32_t requests;      // 收到的发给本从站的请求(含广播)
+    uint32_t responses;     // 发出的正常应答
+    uint32_t timeouts;      // 按 timeout_rate 故意不应答
+    uint32_t crc_errors;    // 按 crc_error_rate 发出CRC错误的应答
+    uint32_t exceptions;    // 按 exception_rate 或地址越界发出异常应答
+} slave_sim_stats_t;
+
+// 模拟从站配置和寄存器内容
+typedef struct {
+    uint8_t port;               // 逻辑串口 1~3
+    uint8_t addr;               // 从站地址 1~247
+    uint32_t delay_us;          // 收到完整请求后到开始应答的处理时间
+    uint32_t jitter_us;         // 处理时间的随机抖动上限
+    float timeout_rate;         // 不应答的概率 0~1
+    float crc_error_rate;       // 应答CRC错误的概率 0~1
+    float exception_rate;       // 应答异常码04(从站设备故障)的概率 0~1
+    uint32_t ramp_ms;           // 每隔 ramp_ms 保持/输入寄存器全部加1，0 表示内容不变
+    uint32_t size;              // 各寄存器表大小，访问越界时应答异常码02
+    uint8_t *bits;              // 线圈，每个元素一个位
+    uint8_t *input_bits;        // 离散输入
+    uint16_t *registers;        // 保持寄存器
+    uint16_t *input_registers;  // 输入寄存器
+    int64_t ramp_us;            // 最近一次寄存器递增的时间
+    slave_sim_stats_t stats;
+} slave_sim_t;
+
+// 按JSON数组添加模拟从站：
+// [{"port":1,"addr":1,"size":256,"delay_ms":5,"jitter_ms":1,"timeout_rate":0.01,
+//   "crc_error_rate":0,"exception_rate":0,"ramp_ms":1000,
+//   "holding":[...],"input":[...],"coils":[...],"discrete":[...]}]
+// 未给出的寄存器初值为其地址，线圈/离散输入初值为0。seed 为随机数种子，相同种子的错误注入序列相同
+esp_err_t slave_sim_from_json(const cJSON *slaves, uint32_t seed);
+
+// 逻辑串口上配置的模拟从站个数
+int slave_sim_count(uint8_t port);
+
+// 打开 device(伪终端从端)并为逻辑串口上的模拟从站启动应答任务，baud_rate 用于模拟线路传输时间
+esp_err_t slave_sim_start(uint8_t port, const char *device, uint32_t baud_rate);
+
+// 查找模拟从站，不存在时返回NULL
+slave_sim_t *slave_sim_find(uint8_t port, uint8_t addr);
+
+// 打印所有模拟从站的统计
+void slave_sim_log_stats(void);
+
+#endif
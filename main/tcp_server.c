@@ -1,13 +1,17 @@
 #include <string.h>
+#include <stdlib.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "esp_log.h"
+#include "esp_timer.h"
 #include "lwip/err.h"
 #include "lwip/sockets.h"
 #include "tcp_server.h"
 #include "agile_modbus.h"
 #include "agile_modbus_slave_util.h"
 #include "tcp_slave_regs.h"
+#include "tcp_unit.h"
+#include "perf_stage.h"
 
 static const char *TAG = "modbus_tcp_slave";
 
@@ -102,113 +106,429 @@ const agile_modbus_slave_util_t slave_util = {
     NULL                        // 不需要后处理
 };
 
+// 一个客户端连接的状态
 typedef struct {
-    int socket;
-    TaskHandle_t task;
-} client_info_t;
+    int sock;                       // 套接字，<0 表示连接已关闭
+    char addr[16];                  // 客户端IP地址，用于日志
+    agile_modbus_parser_t parser;   // 按MBAP长度字段从字节流中切分请求帧
+    uint8_t *rx;                    // 接收缓冲区(SERVER_RX_BUF_SIZE)，连接建立时分配
+    int rx_len;                     // 缓冲区中的字节数
+    int rx_fed;                     // 其中已交给解析器的字节数
+    uint8_t *tx;                    // 发送积压缓冲区(SERVER_TX_BUF_SIZE)，连接建立时分配
+    int tx_len;                     // 尚未发出的响应字节数
+    int64_t tx_progress_us;         // 积压的响应最近一次有进展(产生或发出)的时间
+    // 转发写命令的请求：帧留在接收缓冲区开头，写命令全部完成后才生成响应，期间不处理该连接的后续请求。
+    // 连接关闭后仍要等写命令回调，之后才释放缓冲区和连接槽
+    int write_frame_len;            // 等待写命令结果的请求帧长度，0 表示没有
+    int writes_left;                // 尚未完成的写命令数，轮询任务回调中原子递减
+    int write_result;               // 第一个失败的写命令结果
+    int64_t write_deadline_us;      // 超过该时间仍在排队的写命令被撤回
+} tcp_conn_t;
 
-// 全局变量声明
-static client_info_t clients[MAX_CLIENTS] = {0};
-static SemaphoreHandle_t clients_mutex = NULL;
+static tcp_conn_t conns[TCP_SERVER_MAX_CLIENTS];
 
-static void handle_client(void *pvParameters)
+// 所有连接在服务器任务中依次处理，共用一个 Modbus TCP 上下文。
+// 请求帧直接在连接的接收缓冲区中处理，响应写入连接的发送积压缓冲区
+static agile_modbus_tcp_t ctx_tcp;
+
+// 正在处理请求的连接，请求处理回调通过 tcp_server_forward_write 转发写命令
+static tcp_conn_t *request_conn = NULL;
+static bool request_forwarded;
+
+// 唤醒套接字：连接到自身的 UDP 套接字，写命令完成回调发一个字节让 select 返回
+static int wake_sock = -1;
+
+// 当前允许的客户端数，配置值超出范围时取上限
+static int client_limit(void)
+{
+    int limit = tcp_slave.max_clients;
+    if (limit <= 0 || limit > TCP_SERVER_MAX_CLIENTS) {
+        limit = TCP_SERVER_MAX_CLIENTS;
+    }
+    return limit;
+}
+
+// 释放连接的收发缓冲区，连接槽可以再次使用
+static void conn_release(tcp_conn_t *conn)
+{
+    free(conn->rx);
+    conn->rx = NULL;
+    free(conn->tx);
+    conn->tx = NULL;
+}
+
+static void conn_close(tcp_conn_t *conn)
+{
+    ESP_LOGI(TAG, "Client %s disconnected", conn->addr);
+    shutdown(conn->sock, 0);
+    close(conn->sock);
+    conn->sock = -1;
+    conn->tx_len = 0;
+    // 转发中的写命令完成时还会访问本连接，等回调结束后再释放
+    if (conn->write_frame_len == 0) {
+        conn_release(conn);
+    }
+}
+
+// 记一个或多个写命令的结果，返回请求的写命令是否已全部完成
+static bool write_settle(tcp_conn_t *conn, int result, int count)
+{
+    if (result != WRITE_OK) {
+        int expected = WRITE_OK;
+        __atomic_compare_exchange_n(&conn->write_result, &expected, result, false,
+                                    __ATOMIC_RELAXED, __ATOMIC_RELAXED);
+    }
+    return __atomic_sub_fetch(&conn->writes_left, count, __ATOMIC_ACQ_REL) == 0;
+}
+
+// 写命令完成回调(轮询任务中)，最后一个写命令完成时唤醒服务器任务
+static void conn_write_done(int result, void *arg)
+{
+    if (write_settle((tcp_conn_t *)arg, result, 1)) {
+        uint8_t byte = 0;
+        send(wake_sock, &byte, 1, 0);
+    }
+}
+
+void tcp_server_forward_write(const write_req_t *req)
+{
+    tcp_conn_t *conn = request_conn;
+
+    if (conn == NULL) {
+        ESP_LOGE(TAG, "Write forwarded outside of a request, dropped");
+        return;
+    }
+    request_forwarded = true;
+    __atomic_add_fetch(&conn->writes_left, 1, __ATOMIC_ACQ_REL);
+    if (write_queue_submit(req, conn_write_done, conn) != ESP_OK) {
+        write_settle(conn, WRITE_ERR_FRAME, 1);
+    }
+}
+
+// 生成写请求的最终响应：回调不再访问数据，只返回写命令结果对应的异常
+static int write_result_callback(agile_modbus_t *ctx, struct agile_modbus_slave_info *slave_info,
+                                 const void *data)
+{
+    (void)ctx;
+    (void)slave_info;
+    return write_result_exception(*(const int *)data);
+}
+
+// 把 ctx 中生成的 send_len 字节响应计入连接的发送积压
+static void conn_queue_reply(tcp_conn_t *conn, int send_len)
+{
+    if (send_len <= 0) {
+        return;
+    }
+    if (conn->tx_len == 0) {
+        conn->tx_progress_us = esp_timer_get_time();
+    }
+    conn->tx_len += send_len;
+}
+
+// 按写命令结果为 frame 生成响应，追加到发送积压
+static void reply_write_result(tcp_conn_t *conn, uint8_t *frame, int frame_length)
 {
-    int sock = (int)pvParameters;
-    uint8_t ctx_send_buf[AGILE_MODBUS_MAX_ADU_LENGTH];
-    uint8_t ctx_read_buf[AGILE_MODBUS_MAX_ADU_LENGTH];
-    
-    // 初始化 Modbus TCP 上下文
-    agile_modbus_tcp_t ctx_tcp;
     agile_modbus_t *ctx = &ctx_tcp._ctx;
-    agile_modbus_tcp_init(&ctx_tcp, ctx_send_buf, sizeof(ctx_send_buf), 
-                         ctx_read_buf, sizeof(ctx_read_buf));
-    agile_modbus_set_slave(ctx, tcp_slave.slave_address);
 
-    // 设置非阻塞模式
-    int flags = fcntl(sock, F_GETFL, 0);
-    fcntl(sock, F_SETFL, flags | O_NONBLOCK);
+    ctx->read_buf = frame;
+    ctx->read_bufsz = frame_length;
+    ctx->send_buf = conn->tx + conn->tx_len;
+    ctx->send_bufsz = SERVER_TX_BUF_SIZE - conn->tx_len;
+    conn_queue_reply(conn, agile_modbus_slave_handle(ctx, frame_length, 0, write_result_callback,
+                                                     &conn->write_result, NULL));
+}
 
-    while (1) {
-        fd_set readfds;
-        struct timeval timeout;
-        
-        FD_ZERO(&readfds);
-        FD_SET(sock, &readfds);
-        
-        timeout.tv_sec = 1;  // 1秒超时
-        timeout.tv_usec = 0;
+// 处理一个完整的请求帧，响应追加到连接的发送积压，调用前保证放得下一个最大响应。
+// 响应带有请求的事务标识，按请求到达的顺序发送。请求转发了写命令时响应推迟，
+// 置 write_frame_len，由 conn_write_finish 在写命令完成后生成
+static void handle_request(tcp_conn_t *conn, uint8_t *frame, int frame_length)
+{
+    agile_modbus_t *ctx = &ctx_tcp._ctx;
 
-        int activity = select(sock + 1, &readfds, NULL, NULL, &timeout);
-        
-        if (activity < 0) {
-            ESP_LOGE(TAG, "Select error: errno %d", errno);
-            break;
+    ctx->read_buf = frame;
+    ctx->read_bufsz = frame_length;
+    ctx->send_buf = conn->tx + conn->tx_len;
+    ctx->send_bufsz = SERVER_TX_BUF_SIZE - conn->tx_len;
+
+    request_conn = conn;
+    request_forwarded = false;
+    conn->writes_left = 0;
+    conn->write_result = WRITE_OK;
+
+    // 处理 Modbus 请求：多单元号模式下按单元号直接访问各设备，
+    // 否则访问从站表，非本站地址的请求没有响应
+    int64_t cpu = perf_stage_begin();
+    int send_len;
+    if (tcp_slave.unit_mode) {
+        send_len = agile_modbus_slave_handle(ctx, frame_length, 0, tcp_unit_callback, NULL, NULL);
+    } else {
+        send_len = agile_modbus_slave_handle(ctx, frame_length, 0,
+                                             agile_modbus_slave_util_callback,
+                                             &slave_util, NULL);
+    }
+    perf_stage_end(PERF_STAGE_TCP_REQUEST, cpu);
+    request_conn = NULL;
+
+    if (!request_forwarded) {
+        conn_queue_reply(conn, send_len);
+    } else if (__atomic_load_n(&conn->writes_left, __ATOMIC_ACQUIRE) == 0) {
+        // 写命令都没能提交，或已经执行完
+        reply_write_result(conn, frame, frame_length);
+    } else {
+        conn->write_frame_len = frame_length;
+        conn->write_deadline_us = esp_timer_get_time() + WRITE_WAIT_MS * 1000LL;
+    }
+}
+
+// 把接收缓冲区中新收到的字节交给解析器，依次处理其中的完整请求帧，
+// 直到数据用完、发送积压放不下一个最大响应或有请求在等待写命令结果；
+// 未处理的数据移到缓冲区开头。帧头非法时返回失败
+static bool conn_process(tcp_conn_t *conn)
+{
+    int frame_start = 0;
+
+    while (conn->write_frame_len == 0 && conn->rx_fed < conn->rx_len &&
+           SERVER_TX_BUF_SIZE - conn->tx_len >= AGILE_MODBUS_MAX_ADU_LENGTH) {
+        int consumed = 0;
+        int status = agile_modbus_parser_feed(&conn->parser, conn->rx + conn->rx_fed,
+                                              conn->rx_len - conn->rx_fed, &consumed);
+        conn->rx_fed += consumed;
+        if (status == AGILE_MODBUS_PARSE_ERROR) {
+            ESP_LOGW(TAG, "Client %s sent an invalid MBAP header", conn->addr);
+            return false;
         }
-        
-        if (activity == 0) {
-            // 超时，继续等待
-            continue;
+        if (status == AGILE_MODBUS_PARSE_COMPLETE) {
+            handle_request(conn, conn->rx + frame_start, conn->rx_fed - frame_start);
+            // 等待写命令结果的帧留在缓冲区中
+            if (conn->write_frame_len == 0) {
+                frame_start = conn->rx_fed;
+            }
         }
+    }
 
-        if (FD_ISSET(sock, &readfds)) {
-            // 接收 Modbus 请求
-            int rc = recv(sock, ctx->read_buf, ctx->read_bufsz, 0);
-            if (rc <= 0) {
-                if (rc < 0 && errno != EAGAIN) {
-                    ESP_LOGE(TAG, "Recv error: errno %d", errno);
-                }
+    if (frame_start > 0) {
+        memmove(conn->rx, conn->rx + frame_start, conn->rx_len - frame_start);
+        conn->rx_len -= frame_start;
+        conn->rx_fed -= frame_start;
+    }
+    return true;
+}
+
+// 尽量发出积压的响应，套接字发送缓冲区满时留待可写后继续。出错时返回失败
+static bool conn_flush(tcp_conn_t *conn)
+{
+    int sent = 0;
+
+    while (sent < conn->tx_len) {
+        int written = send(conn->sock, conn->tx + sent, conn->tx_len - sent, 0);
+        if (written < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
                 break;
             }
+            ESP_LOGE(TAG, "Send error: errno %d", errno);
+            return false;
+        }
+        sent += written;
+    }
+    if (sent > 0) {
+        memmove(conn->tx, conn->tx + sent, conn->tx_len - sent);
+        conn->tx_len -= sent;
+        conn->tx_progress_us = esp_timer_get_time();
+    }
+    return true;
+}
 
-            // 处理 Modbus 请求
-            int send_len = agile_modbus_slave_handle(ctx, rc, 0, 
-                                                   agile_modbus_slave_util_callback,
-                                                   &slave_util, NULL);
-            
-            // 发送响应
-            if (send_len > 0) {
-                int remaining = send_len;
-                uint8_t *ptr = ctx->send_buf;
-                
-                while (remaining > 0) {
-                    int written = send(sock, ptr, remaining, 0);
-                    if (written < 0) {
-                        if (errno != EAGAIN) {
-                            ESP_LOGE(TAG, "Send error: errno %d", errno);
-                            goto cleanup;
-                        }
-                        // 如果是 EAGAIN，等待一下再重试
-                        vTaskDelay(pdMS_TO_TICKS(10));
-                        continue;
-                    }
-                    remaining -= written;
-                    ptr += written;
+// 交替处理请求和发送响应，直到没有可处理的请求、请求在等待写命令结果或客户端暂时不接收。
+// 出错时关闭连接
+static void conn_pump(tcp_conn_t *conn)
+{
+    while (1) {
+        int rx_len = conn->rx_len;
+        if (!conn_process(conn)) {
+            conn_close(conn);
+            return;
+        }
+        int tx_len = conn->tx_len;
+        if (!conn_flush(conn)) {
+            conn_close(conn);
+            return;
+        }
+        // 既没有处理请求也没有腾出发送空间时，再来一轮也不会有进展
+        if (conn->rx_len == rx_len && conn->tx_len == tx_len) {
+            return;
+        }
+    }
+}
+
+// 接收一次数据，连接关闭或出错时释放连接并返回失败
+static bool conn_recv(tcp_conn_t *conn)
+{
+    int rc = recv(conn->sock, conn->rx + conn->rx_len, SERVER_RX_BUF_SIZE - conn->rx_len, 0);
+    if (rc <= 0) {
+        if (rc < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            return true;
+        }
+        if (rc < 0) {
+            ESP_LOGE(TAG, "Recv error: errno %d", errno);
+        }
+        conn_close(conn);
+        return false;
+    }
+    conn->rx_len += rc;
+    return true;
+}
+
+// 请求的写命令全部完成：生成推迟的响应，继续处理之后排队的请求。连接已关闭时释放连接槽
+static void conn_write_finish(tcp_conn_t *conn)
+{
+    int len = conn->write_frame_len;
+
+    conn->write_frame_len = 0;
+    if (conn->sock < 0) {
+        conn_release(conn);
+        return;
+    }
+    reply_write_result(conn, conn->rx, len);
+    memmove(conn->rx, conn->rx + len, conn->rx_len - len);
+    conn->rx_len -= len;
+    conn->rx_fed -= len;
+    conn_pump(conn);
+}
+
+// 检查连接等待中的写命令和积压的响应：写命令完成时生成响应，排队过久的写命令撤回，
+// 积压的响应长时间发不出去时断开。返回距下一个期限的毫秒数，没有期限时返回 timeout_ms
+static int conn_check(tcp_conn_t *conn, int64_t now, int timeout_ms)
+{
+    if (conn->write_frame_len > 0) {
+        if (__atomic_load_n(&conn->writes_left, __ATOMIC_ACQUIRE) == 0) {
+            conn_write_finish(conn);
+        } else if (now >= conn->write_deadline_us) {
+            // 轮询任务停滞时撤回仍在排队的命令；已被取走的命令正在执行，等它回调
+            int cancelled = write_queue_cancel(conn_write_done, conn);
+            if (cancelled > 0) {
+                ESP_LOGW(TAG, "Client %s: %d write(s) not taken within %d ms, cancelled",
+                         conn->addr, cancelled, WRITE_WAIT_MS);
+                if (write_settle(conn, WRITE_ERR_EXPIRED, cancelled)) {
+                    conn_write_finish(conn);
                 }
             }
+            conn->write_deadline_us = INT64_MAX;
+        } else {
+            int ms = (int)((conn->write_deadline_us - now + 999) / 1000);
+            timeout_ms = ms < timeout_ms ? ms : timeout_ms;
         }
     }
 
-cleanup:
-    // 清理客户端连接
-    if (clients_mutex != NULL) {
-        xSemaphoreTake(clients_mutex, portMAX_DELAY);
-        for (int i = 0; i < MAX_CLIENTS; i++) {
-            if (clients[i].socket == sock) {
-                ESP_LOGI(TAG, "Cleaning up client slot %d", i);
-                shutdown(clients[i].socket, 0);
-                close(clients[i].socket);
-                clients[i].socket = 0;
-                clients[i].task = NULL;
-                break;
-            }
+    if (conn->sock >= 0 && conn->tx_len > 0) {
+        int64_t deadline = conn->tx_progress_us + SERVER_SEND_TIMEOUT_MS * 1000LL;
+        if (now >= deadline) {
+            ESP_LOGW(TAG, "Client %s not receiving responses for %d ms", conn->addr, SERVER_SEND_TIMEOUT_MS);
+            conn_close(conn);
+        } else {
+            int ms = (int)((deadline - now + 999) / 1000);
+            timeout_ms = ms < timeout_ms ? ms : timeout_ms;
         }
-        xSemaphoreGive(clients_mutex);
     }
-    
-    ESP_LOGI(TAG, "Client connection closed, deleting task");
-    vTaskDelete(NULL);  // 删除当前任务
+    return timeout_ms;
+}
+
+// 接受一个新连接，放入空闲的连接槽，超过客户端数上限时拒绝
+static void conn_accept(int listen_sock)
+{
+    struct sockaddr_in source_addr;
+    socklen_t addr_len = sizeof(source_addr);
+    int sock = accept(listen_sock, (struct sockaddr *)&source_addr, &addr_len);
+    if (sock < 0) {
+        if (errno != EAGAIN) {
+            ESP_LOGE(TAG, "Accept failed: errno %d", errno);
+        }
+        return;
+    }
+
+    char addr_str[16];
+    inet_ntoa_r(source_addr.sin_addr, addr_str, sizeof(addr_str) - 1);
+
+    // 已关闭但写命令尚未完成的连接槽不能使用
+    int limit = client_limit();
+    int active = 0;
+    int slot = -1;
+    for (int i = 0; i < TCP_SERVER_MAX_CLIENTS; i++) {
+        if (conns[i].sock >= 0) {
+            active++;
+        } else if (slot < 0 && conns[i].write_frame_len == 0) {
+            slot = i;
+        }
+    }
+    if (active >= limit || slot < 0) {
+        ESP_LOGW(TAG, "Maximum clients (%d) reached, rejecting connection from %s", limit, addr_str);
+        shutdown(sock, 0);
+        close(sock);
+        return;
+    }
+
+    // 设置 keepalive
+    int keepalive = 1;
+    int keepidle = SERVER_KEEPALIVE_IDLE;
+    int keepintvl = SERVER_KEEPALIVE_INTERVAL;
+    int keepcnt = SERVER_KEEPALIVE_COUNT;
+
+    setsockopt(sock, SOL_SOCKET, SO_KEEPALIVE, &keepalive, sizeof(int));
+    setsockopt(sock, IPPROTO_TCP, TCP_KEEPIDLE, &keepidle, sizeof(int));
+    setsockopt(sock, IPPROTO_TCP, TCP_KEEPINTVL, &keepintvl, sizeof(int));
+    setsockopt(sock, IPPROTO_TCP, TCP_KEEPCNT, &keepcnt, sizeof(int));
+
+    conns[slot].rx = malloc(SERVER_RX_BUF_SIZE);
+    conns[slot].tx = malloc(SERVER_TX_BUF_SIZE);
+    if (conns[slot].rx == NULL || conns[slot].tx == NULL) {
+        ESP_LOGE(TAG, "Failed to allocate buffers for %s", addr_str);
+        conn_release(&conns[slot]);
+        shutdown(sock, 0);
+        close(sock);
+        return;
+    }
+    conns[slot].rx_len = 0;
+    conns[slot].rx_fed = 0;
+    conns[slot].tx_len = 0;
+    agile_modbus_parser_init(&conns[slot].parser, &ctx_tcp._ctx, AGILE_MODBUS_MSG_INDICATION);
+
+    // 设置非阻塞模式
+    int flags = fcntl(sock, F_GETFL, 0);
+    fcntl(sock, F_SETFL, flags | O_NONBLOCK);
+
+    conns[slot].sock = sock;
+    snprintf(conns[slot].addr, sizeof(conns[slot].addr), "%s", addr_str);
+    ESP_LOGI(TAG, "Client connected on slot %d: %s (%d/%d)", slot, addr_str, active + 1, limit);
+}
+
+// 创建唤醒套接字：绑定回环地址的任意端口并连接到自身
+static int wake_sock_create(void)
+{
+    struct sockaddr_in addr = {
+        .sin_family = AF_INET,
+        .sin_addr.s_addr = htonl(INADDR_LOOPBACK),
+        .sin_port = 0,
+    };
+    socklen_t addr_len = sizeof(addr);
+
+    int sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_IP);
+    if (sock < 0) {
+        return -1;
+    }
+    if (bind(sock, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+        getsockname(sock, (struct sockaddr *)&addr, &addr_len) != 0 ||
+        connect(sock, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+        close(sock);
+        return -1;
+    }
+    int flags = fcntl(sock, F_GETFL, 0);
+    fcntl(sock, F_SETFL, flags | O_NONBLOCK);
+    return sock;
 }
 
+// 服务器任务：一次 select 同时等待监听套接字、唤醒套接字和所有客户端连接，
+// 有积压响应的连接同时等待可写。任务不睡眠也不阻塞在单个连接上：
+// 转发的写命令完成后由唤醒套接字通知，发不出去的响应留在连接的积压中
 static void tcp_server_task(void *pvParameters)
 {
     struct sockaddr_in dest_addr;
@@ -233,82 +553,106 @@ static void tcp_server_task(void *pvParameters)
         goto cleanup;
     }
 
-    if (listen(listen_sock, MAX_CLIENTS) != 0) {
+    if (listen(listen_sock, TCP_SERVER_MAX_CLIENTS) != 0) {
         ESP_LOGE(TAG, "Socket listen failed: errno %d", errno);
         goto cleanup;
     }
 
-    // 创建互斥锁
-    clients_mutex = xSemaphoreCreateMutex();
-    if (clients_mutex == NULL) {
-        ESP_LOGE(TAG, "Failed to create mutex");
+    // 监听套接字也设为非阻塞，select 之后 accept 不会卡住
+    int flags = fcntl(listen_sock, F_GETFL, 0);
+    fcntl(listen_sock, F_SETFL, flags | O_NONBLOCK);
+
+    wake_sock = wake_sock_create();
+    if (wake_sock < 0) {
+        ESP_LOGE(TAG, "Wake socket creation failed: errno %d", errno);
         goto cleanup;
     }
 
+    // 收发缓冲区在处理每个请求时指定
+    agile_modbus_tcp_init(&ctx_tcp, NULL, 0, NULL, 0);
+    agile_modbus_set_slave(&ctx_tcp._ctx, tcp_slave.slave_address);
+
+    ESP_LOGI(TAG, "Modbus TCP slave listening on port %d, up to %d clients",
+             tcp_slave.server_port, client_limit());
+
+    int timeout_ms = 1000;
     while (1) {
-        ESP_LOGI(TAG, "Modbus TCP slave listening on port %d", tcp_slave.server_port);
+        fd_set readfds;
+        fd_set writefds;
+        struct timeval timeout;
+        int max_fd = listen_sock > wake_sock ? listen_sock : wake_sock;
 
-        struct sockaddr_in source_addr;
-        socklen_t addr_len = sizeof(source_addr);
-        int sock = accept(listen_sock, (struct sockaddr *)&source_addr, &addr_len);
-        if (sock < 0) {
-            ESP_LOGE(TAG, "Accept failed: errno %d", errno);
+        FD_ZERO(&readfds);
+        FD_ZERO(&writefds);
+        FD_SET(listen_sock, &readfds);
+        FD_SET(wake_sock, &readfds);
+        for (int i = 0; i < TCP_SERVER_MAX_CLIENTS; i++) {
+            tcp_conn_t *conn = &conns[i];
+            if (conn->sock < 0) {
+                continue;
+            }
+            // 等待写命令结果或接收缓冲区已满(发送积压未清)时暂不接收，客户端的后续请求留在协议栈中
+            if (conn->write_frame_len == 0 && conn->rx_len < SERVER_RX_BUF_SIZE) {
+                FD_SET(conn->sock, &readfds);
+            }
+            if (conn->tx_len > 0) {
+                FD_SET(conn->sock, &writefds);
+            }
+            if (conn->sock > max_fd) {
+                max_fd = conn->sock;
+            }
+        }
+
+        timeout.tv_sec = timeout_ms / 1000;
+        timeout.tv_usec = (timeout_ms % 1000) * 1000;
+
+        int activity = select(max_fd + 1, &readfds, &writefds, NULL, &timeout);
+        if (activity < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            ESP_LOGE(TAG, "Select error: errno %d", errno);
             break;
         }
 
-        // 设置 keepalive
-        int keepalive = 1;
-        int keepidle = SERVER_KEEPALIVE_IDLE;
-        int keepintvl = SERVER_KEEPALIVE_INTERVAL;
-        int keepcnt = SERVER_KEEPALIVE_COUNT;
-
-        setsockopt(sock, SOL_SOCKET, SO_KEEPALIVE, &keepalive, sizeof(int));
-        setsockopt(sock, IPPROTO_TCP, TCP_KEEPIDLE, &keepidle, sizeof(int));
-        setsockopt(sock, IPPROTO_TCP, TCP_KEEPINTVL, &keepintvl, sizeof(int));
-        setsockopt(sock, IPPROTO_TCP, TCP_KEEPCNT, &keepcnt, sizeof(int));
-
-        char addr_str[128];
-        inet_ntoa_r(source_addr.sin_addr, addr_str, sizeof(addr_str) - 1);
-        
-        // 查找空闲的客户端槽位
-        xSemaphoreTake(clients_mutex, portMAX_DELAY);
-        int slot = -1;
-        for (int i = 0; i < MAX_CLIENTS; i++) {
-            if (clients[i].socket == 0) {
-                slot = i;
-                break;
+        if (activity > 0 && FD_ISSET(wake_sock, &readfds)) {
+            uint8_t drain[16];
+            while (recv(wake_sock, drain, sizeof(drain), 0) > 0) {
             }
         }
-        
-        if (slot == -1) {
-            ESP_LOGW(TAG, "Maximum clients reached, rejecting connection from %s", addr_str);
-            xSemaphoreGive(clients_mutex);
-            shutdown(sock, 0);
-            close(sock);
-            continue;
+
+        // 从站地址可能已被修改
+        agile_modbus_set_slave(&ctx_tcp._ctx, tcp_slave.slave_address);
+
+        int64_t now = esp_timer_get_time();
+        timeout_ms = 1000;
+        for (int i = 0; i < TCP_SERVER_MAX_CLIENTS; i++) {
+            tcp_conn_t *conn = &conns[i];
+            if (conn->sock >= 0 && activity > 0 &&
+                (FD_ISSET(conn->sock, &readfds) || FD_ISSET(conn->sock, &writefds))) {
+                if (!FD_ISSET(conn->sock, &readfds) || conn_recv(conn)) {
+                    conn_pump(conn);
+                }
+            }
+            if (conn->sock >= 0 || conn->write_frame_len > 0) {
+                timeout_ms = conn_check(conn, now, timeout_ms);
+            }
         }
 
-        ESP_LOGI(TAG, "Client connected on slot %d: %s", slot, addr_str);
-        clients[slot].socket = sock;
-        
-        // 为每个客户端创建一个任务
-        char task_name[32];
-        snprintf(task_name, sizeof(task_name), "client_%d", slot);
-        if (xTaskCreate(handle_client, task_name, SERVER_TASK_STACK_SIZE, 
-                       (void*)(intptr_t)sock, SERVER_TASK_PRIORITY, &clients[slot].task) != pdPASS) {
-            ESP_LOGE(TAG, "Failed to create client task");
-            clients[slot].socket = 0;
-            shutdown(sock, 0);
-            close(sock);
+        if (activity > 0 && FD_ISSET(listen_sock, &readfds)) {
+            conn_accept(listen_sock);
         }
-        
-        xSemaphoreGive(clients_mutex);
     }
 
 cleanup:
-    if (clients_mutex != NULL) {
-        vSemaphoreDelete(clients_mutex);
-        clients_mutex = NULL;
+    for (int i = 0; i < TCP_SERVER_MAX_CLIENTS; i++) {
+        if (conns[i].sock >= 0) {
+            conn_close(&conns[i]);
+        }
+    }
+    if (wake_sock >= 0) {
+        close(wake_sock);
+        wake_sock = -1;
     }
     close(listen_sock);
     vTaskDelete(NULL);       
@@ -316,15 +660,17 @@ cleanup:
 
 void start_tcp_server(void)
 {
-    // 初始化客户端数组
-    memset(clients, 0, sizeof(clients));
+    // 初始化连接槽
+    for (int i = 0; i < TCP_SERVER_MAX_CLIENTS; i++) {
+        conns[i].sock = -1;
+    }
     
     // 初始化 Modbus tcp寄存器
     init_tcp_slave_regs();
     
-    // 创建 TCP 服务器任务
+    // 创建 TCP 服务器任务，所有客户端连接都在这一个任务中处理
     xTaskCreate(tcp_server_task, "modbus_tcp_slave", SERVER_TASK_STACK_SIZE, 
                 NULL, SERVER_TASK_PRIORITY, NULL);
 
     xTaskCreate(modbus_regs_update_task, "modbus_update", 4096, NULL, 7, NULL);
-}
\ No newline at end of file
+}
@@ -2,14 +2,32 @@
 #ifndef TCP_SERVER_H
 #define TCP_SERVER_H
 
+#include "sdkconfig.h"
+#include "write_queue.h"
+
 #define SERVER_KEEPALIVE_IDLE 5
 #define SERVER_KEEPALIVE_INTERVAL 5
 #define SERVER_KEEPALIVE_COUNT 3
 #define SERVER_TASK_STACK_SIZE 4096
 #define SERVER_TASK_PRIORITY 11
+#define SERVER_SEND_TIMEOUT_MS 1000     // 积压的响应超过该时间发不出去(客户端不接收)即断开
+#define SERVER_RX_BUF_SIZE 1024         // 每个连接的接收缓冲区，可容纳多个流水线请求
+#define SERVER_TX_BUF_SIZE 1460         // 每个连接的发送积压缓冲区，放不下一个最大响应时暂停处理该连接的请求
 
-#define MAX_CLIENTS 3
+// 客户端连接数上限：lwIP 套接字总数扣除其他用途的套接字
+// (本服务器监听及唤醒、MQTT客户端、Web服务器监听/控制及一个浏览器连接)
+#define TCP_SERVER_RESERVED_SOCKETS 6
+#ifdef CONFIG_LWIP_MAX_SOCKETS
+#define TCP_SERVER_MAX_CLIENTS (CONFIG_LWIP_MAX_SOCKETS - TCP_SERVER_RESERVED_SOCKETS)
+#else
+#define TCP_SERVER_MAX_CLIENTS 8
+#endif
+#define TCP_SERVER_DEFAULT_CLIENTS 6    // tcp_slave.max_clients 的默认值
 
 void start_tcp_server(void);
 
+// 只能在请求处理回调中调用：把写命令转发给现场设备，当前请求的响应推迟到它的所有写命令完成后生成，
+// 回调应返回 0。写命令失败(含提交失败)时响应为第一个失败对应的异常
+void tcp_server_forward_write(const write_req_t *req);
+
 #endif
@@ -1,5 +1,8 @@
 #include "tcp_slave_regs.h"
+#include "tcp_server.h"
 #include "modbus_config.h"
+#include "write_queue.h"
+#include "perf_stage.h"
 #include "esp_log.h"
 #include "nvs.h"
 #include <string.h>
@@ -12,6 +15,7 @@ tcp_slave_t tcp_slave = {
     .enabled = false,        // 默认不启用
     .server_port = 502,       // Modbus TCP 默认端口
     .slave_address = 123,     // 默认从站地址
+    .max_clients = TCP_SERVER_DEFAULT_CLIENTS,
     
     // 寄存器映射配置
     .maps = {
@@ -29,18 +33,164 @@ tcp_slave_t tcp_slave = {
     }
 };
 
+// 从站位表按位打包(与采集数据和Modbus帧中的位序相同)，寄存器表每元素一个寄存器
+#define BIT_TAB_BYTES(n) (((n) + 7) / 8)
+
 // 定义tcp从站寄存器
 static uint8_t *tab_bits = NULL;
 static uint8_t *tab_input_bits = NULL;
 static uint16_t *tab_registers = NULL;
 static uint16_t *tab_input_registers = NULL;
 
-// 更新从站数据函数
-void update_slave_data(void) {
+// 从站表被整体改写(映射变更或客户端写入)后需要完整刷新一次
+static volatile bool full_refresh = true;
+
+// 客户端写入从站表后、写命令取走写入值之前，刷新不得覆盖从站表
+// 只在持有 modbus_mutex 时增加，刷新也在持有互斥量时检查，减少无需互斥量
+static int client_writes_pending = 0;
+
+// 从站工具在 TCP 服务器的 select 循环中加锁，最多等待这么久，超时以从站忙响应而不阻塞其他连接
+#define TCP_SLAVE_LOCK_WAIT_MS 10
+
+// 从站工具直接访问从站表时的加锁接口，写入时同时挡住刷新直到写命令转发完成
+static int tcp_slave_lock(int op) {
+    if (op == AGILE_MODBUS_SLAVE_UTIL_UNLOCK) {
+        xSemaphoreGive(modbus_mutex);
+        return 0;
+    }
+    if (xSemaphoreTake(modbus_mutex, pdMS_TO_TICKS(TCP_SLAVE_LOCK_WAIT_MS)) != pdTRUE) {
+        return -AGILE_MODBUS_EXCEPTION_SLAVE_OR_SERVER_BUSY;
+    }
+    if (op == AGILE_MODBUS_SLAVE_UTIL_LOCK_WRITE) {
+        __atomic_add_fetch(&client_writes_pending, 1, __ATOMIC_RELAXED);
+    }
+    return 0;
+}
+
+// 取得从站表互斥量准备刷新，有客户端写入正在转发时放弃，并在之后完整刷新
+static bool refresh_lock(void) {
     xSemaphoreTake(modbus_mutex, portMAX_DELAY);
-    
+    if (__atomic_load_n(&client_writes_pending, __ATOMIC_ACQUIRE) > 0) {
+        xSemaphoreGive(modbus_mutex);
+        full_refresh = true;
+        return false;
+    }
+    return true;
+}
+
+// 刷新任务句柄，刷新任务启动前为 NULL
+static TaskHandle_t refresh_task = NULL;
+
+void tcp_slave_regs_invalidate(void) {
+    full_refresh = true;
+    if (refresh_task) {
+        xTaskNotifyGive(refresh_task);
+    }
+}
+
+// 判断脏位图在 [first, first + count) 区间内是否有变化
+static bool range_dirty(const uint32_t *dirty, int first, int count) {
+    for (int u = first; u < first + count && u < DIRTY_UNITS; u++) {
+        if (dirty[u / 32] & (1UL << (u % 32))) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// 将组数据的位区间按字移位复制到从站位表
+static void copy_group_bits(int i, uint8_t function_code, uint8_t *tab) {
+    uint8_t bytes[MAX_BIT_BYTES];
+    uint16_t first = tcp_slave.maps[i].master_start_addr;
+    uint16_t count = tcp_slave.maps[i].count;
+    size_t offset = first / 8;
+    size_t len = (first + count + 7) / 8 - offset;
+
+    // 只复制映射覆盖的字节，读取到的是一次完整采集后的快照
+    if (len > sizeof(bytes) ||
+        !modbus_data_read(tcp_slave.maps[i].group_index, function_code, offset, bytes, len)) {
+        return;
+    }
+
+    if (!refresh_lock()) {
+        return;
+    }
+    agile_modbus_copy_bits(tab, tcp_slave.maps[i].slave_start_addr, bytes, first - offset * 8, count);
+    xSemaphoreGive(modbus_mutex);
+}
+
+// 将组数据中从 master_addr 开始的 count 个寄存器复制到从站寄存器表的 slave_addr 处
+static void copy_group_regs(int group, uint8_t function_code, uint16_t *tab,
+                            uint16_t master_addr, uint16_t slave_addr, uint16_t count) {
+    // 互斥量只保护从站寄存器表，组数据通过顺序锁直接读入目标位置
+    if (!refresh_lock()) {
+        return;
+    }
+    modbus_data_read(group, function_code, master_addr * sizeof(uint16_t),
+                     &tab[slave_addr], count * sizeof(uint16_t));
+    xSemaphoreGive(modbus_mutex);
+}
+
+// 只复制映射区间内发生变化的连续寄存器段，full 为 true 时复制整个映射
+static void copy_map_regs(int i, uint8_t function_code, uint16_t *tab,
+                          const uint32_t *dirty, bool full) {
+    int group = tcp_slave.maps[i].group_index;
+    uint16_t first = tcp_slave.maps[i].master_start_addr;
+    uint16_t count = tcp_slave.maps[i].count;
+
+    if (full) {
+        copy_group_regs(group, function_code, tab, first, tcp_slave.maps[i].slave_start_addr, count);
+        return;
+    }
+
+    uint16_t j = 0;
+    while (j < count) {
+        if (!range_dirty(dirty, first + j, 1)) {
+            j++;
+            continue;
+        }
+        uint16_t run = 1;
+        while (j + run < count && range_dirty(dirty, first + j + run, 1)) {
+            run++;
+        }
+        copy_group_regs(group, function_code, tab, first + j, tcp_slave.maps[i].slave_start_addr + j, run);
+        j += run;
+    }
+}
+
+// 更新从站数据函数，只处理自上次更新以来发生变化的部分。
+// 多单元号模式下客户端直接读采集数据，不刷新从站表；切换回来时做一次完整刷新
+void update_slave_data(void) {
+    static uint32_t dirty[MAX_POLL_GROUPS][DIRTY_WORDS];
+    static uint32_t seen_seq[MAX_POLL_GROUPS];
+    bool changed[MAX_POLL_GROUPS];
+
+    if (tcp_slave.unit_mode) {
+        full_refresh = true;
+        return;
+    }
+    bool full = full_refresh;
+
+    full_refresh = false;
+
+    // 每组只取一次脏位图，多个映射可共用同一组；没有新采样的组直接跳过
+    for (int g = 0; g < MAX_POLL_GROUPS; g++) {
+        uint32_t seq = modbus_data_sample_seq(g);
+        if (seq == seen_seq[g]) {
+            changed[g] = false;
+            continue;
+        }
+        seen_seq[g] = seq;
+        changed[g] = modbus_data_take_dirty(MODBUS_CONSUMER_TCP, g, dirty[g]);
+    }
+
     for (int i = 0; i < MAX_MAPS; i++) {
-        if (!modbus_data.register_ready[tcp_slave.maps[i].group_index]) {
+        int group = tcp_slave.maps[i].group_index;
+        if (group >= MAX_POLL_GROUPS || tcp_slave.maps[i].count == 0 ||
+            !modbus_data.register_ready[group]) {
+            continue;
+        }
+        if (!full && !changed[group]) {
             continue;
         }
 
@@ -54,136 +204,124 @@ void update_slave_data(void) {
             continue;
         }
 
+        uint16_t first = tcp_slave.maps[i].master_start_addr;
+        uint16_t count = tcp_slave.maps[i].count;
+
         switch (tcp_slave.maps[i].type) {
             case MAP_COIL_TO_COIL:
-                for (uint16_t j = 0; j < tcp_slave.maps[i].count; j++) {
-                    uint8_t byte_index = (tcp_slave.maps[i].master_start_addr + j) / 8;
-                    uint8_t bit_index = (tcp_slave.maps[i].master_start_addr + j) % 8;
-                    bool bit_value = (modbus_data.coils[tcp_slave.maps[i].group_index][byte_index] >> bit_index) & 0x01;
-                    tab_bits[tcp_slave.maps[i].slave_start_addr + j] = bit_value;
-                }
+                if (full || range_dirty(dirty[group], first / 8, (first + count + 7) / 8 - first / 8))
+                    copy_group_bits(i, 1, tab_bits);
                 break;
             
             case MAP_DISC_TO_DISC:
-                for (uint16_t j = 0; j < tcp_slave.maps[i].count; j++) {
-                    uint8_t byte_index = (tcp_slave.maps[i].master_start_addr + j) / 8;
-                    uint8_t bit_index = (tcp_slave.maps[i].master_start_addr + j) % 8;
-                    bool bit_value = (modbus_data.discrete_inputs[tcp_slave.maps[i].group_index][byte_index] >> bit_index) & 0x01;
-                    tab_input_bits[tcp_slave.maps[i].slave_start_addr + j] = bit_value;
-                }
+                if (full || range_dirty(dirty[group], first / 8, (first + count + 7) / 8 - first / 8))
+                    copy_group_bits(i, 2, tab_input_bits);
                 break;
             
             case MAP_HOLD_TO_HOLD:
-                memcpy(&tab_registers[tcp_slave.maps[i].slave_start_addr],
-                       &modbus_data.holding_regs[tcp_slave.maps[i].group_index][tcp_slave.maps[i].master_start_addr],
-                       tcp_slave.maps[i].count * sizeof(uint16_t));
+                copy_map_regs(i, 3, tab_registers, dirty[group], full);
                 break;
             
             case MAP_INPUT_TO_INPUT:
-                memcpy(&tab_input_registers[tcp_slave.maps[i].slave_start_addr],
-                       &modbus_data.input_regs[tcp_slave.maps[i].group_index][tcp_slave.maps[i].master_start_addr],
-                       tcp_slave.maps[i].count * sizeof(uint16_t));
+                copy_map_regs(i, 4, tab_input_registers, dirty[group], full);
                 break;
         }
     }
-    
-    xSemaphoreGive(modbus_mutex);
 }
 
-// 线圈(Coils)处理函数
-static int get_bits_buf(void *buf, int bufsz) {
-    // 验证缓冲区大小
-    if (bufsz < tcp_slave.reg_sizes.tab_bits_size) {
-        ESP_LOGE("MODBUS", "Buffer too small for bits");
-        return -1;
+// 把客户端写入从站表 [index, index + len) 中落在映射区内的部分转发给现场设备，
+// values 为整个从站表(线圈为打包的位表)，提交时写入值即复制进写命令，期间刷新不会改写。
+// 不等待执行结果，客户端的响应由服务器在所有写命令完成后按第一个失败生成
+static void forward_writes(map_type_t type, int index, int len, const void *values) {
+    static write_req_t req;
+    bool bits = (type == MAP_COIL_TO_COIL);
+
+    for (int i = 0; i < MAX_MAPS; i++) {
+        int group = tcp_slave.maps[i].group_index;
+        if (tcp_slave.maps[i].type != type || tcp_slave.maps[i].count == 0 ||
+            group >= modbus_config.group_count) {
+            continue;
+        }
+        const poll_group_config_t *cfg = &modbus_config.groups[group];
+        if (cfg->function_code != (bits ? 1 : 3)) {
+            continue;
+        }
+
+        // 客户端写入区间与映射区的交集
+        int map_start = tcp_slave.maps[i].slave_start_addr;
+        int first = index > map_start ? index : map_start;
+        int end = index + len;
+        if (end > map_start + tcp_slave.maps[i].count) {
+            end = map_start + tcp_slave.maps[i].count;
+        }
+
+        // 超过单条写命令上限时分段提交
+        while (first < end) {
+            int count = end - first;
+            if (count > (bits ? WRITE_MAX_BITS : WRITE_MAX_REGS)) {
+                count = bits ? WRITE_MAX_BITS : WRITE_MAX_REGS;
+            }
+
+            memset(&req, 0, sizeof(req));
+            req.uart_port = cfg->uart_port;
+            req.slave_addr = cfg->slave_addr;
+            req.addr = cfg->start_addr + tcp_slave.maps[i].master_start_addr + (first - map_start);
+            req.count = count;
+            if (bits) {
+                req.function_code = (count == 1) ? 5 : 15;
+                agile_modbus_copy_packed_bits(req.bits, values, first, count);
+            } else {
+                req.function_code = (count == 1) ? 6 : 16;
+                memcpy(req.regs, (const uint16_t *)values + first, count * sizeof(uint16_t));
+            }
+
+            tcp_server_forward_write(&req);
+            first += count;
+        }
     }
-    
-    xSemaphoreTake(modbus_mutex, portMAX_DELAY);
-    memcpy(buf, tab_bits, tcp_slave.reg_sizes.tab_bits_size);
-    xSemaphoreGive(modbus_mutex);
-    return 0;
 }
 
+// 客户端写入结束：写入值已由写命令取走，允许刷新并在下次完整同步
+static void client_write_done(void) {
+    __atomic_sub_fetch(&client_writes_pending, 1, __ATOMIC_RELEASE);
+    // 客户端写入可能覆盖映射区，下次更新时重新完整同步
+    tcp_slave_regs_invalidate();
+}
+
+// 线圈(Coils)写入通知，buf 即从站线圈表，写入的值位于 index 处
 static int set_bits_buf(int index, int len, void *buf, int bufsz) {
+    int rc;
+
     // 验证索引和长度
     if (index < 0 || len <= 0 || index + len > tcp_slave.reg_sizes.tab_bits_size) {
         ESP_LOGE("MODBUS", "Invalid index or length for bits: index=%d, len=%d, max=%d", 
                  index, len, tcp_slave.reg_sizes.tab_bits_size);
-        return -AGILE_MODBUS_EXCEPTION_ILLEGAL_DATA_ADDRESS;
+        rc = -AGILE_MODBUS_EXCEPTION_ILLEGAL_DATA_ADDRESS;
+    } else {
+        // 映射区内的写入转发到现场设备，从站异常或无应答时返回给客户端
+        forward_writes(MAP_COIL_TO_COIL, index, len, buf);
+        rc = 0;
     }
-    
-    // 验证缓冲区大小
-    if (bufsz < len) {
-        ESP_LOGE("MODBUS", "Buffer too small for bits");
-        return -AGILE_MODBUS_EXCEPTION_SLAVE_OR_SERVER_FAILURE;
-    }
-    
-    xSemaphoreTake(modbus_mutex, portMAX_DELAY);
-    memcpy(&tab_bits[index], buf, len);
-    xSemaphoreGive(modbus_mutex);
-    return 0;
-}
-
-// 离散输入(Discrete Inputs)处理函数
-static int get_input_bits_buf(void *buf, int bufsz) {
-    // 验证缓冲区大小
-    if (bufsz < tcp_slave.reg_sizes.tab_input_bits_size) {
-        ESP_LOGE("MODBUS", "Buffer too small for input bits");
-        return -1;
-    }
-    
-    xSemaphoreTake(modbus_mutex, portMAX_DELAY);
-    memcpy(buf, tab_input_bits, tcp_slave.reg_sizes.tab_input_bits_size);
-    xSemaphoreGive(modbus_mutex);
-    return 0;
-}
-
-// 保持寄存器(Holding Registers)处理函数
-static int get_registers_buf(void *buf, int bufsz) {
-    // 验证缓冲区大小
-    if (bufsz < tcp_slave.reg_sizes.tab_registers_size * sizeof(uint16_t)) {
-        ESP_LOGE("MODBUS", "Buffer too small for registers");
-        return -1;
-    }
-    
-    xSemaphoreTake(modbus_mutex, portMAX_DELAY);
-    memcpy(buf, tab_registers, tcp_slave.reg_sizes.tab_registers_size * sizeof(uint16_t));
-    xSemaphoreGive(modbus_mutex);
-    return 0;
+    client_write_done();
+    return rc;
 }
 
+// 保持寄存器(Holding Registers)写入通知，buf 即从站保持寄存器表
 static int set_registers_buf(int index, int len, void *buf, int bufsz) {
+    int rc;
+
     // 验证索引和长度
     if (index < 0 || len <= 0 || index + len > tcp_slave.reg_sizes.tab_registers_size) {
         ESP_LOGE("MODBUS", "Invalid index or length for registers: index=%d, len=%d, max=%d", 
                  index, len, tcp_slave.reg_sizes.tab_registers_size);
-        return -AGILE_MODBUS_EXCEPTION_ILLEGAL_DATA_ADDRESS;
+        rc = -AGILE_MODBUS_EXCEPTION_ILLEGAL_DATA_ADDRESS;
+    } else {
+        // 映射区内的写入转发到现场设备，从站异常或无应答时返回给客户端
+        forward_writes(MAP_HOLD_TO_HOLD, index, len, buf);
+        rc = 0;
     }
-    
-    // 验证缓冲区大小
-    if (bufsz < len * sizeof(uint16_t)) {
-        ESP_LOGE("MODBUS", "Buffer too small for registers");
-        return -AGILE_MODBUS_EXCEPTION_SLAVE_OR_SERVER_FAILURE;
-    }
-    
-    xSemaphoreTake(modbus_mutex, portMAX_DELAY);
-    memcpy(&tab_registers[index], buf, len * sizeof(uint16_t));
-    xSemaphoreGive(modbus_mutex);
-    return 0;
-}
-
-// 输入寄存器(Input Registers)处理函数
-static int get_input_registers_buf(void *buf, int bufsz) {
-    // 验证缓冲区大小
-    if (bufsz < tcp_slave.reg_sizes.tab_input_registers_size * sizeof(uint16_t)) {
-        ESP_LOGE("MODBUS", "Buffer too small for input registers");
-        return -1;
-    }
-    
-    xSemaphoreTake(modbus_mutex, portMAX_DELAY);
-    memcpy(buf, tab_input_registers, tcp_slave.reg_sizes.tab_input_registers_size * sizeof(uint16_t));
-    xSemaphoreGive(modbus_mutex);
-    return 0;
+    client_write_done();
+    return rc;
 }
 
 // 从站寄存器映射表配置（全局变量，但不初始化）
@@ -201,8 +339,8 @@ void init_tcp_slave_regs(void) {
     }
     
     // 动态分配从站寄存器数组
-    tab_bits = (uint8_t *)malloc(tcp_slave.reg_sizes.tab_bits_size);
-    tab_input_bits = (uint8_t *)malloc(tcp_slave.reg_sizes.tab_input_bits_size);
+    tab_bits = (uint8_t *)malloc(BIT_TAB_BYTES(tcp_slave.reg_sizes.tab_bits_size));
+    tab_input_bits = (uint8_t *)malloc(BIT_TAB_BYTES(tcp_slave.reg_sizes.tab_input_bits_size));
     tab_registers = (uint16_t *)malloc(tcp_slave.reg_sizes.tab_registers_size * sizeof(uint16_t));
     tab_input_registers = (uint16_t *)malloc(tcp_slave.reg_sizes.tab_input_registers_size * sizeof(uint16_t));
     
@@ -214,47 +352,64 @@ void init_tcp_slave_regs(void) {
     }
     
     // 初始化从站寄存器数组
-    memset(tab_bits, 0, tcp_slave.reg_sizes.tab_bits_size);
-    memset(tab_input_bits, 0, tcp_slave.reg_sizes.tab_input_bits_size);
+    memset(tab_bits, 0, BIT_TAB_BYTES(tcp_slave.reg_sizes.tab_bits_size));
+    memset(tab_input_bits, 0, BIT_TAB_BYTES(tcp_slave.reg_sizes.tab_input_bits_size));
     memset(tab_registers, 0, tcp_slave.reg_sizes.tab_registers_size * sizeof(uint16_t));
     memset(tab_input_registers, 0, tcp_slave.reg_sizes.tab_input_registers_size * sizeof(uint16_t));
     
-    // 初始化从站寄存器映射表，确保end_addr不超过寄存器尺寸
+    // 初始化从站寄存器映射表，确保end_addr不超过寄存器尺寸。
+    // 从站工具直接读写从站表，只访问请求涉及的元素，表的大小不受单帧缓冲区限制
     bit_maps[0] = (agile_modbus_slave_util_map_t){
         0x0000,
         tcp_slave.reg_sizes.tab_bits_size - 1,
-        get_bits_buf,
-        set_bits_buf
+        NULL,
+        set_bits_buf,
+        tab_bits,
+        tcp_slave_lock
     };
     
     input_bit_maps[0] = (agile_modbus_slave_util_map_t){
         0x0000,
         tcp_slave.reg_sizes.tab_input_bits_size - 1,
-        get_input_bits_buf,
-        NULL
+        NULL,
+        NULL,
+        tab_input_bits,
+        tcp_slave_lock
     };
     
     register_maps[0] = (agile_modbus_slave_util_map_t){
         0x0000,
         tcp_slave.reg_sizes.tab_registers_size - 1,
-        get_registers_buf,
-        set_registers_buf
+        NULL,
+        set_registers_buf,
+        tab_registers,
+        tcp_slave_lock
     };
     
     input_register_maps[0] = (agile_modbus_slave_util_map_t){
         0x0000,
         tcp_slave.reg_sizes.tab_input_registers_size - 1,
-        get_input_registers_buf,
-        NULL
+        NULL,
+        NULL,
+        tab_input_registers,
+        tcp_slave_lock
     };
 }
 
 
 // 定时更新函数
+// 从站表刷新任务：轮询任务写入有变化的组数据后通知本任务，只刷新变化的组对应的映射；
+// 映射变更和客户端写入后通过 tcp_slave_regs_invalidate 通知完整刷新。没有变化时不唤醒
 void modbus_regs_update_task(void *pvParameters) {
+    refresh_task = xTaskGetCurrentTaskHandle();
+    modbus_data_set_listener(MODBUS_CONSUMER_TCP, refresh_task);
+
     while (1) {
+        int64_t cpu = perf_stage_begin();
         update_slave_data();
-        vTaskDelay(pdMS_TO_TICKS(100));
+        perf_stage_end(PERF_STAGE_TCP_REFRESH, cpu);
+        // 刷新期间到达的多次通知合并为下一次刷新
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
     }
 }
 
@@ -288,6 +443,20 @@ esp_err_t save_tcp_slave_config_to_nvs(tcp_slave_t *config) {
         return err;
     }
 
+    err = nvs_set_u8(handle, "max_clients", config->max_clients);
+    if (err != ESP_OK) {
+        ESP_LOGE("MODBUS", "Failed to save max clients: %d", err);
+        nvs_close(handle);
+        return err;
+    }
+
+    err = nvs_set_u8(handle, "unit_mode", config->unit_mode);
+    if (err != ESP_OK) {
+        ESP_LOGE("MODBUS", "Failed to save unit mode: %d", err);
+        nvs_close(handle);
+        return err;
+    }
+
     // 保存寄存器映射配置
     err = nvs_set_blob(handle, "maps", config->maps, sizeof(config->maps));
     if (err != ESP_OK) {
@@ -345,6 +514,16 @@ esp_err_t load_tcp_slave_config_from_nvs(tcp_slave_t *config) {
         return err;
     }
 
+    uint8_t max_clients;
+    if (nvs_get_u8(handle, "max_clients", &max_clients) == ESP_OK) {
+        config->max_clients = max_clients;
+    }
+
+    uint8_t unit_mode;
+    if (nvs_get_u8(handle, "unit_mode", &unit_mode) == ESP_OK) {
+        config->unit_mode = unit_mode;
+    }
+
     // 加载寄存器映射配置
     required_size = sizeof(config->maps);
     err = nvs_get_blob(handle, "maps", config->maps, &required_size);
@@ -365,4 +544,120 @@ esp_err_t load_tcp_slave_config_from_nvs(tcp_slave_t *config) {
 
     nvs_close(handle);
     return ESP_OK;
-}
\ No newline at end of file
+}
+
+// 从JSON更新TCP从站配置，映射表整体替换
+void tcp_slave_config_from_json(tcp_slave_t *config, const cJSON *root)
+{
+    // 解析基础参数
+    cJSON *item = cJSON_GetObjectItem(root, "enabled");
+    if (item)
+    {
+        config->enabled = item->valueint;
+    }
+
+    item = cJSON_GetObjectItem(root, "server_port");
+    if (item)
+    {
+        config->server_port = item->valueint;
+    }
+
+    item = cJSON_GetObjectItem(root, "slave_address");
+    if (item)
+    {
+        config->slave_address = item->valueint;
+    }
+
+    item = cJSON_GetObjectItem(root, "max_clients");
+    if (item && item->valueint > 0)
+    {
+        config->max_clients = item->valueint > TCP_SERVER_MAX_CLIENTS ? TCP_SERVER_MAX_CLIENTS : item->valueint;
+    }
+
+    item = cJSON_GetObjectItem(root, "unit_mode");
+    if (item)
+    {
+        config->unit_mode = cJSON_IsTrue(item);
+    }
+
+    // 解析寄存器尺寸配置
+    cJSON *reg_sizes = cJSON_GetObjectItem(root, "reg_sizes");
+    if (reg_sizes)
+    {
+        item = cJSON_GetObjectItem(reg_sizes, "tab_bits_size");
+        if (item)
+        {
+            config->reg_sizes.tab_bits_size = item->valueint;
+        }
+
+        item = cJSON_GetObjectItem(reg_sizes, "tab_input_bits_size");
+        if (item)
+        {
+            config->reg_sizes.tab_input_bits_size = item->valueint;
+        }
+
+        item = cJSON_GetObjectItem(reg_sizes, "tab_registers_size");
+        if (item)
+        {
+            config->reg_sizes.tab_registers_size = item->valueint;
+        }
+
+        item = cJSON_GetObjectItem(reg_sizes, "tab_input_registers_size");
+        if (item)
+        {
+            config->reg_sizes.tab_input_registers_size = item->valueint;
+        }
+    }
+
+    // 先清空旧的映射配置
+    memset(&config->maps, 0, sizeof(config->maps));
+
+    // 解析映射配置
+    cJSON *maps = cJSON_GetObjectItem(root, "maps");
+    if (maps && cJSON_IsArray(maps))
+    {
+        int map_count = cJSON_GetArraySize(maps);
+        if (map_count > MAX_MAPS)
+        {
+            map_count = MAX_MAPS; // 限制最大映射数量
+        }
+
+        // 遍历并设置映射
+        for (int i = 0; i < map_count; i++)
+        {
+            cJSON *map = cJSON_GetArrayItem(maps, i);
+            if (!map)
+                continue;
+
+            item = cJSON_GetObjectItem(map, "type");
+            if (item)
+            {
+                config->maps[i].type = item->valueint;
+            }
+
+            item = cJSON_GetObjectItem(map, "group_index");
+            if (item)
+            {
+                config->maps[i].group_index = item->valueint;
+            }
+
+            item = cJSON_GetObjectItem(map, "master_start_addr");
+            if (item)
+            {
+                config->maps[i].master_start_addr = item->valueint;
+            }
+
+            item = cJSON_GetObjectItem(map, "slave_start_addr");
+            if (item)
+            {
+                config->maps[i].slave_start_addr = item->valueint;
+            }
+
+            item = cJSON_GetObjectItem(map, "count");
+            if (item)
+            {
+                config->maps[i].count = item->valueint;
+            }
+        }
+    }
+}
@@ -5,12 +5,16 @@
 #include "freertos/semphr.h"
 #include "agile_modbus.h"
 #include "agile_modbus_slave_util.h"
+#include "cJSON.h"
 
 // 声明初始化函数
 void init_tcp_slave_regs(void);
 
 void update_slave_data(void);
 
+// 映射配置变更或从站表被改写后调用，下次更新时完整同步所有映射
+void tcp_slave_regs_invalidate(void);
+
 void modbus_regs_update_task(void *pvParameters);
 
 
@@ -41,6 +45,8 @@ typedef struct {
     // 基础通信参数
     uint16_t server_port;      // Modbus TCP 端口号
     uint8_t slave_address;     // 从站设备地址
+    uint8_t max_clients;       // 同时连接的客户端数上限，超过 TCP_SERVER_MAX_CLIENTS 时取 TCP_SERVER_MAX_CLIENTS
+    bool unit_mode;            // 多单元号模式：每个轮询从站地址作为一个单元号直接访问(见 tcp_unit.h)，不使用映射和从站表
     
     // 寄存器映射配置
     struct {
@@ -66,6 +72,8 @@ extern tcp_slave_t tcp_slave;
 
 esp_err_t save_tcp_slave_config_to_nvs(tcp_slave_t *config);
 esp_err_t load_tcp_slave_config_from_nvs(tcp_slave_t *config);
+// 从JSON更新TCP从站配置(字段与 /api/tcp_slave/config 相同)，之后需调用 tcp_slave_regs_invalidate
+void tcp_slave_config_from_json(tcp_slave_t *config, const cJSON *root);
 
 
 #endif
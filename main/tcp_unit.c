@@ -0,0 +1,207 @@
+#include <string.h>
+#include "esp_log.h"
+#include "tcp_unit.h"
+#include "modbus_config.h"
+#include "write_queue.h"
+#include "tcp_server.h"
+
+static const char *TAG = "tcp_unit";
+
+#define UNIT_COUNT 256
+#define UNIT_READ_FCS 4     // 读功能码01~04
+
+// 单元号在一个读功能码下的轮询组：unit_groups 中 [first, first + count)，按起始地址排序
+typedef struct {
+    uint8_t first;
+    uint8_t count;
+} unit_span_t;
+
+typedef struct {
+    uint8_t uart_port;                  // 设备所在逻辑串口，0 表示没有该单元号
+    unit_span_t span[UNIT_READ_FCS];
+} unit_entry_t;
+
+static unit_entry_t unit_index[UNIT_COUNT];
+static uint8_t unit_groups[MAX_POLL_GROUPS];   // 按(单元号、功能码、起始地址)排序的组下标
+static uint32_t index_generation;
+static bool index_valid;
+
+// 组的排序关键字：单元号、功能码、起始地址
+static uint32_t group_key(int g)
+{
+    const poll_group_config_t *cfg = &modbus_config.groups[g];
+    return ((uint32_t)cfg->slave_addr << 24) | ((uint32_t)cfg->function_code << 16) | cfg->start_addr;
+}
+
+void tcp_unit_index_rebuild(void)
+{
+    int count = modbus_config.group_count < MAX_POLL_GROUPS ? modbus_config.group_count : MAX_POLL_GROUPS;
+    int n = 0;
+
+    // 先记下版本号，重建期间配置又有变更时下次请求会再次重建
+    index_generation = modbus_config_generation;
+    index_valid = true;
+    memset(unit_index, 0, sizeof(unit_index));
+
+    for (int g = 0; g < count; g++) {
+        const poll_group_config_t *cfg = &modbus_config.groups[g];
+        if (!cfg->enabled || cfg->reg_count == 0 || cfg->slave_addr < 1 || cfg->slave_addr > 247 ||
+            cfg->function_code < AGILE_MODBUS_FC_READ_COILS ||
+            cfg->function_code > AGILE_MODBUS_FC_READ_INPUT_REGISTERS) {
+            continue;
+        }
+
+        unit_entry_t *unit = &unit_index[cfg->slave_addr];
+        if (unit->uart_port == 0) {
+            unit->uart_port = cfg->uart_port;
+        } else if (unit->uart_port != cfg->uart_port) {
+            ESP_LOGW(TAG, "从站地址 %d 同时出现在串口%d和串口%d上，单元号 %d 只对应串口%d，忽略组 %d",
+                     cfg->slave_addr, unit->uart_port, cfg->uart_port, cfg->slave_addr, unit->uart_port, g);
+            continue;
+        }
+
+        // 组数很少，直接插入排序
+        uint32_t key = group_key(g);
+        int k = n++;
+        while (k > 0 && group_key(unit_groups[k - 1]) > key) {
+            unit_groups[k] = unit_groups[k - 1];
+            k--;
+        }
+        unit_groups[k] = g;
+    }
+
+    int units = 0;
+    for (int k = 0; k < n; k++) {
+        const poll_group_config_t *cfg = &modbus_config.groups[unit_groups[k]];
+        unit_span_t *span = &unit_index[cfg->slave_addr].span[cfg->function_code - 1];
+        if (span->count == 0) {
+            span->first = k;
+        }
+        span->count++;
+        if (k == 0 || modbus_config.groups[unit_groups[k - 1]].slave_addr != cfg->slave_addr) {
+            units++;
+        }
+    }
+    ESP_LOGI(TAG, "单元号索引已重建：%d 个单元号，%d 个轮询组", units, n);
+}
+
+// 从单元号的轮询组中读取 [address, address + nb) 写入响应数据区 out，可跨越多个相连的组，
+// 组之间有重叠时取起始地址小的组。有地址不在任何组内时返回非法数据地址，
+// 涉及的组数据未就绪(尚未采集或最近一次读取失败)时返回网关目标设备无响应
+static int unit_read(const unit_span_t *span, int function, int address, int nb, uint8_t *out)
+{
+    static uint16_t regs[MAX_REGS];
+    static uint8_t bits[MAX_BIT_BYTES + 1];
+    bool is_bits = function <= AGILE_MODBUS_FC_READ_DISCRETE_INPUTS;
+    int pos = address;
+    int end = address + nb;
+
+    for (int k = span->first; k < span->first + span->count && pos < end; k++) {
+        int g = unit_groups[k];
+        int start = modbus_config.groups[g].start_addr;
+        int group_end = start + modbus_config.groups[g].reg_count;
+        if (group_end <= pos) {
+            continue;
+        }
+        if (start > pos) {
+            break;
+        }
+
+        int index = pos - start;
+        int n = (group_end < end ? group_end : end) - pos;
+        if (is_bits) {
+            // 取出覆盖 [index, index + n) 的打包字节，再按位拼接到响应中
+            int bytes = (index % 8 + n + 7) / 8;
+            if (!modbus_data_read(g, function, index / 8, bits, bytes)) {
+                return -AGILE_MODBUS_EXCEPTION_GATEWAY_TARGET;
+            }
+            agile_modbus_copy_bits(out, pos - address, bits, index % 8, n);
+        } else {
+            if (!modbus_data_read(g, function, index * sizeof(uint16_t), regs, n * sizeof(uint16_t))) {
+                return -AGILE_MODBUS_EXCEPTION_GATEWAY_TARGET;
+            }
+            for (int j = 0; j < n; j++) {
+                agile_modbus_slave_register_set(out, pos - address + j, regs[j]);
+            }
+        }
+        pos += n;
+    }
+    return pos < end ? -AGILE_MODBUS_EXCEPTION_ILLEGAL_DATA_ADDRESS : 0;
+}
+
+// 把写请求转发给单元号对应的设备，每个请求对应一条RTU写命令，响应在写命令完成后生成
+static int unit_write(uint8_t uart_port, uint8_t unit, struct agile_modbus_slave_info *slave_info)
+{
+    static write_req_t req;
+    int function = slave_info->sft->function;
+
+    req.uart_port = uart_port;
+    req.slave_addr = unit;
+    req.function_code = function;
+    req.addr = slave_info->address;
+
+    switch (function) {
+    case AGILE_MODBUS_FC_WRITE_SINGLE_COIL:
+        req.count = 1;
+        req.bits[0] = *(int *)slave_info->buf != 0;
+        break;
+
+    case AGILE_MODBUS_FC_WRITE_SINGLE_REGISTER:
+        req.count = 1;
+        req.regs[0] = *(int *)slave_info->buf;
+        break;
+
+    case AGILE_MODBUS_FC_WRITE_MULTIPLE_REGISTERS:
+        if (slave_info->nb > WRITE_MAX_REGS) {
+            return -AGILE_MODBUS_EXCEPTION_ILLEGAL_DATA_VALUE;
+        }
+        req.count = slave_info->nb;
+        for (int j = 0; j < slave_info->nb; j++) {
+            req.regs[j] = agile_modbus_slave_register_get(slave_info->buf, j);
+        }
+        break;
+
+    case AGILE_MODBUS_FC_WRITE_MULTIPLE_COILS:
+        req.count = slave_info->nb;
+        agile_modbus_copy_packed_bits(req.bits, slave_info->buf, 0, slave_info->nb);
+        break;
+
+    default:
+        return -AGILE_MODBUS_EXCEPTION_ILLEGAL_FUNCTION;
+    }
+    tcp_server_forward_write(&req);
+    return 0;
+}
+
+int tcp_unit_callback(agile_modbus_t *ctx, struct agile_modbus_slave_info *slave_info, const void *data)
+{
+    int function = slave_info->sft->function;
+    int unit = slave_info->sft->slave;
+
+    (void)data;
+    if (!index_valid || index_generation != modbus_config_generation) {
+        tcp_unit_index_rebuild();
+    }
+    if (unit < 0 || unit >= UNIT_COUNT || unit_index[unit].uart_port == 0) {
+        return -AGILE_MODBUS_EXCEPTION_GATEWAY_PATH;
+    }
+
+    const unit_entry_t *entry = &unit_index[unit];
+    switch (function) {
+    case AGILE_MODBUS_FC_READ_COILS:
+    case AGILE_MODBUS_FC_READ_DISCRETE_INPUTS:
+    case AGILE_MODBUS_FC_READ_HOLDING_REGISTERS:
+    case AGILE_MODBUS_FC_READ_INPUT_REGISTERS:
+        return unit_read(&entry->span[function - 1], function, slave_info->address, slave_info->nb,
+                         ctx->send_buf + slave_info->send_index);
+
+    case AGILE_MODBUS_FC_WRITE_SINGLE_COIL:
+    case AGILE_MODBUS_FC_WRITE_SINGLE_REGISTER:
+    case AGILE_MODBUS_FC_WRITE_MULTIPLE_COILS:
+    case AGILE_MODBUS_FC_WRITE_MULTIPLE_REGISTERS:
+        return unit_write(entry->uart_port, unit, slave_info);
+
+    default:
+        return -AGILE_MODBUS_EXCEPTION_ILLEGAL_FUNCTION;
+    }
+}
@@ -0,0 +1,18 @@
+#ifndef TCP_UNIT_H
+#define TCP_UNIT_H
+
+#include "agile_modbus.h"
+
+// TCP从站多单元号模式(tcp_slave.unit_mode)：轮询配置中的每个从站地址作为一个MBAP单元号，
+// 客户端按单元号直接访问各个现场设备。读请求(功能码01~04)直接从该设备各轮询组的采集数据中取值，
+// 不经过映射和从站表；写请求(功能码05/06/15/16)转发给该设备所在串口。
+// 单元号到轮询组的索引在配置变更后首次处理请求时重建，查找为直接下标
+
+// 按当前轮询配置重建单元号索引；同一从站地址出现在多个串口上时只保留最先配置的串口
+void tcp_unit_index_rebuild(void);
+
+// agile_modbus_slave_handle 的从机回调，只在TCP服务器任务中调用。
+// 未知单元号返回网关路径不可用，组数据未就绪返回网关目标设备无响应
+int tcp_unit_callback(agile_modbus_t *ctx, struct agile_modbus_slave_info *slave_info, const void *data);
+
+#endif
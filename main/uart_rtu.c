@@ -1,4 +1,6 @@
 #include <stdio.h>
+#include <stdbool.h>
+#include <inttypes.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "freertos/queue.h"
@@ -6,6 +8,7 @@
 #include "driver/uart.h"
 #include "driver/gpio.h"
 #include "esp_log.h"
+#include "esp_timer.h"
 #include "uart_rtu.h"
 #include "nvs_flash.h"
 #include "nvs.h"
@@ -15,362 +18,301 @@
 // 定义缓冲区大小，使用串口缓冲区的默认大小
 #define BUF_SIZE UART_BUFFER_SIZE
 
-// 定义固定的串口引脚
-#define UART0_TX_PIN 6
-#define UART0_RX_PIN 7
-#define UART1_TX_PIN 17
-#define UART1_RX_PIN 18
-#define UART2_TX_PIN 15
-#define UART2_RX_PIN 16
+// 硬件接收超时(字符时间)：帧尾数据尽快送到接收任务，帧结束由解析器或软件t3.5判断
+#define RX_TOUT_SYMBOLS 2
+// RX FIFO满阈值(字节)：连续接收时每收满这么多字节送一次环形缓冲区
+#define RX_FULL_THRESH 64
 
-// 定义3个串口的参数数组
-uart_param_t uart_params[3] = {
+// 串口参数数组，下标为物理UART编号，引脚默认值与原硬件设计一致
+uart_param_t uart_params[UART_PORT_COUNT] = {
     {
         .baud_rate = BAUD_115200,
         .data_bits = DATA_BITS_8,
         .parity = PARITY_NONE,
-        .stop_bits = STOP_BITS_1
+        .stop_bits = STOP_BITS_1,
+        .tx_pin = 6,
+        .rx_pin = 7,
+        .de_pin = UART_PIN_NO_CHANGE,
+        .rs485 = false
     },
     {
         .baud_rate = BAUD_115200,
         .data_bits = DATA_BITS_8,
         .parity = PARITY_NONE,
-        .stop_bits = STOP_BITS_1
+        .stop_bits = STOP_BITS_1,
+        .tx_pin = 17,
+        .rx_pin = 18,
+        .de_pin = UART_PIN_NO_CHANGE,
+        .rs485 = false
     },
     {
         .baud_rate = BAUD_115200,
         .data_bits = DATA_BITS_8,
         .parity = PARITY_NONE,
-        .stop_bits = STOP_BITS_1
+        .stop_bits = STOP_BITS_1,
+        .tx_pin = 15,
+        .rx_pin = 16,
+        .de_pin = UART_PIN_NO_CHANGE,
+        .rs485 = false
     }
 };
 
-// 声明UART0、UART1和UART2的事件队列句柄
-static QueueHandle_t uart0_queue;
-static QueueHandle_t uart1_queue;
-static QueueHandle_t uart2_queue;
-// 声明用于接收数据同步的信号量句柄
-static SemaphoreHandle_t rx0_sem;
-static SemaphoreHandle_t rx1_sem;
-static SemaphoreHandle_t rx2_sem;
-
-//UART0发送数据
-int send_data0(uint8_t *buf, int len) {
-    return uart_write_bytes(UART_NUM_0, (const char*)buf, len);
-}
+// ESP32 UART 驱动的串口对象
+typedef struct {
+    rtu_port_t base;
+    uart_port_t uart_num;
+    QueueHandle_t queue;            // UART事件队列
+    SemaphoreHandle_t rx_sem;       // 数据到达通知
+    rtu_timing_t timing;            // 帧时序参数，在uart_init时根据串口参数计算
+    volatile bool rx_idle;          // 硬件接收超时(RX_TOUT_SYMBOLS 个字符空闲)标志，由事件任务更新
+    volatile int64_t rx_idle_us;    // 硬件接收超时时间戳
+    int64_t tx_start_us;            // 最近一次请求开始发送的时间戳
+    int64_t rx_frame_us;            // 最近一次响应最后一个字符的时间戳
+    rtu_port_stats_t stats;
+} uart_port_drv_t;
 
-//UART1发送数据
-int send_data1(uint8_t *buf, int len) {
-    return uart_write_bytes(UART_NUM_1, (const char*)buf, len);
-}
+static uart_port_drv_t uart_ports[UART_PORT_COUNT];
 
-//UART2发送数据
-int send_data2(uint8_t *buf, int len) {
-    return uart_write_bytes(UART_NUM_2, (const char*)buf, len);
-}
+static const char *uart_port_names[UART_PORT_COUNT] = {"UART0", "UART1", "UART2"};
 
-// 根据波特率获取字节超时时间（毫秒）
-static int get_byte_timeout_by_baudrate(uart_rtu_baud_rate_t baud_rate) {
-    switch (baud_rate) {
-        case BAUD_9600:
-            return 5;
-        case BAUD_19200:
-            return 3;
-        case BAUD_38400:
-            return 2;
-        case BAUD_57600:
-            return 2;
-        case BAUD_115200:
-            return 2;
-        default:
-            return 5;
-    }
+// 发送一帧数据
+static int uart_port_send(rtu_port_t *port, const uint8_t *buf, int len) {
+    uart_port_drv_t *drv = (uart_port_drv_t *)port;
+
+    drv->tx_start_us = esp_timer_get_time();
+    drv->stats.tx_frames++;
+    return uart_write_bytes(drv->uart_num, (const char *)buf, len);
 }
 
-//UART0接收数据
-int receive_data0(uint8_t *buf, int bufsz, int timeout) {
+// 接收一帧数据：解析出完整帧、检测到t3.5空闲或超时后返回。
+// 硬件接收超时设为 RX_TOUT_SYMBOLS 个字符，帧尾不足FIFO阈值的字节在最后一个字节后约两个字符时间
+// 就送到环形缓冲区，解析器据此在帧尾立即结束接收；t3.5只在无法解析时用于判断帧结束。
+// 数据按FIFO满阈值成块送达时两块之间可能超过t3.5，只有硬件超时确认总线已空闲后才按t3.5判断
+static int uart_port_receive(rtu_port_t *port, uint8_t *buf, int bufsz, int timeout, agile_modbus_parser_t *parser) {
+    uart_port_drv_t *drv = (uart_port_drv_t *)port;
+    const rtu_timing_t *timing = &drv->timing;
     int len = 0;
     int rc;
-    TickType_t start = xTaskGetTickCount();
-    TickType_t last_byte_time = start;
-    int t35_timeout = get_byte_timeout_by_baudrate(uart_params[1].baud_rate);
-    
+    int64_t start = esp_timer_get_time();
+    int64_t deadline = start + (int64_t)timeout * 1000;
+    int64_t last_byte_us = start;
+    // 最近一块数据由硬件接收超时送来，即最后一个字节之后总线已空闲
+    bool line_idle = false;
+    // 总线仍在接收时，下一块数据最迟在一个FIFO阈值加硬件超时的时间后到达
+    int64_t busy_us = rtu_timing_bytes_us(timing, RX_FULL_THRESH + RX_TOUT_SYMBOLS) + timing->t35_us;
+    // 没有解析器或解析出错后只能依靠帧间隔判断帧结束
+    int status = parser ? AGILE_MODBUS_PARSE_NEED_MORE : AGILE_MODBUS_PARSE_ERROR;
+
+    drv->rx_idle = false;
+    if (parser) {
+        agile_modbus_parser_reset(parser);
+    }
+
     while (1) {
-        int elapsed_time = (xTaskGetTickCount() - start) * portTICK_PERIOD_MS;
-        if (elapsed_time >= timeout) {
+        int64_t now = esp_timer_get_time();
+        if (now >= deadline) {
             break;
         }
-        
-        int remaining_timeout = timeout - elapsed_time;
-        
-        if (xSemaphoreTake(rx0_sem, pdMS_TO_TICKS(MIN(remaining_timeout, 50))) == pdTRUE) {
-            size_t available_bytes;
-            uart_get_buffered_data_len(UART_NUM_0, &available_bytes);
-            
-            if (available_bytes > 0) {
-                rc = uart_read_bytes(UART_NUM_0, buf + len, MIN(available_bytes, bufsz - len), pdMS_TO_TICKS(20));
-                
-                if (rc > 0) {
-                    len += rc;
-                    last_byte_time = xTaskGetTickCount();
-                    
-                    if (len >= bufsz) {
-                        break;
-                    }
-                }
-            }
-        } else {
-            if (len > 0) {
-                int idle_time = (xTaskGetTickCount() - last_byte_time) * portTICK_PERIOD_MS;
-                if (idle_time >= t35_timeout) {
-                    break;
-                }
-            }
+
+        // 已收到数据时最多等到判断帧结束的时刻；信号量等待以tick为单位，向上取整且至少一个tick
+        int64_t until = deadline;
+        int64_t frame_end = last_byte_us + (line_idle ? timing->t35_us : busy_us);
+        if (len > 0 && frame_end < until) {
+            until = frame_end;
         }
-        
-        if (len > 0) {
-            int idle_time = (xTaskGetTickCount() - last_byte_time) * portTICK_PERIOD_MS;
-            if (idle_time >= t35_timeout) {
-                break;
-            }
+        TickType_t wait = pdMS_TO_TICKS(MIN((until - now + 999) / 1000, 50));
+        if (wait == 0) {
+            wait = 1;
         }
-    }
-    return len;
-}
 
-// UART1接收数据
-int receive_data1(uint8_t *buf, int bufsz, int timeout) {
-    int len = 0;
-    int rc;
-    TickType_t start = xTaskGetTickCount();
-    TickType_t last_byte_time = start;
-    int t35_timeout = get_byte_timeout_by_baudrate(uart_params[1].baud_rate);
-    
-    while (1) {
-        // 计算已经过去的时间
-        int elapsed_time = (xTaskGetTickCount() - start) * portTICK_PERIOD_MS;
-        if (elapsed_time >= timeout) {
-            break;
-        }
-        
-        int remaining_timeout = timeout - elapsed_time;
-        
         // 等待数据到达
-        if (xSemaphoreTake(rx1_sem, pdMS_TO_TICKS(MIN(remaining_timeout, 50))) == pdTRUE) {
+        if (xSemaphoreTake(drv->rx_sem, wait) == pdTRUE) {
             // 检查有多少数据可用
             size_t available_bytes;
-            uart_get_buffered_data_len(UART_NUM_1, &available_bytes);
-            
+            uart_get_buffered_data_len(drv->uart_num, &available_bytes);
+
             if (available_bytes > 0) {
                 // 每次读取可用的数据，但不超过缓冲区剩余空间
-                rc = uart_read_bytes(UART_NUM_1, buf + len, MIN(available_bytes, bufsz - len), pdMS_TO_TICKS(20));
-                
+                rc = uart_read_bytes(drv->uart_num, buf + len, MIN(available_bytes, bufsz - len), pdMS_TO_TICKS(20));
+
                 if (rc > 0) {
-                    len += rc;
-                    last_byte_time = xTaskGetTickCount();
-                    
-                    if (len >= bufsz) {
-                        break; // 缓冲区已满
+                    // 边收边解析(含CRC)，在等待后续数据的间隙里完成，帧收齐时即可知道是否正确
+                    if (status == AGILE_MODBUS_PARSE_NEED_MORE) {
+                        status = agile_modbus_parser_feed(parser, buf + len, rc, NULL);
                     }
+                    len += rc;
+                    last_byte_us = esp_timer_get_time();
+                    line_idle = false;
                 }
             }
-        } else {
-            // 信号量等待超时，检查是否应该结束接收
-            if (len > 0) {
-                // 检查字符间隔时间
-                int idle_time = (xTaskGetTickCount() - last_byte_time) * portTICK_PERIOD_MS;
-                if (idle_time >= t35_timeout) {
-                    break; // 帧结束
-                }
-            }
-        }
-        
-        // 如果已经接收到数据，再次检查是否达到帧结束条件
-        if (len > 0) {
-            int idle_time = (xTaskGetTickCount() - last_byte_time) * portTICK_PERIOD_MS;
-            if (idle_time >= t35_timeout) {
-                break; // 帧结束
-            }
-        }
-    }
-    return len;
-}
 
-//UART2接收数据
-int receive_data2(uint8_t *buf, int bufsz, int timeout) {
-    int len = 0;
-    int rc;
-    TickType_t start = xTaskGetTickCount();
-    TickType_t last_byte_time = start;
-    int t35_timeout = get_byte_timeout_by_baudrate(uart_params[1].baud_rate);
-    
-    while (1) {
-        int elapsed_time = (xTaskGetTickCount() - start) * portTICK_PERIOD_MS;
-        if (elapsed_time >= timeout) {
-            break;
-        }
-        
-        int remaining_timeout = timeout - elapsed_time;
-        
-        if (xSemaphoreTake(rx2_sem, pdMS_TO_TICKS(MIN(remaining_timeout, 50))) == pdTRUE) {
-            size_t available_bytes;
-            uart_get_buffered_data_len(UART_NUM_2, &available_bytes);
-            
-            if (available_bytes > 0) {
-                rc = uart_read_bytes(UART_NUM_2, buf + len, MIN(available_bytes, bufsz - len), pdMS_TO_TICKS(20));
-                
-                if (rc > 0) {
-                    len += rc;
-                    last_byte_time = xTaskGetTickCount();
-                    
-                    if (len >= bufsz) {
-                        break;
-                    }
+            // 硬件超时事件且数据已读空：最后一个字节后总线已空闲，它在超时事件前 RX_TOUT_SYMBOLS 个字符。
+            // 事件可能在数据读走之后才处理，此时本次唤醒没有新数据
+            uart_get_buffered_data_len(drv->uart_num, &available_bytes);
+            if (len > 0 && drv->rx_idle && available_bytes == 0) {
+                int64_t idle_byte_us = drv->rx_idle_us - (int64_t)RX_TOUT_SYMBOLS * timing->char_us;
+                if (idle_byte_us > start && idle_byte_us < last_byte_us) {
+                    last_byte_us = idle_byte_us;
                 }
+                line_idle = true;
+                drv->rx_idle = false;
             }
-        } else {
-            if (len > 0) {
-                int idle_time = (xTaskGetTickCount() - last_byte_time) * portTICK_PERIOD_MS;
-                if (idle_time >= t35_timeout) {
-                    break;
-                }
+
+            if (len >= bufsz || status == AGILE_MODBUS_PARSE_COMPLETE) {
+                // 缓冲区已满，或已解析出完整帧，无需等待帧间隔
+                break;
             }
         }
-        
+
+        // 无法按长度判断时，总线空闲后达到t3.5即帧结束；没有收到硬件超时则等到下一块数据也不可能再来
         if (len > 0) {
-            int idle_time = (xTaskGetTickCount() - last_byte_time) * portTICK_PERIOD_MS;
-            if (idle_time >= t35_timeout) {
+            int64_t idle_us = esp_timer_get_time() - last_byte_us;
+            if (line_idle ? rtu_timing_frame_ended(timing, idle_us) : idle_us >= busy_us) {
                 break;
             }
         }
     }
+
+    if (len > 0) {
+        drv->rx_frame_us = last_byte_us;
+        drv->stats.rx_frames++;
+        drv->stats.rx_bytes += len;
+    } else {
+        drv->stats.rx_timeouts++;
+    }
     return len;
 }
 
+static bool uart_port_wait_tx_done(rtu_port_t *port, int timeout) {
+    uart_port_drv_t *drv = (uart_port_drv_t *)port;
 
-// UART0事件处理任务函数
-static void uart0_event_task(void *pvParameters) {
-    uart_event_t event;
-    size_t buffered_size;
-    
-    while (1) {
-        if (xQueueReceive(uart0_queue, (void *)&event, (TickType_t)portMAX_DELAY)) {
-            switch (event.type) {
-                case UART_DATA:
-                    // 获取当前缓冲区数据长度
-                    uart_get_buffered_data_len(UART_NUM_0, &buffered_size);
-                    // 通知接收任务
-                    xSemaphoreGive(rx0_sem);
-                    break;
-                
-                case UART_FIFO_OVF:
-                case UART_BUFFER_FULL:
-                    uart_flush_input(UART_NUM_0);
-                    xQueueReset(uart0_queue);
-                    break;
-                
-                default:
-                    break;
-            }
-        }
+    return uart_wait_tx_done(drv->uart_num, pdMS_TO_TICKS(timeout)) == ESP_OK;
+}
+
+static const rtu_timing_t *uart_port_timing(rtu_port_t *port) {
+    return &((uart_port_drv_t *)port)->timing;
+}
+
+static void uart_port_frame_times(rtu_port_t *port, int64_t *tx_us, int64_t *rx_us) {
+    uart_port_drv_t *drv = (uart_port_drv_t *)port;
+
+    if (tx_us) {
+        *tx_us = drv->tx_start_us;
+    }
+    if (rx_us) {
+        *rx_us = drv->rx_frame_us;
     }
 }
-// UART1事件处理任务函数
-static void uart1_event_task(void *pvParameters) {
-    uart_event_t event;
-    size_t buffered_size;
-    
-    while (1) {
-        if (xQueueReceive(uart1_queue, (void *)&event, (TickType_t)portMAX_DELAY)) {
-            switch (event.type) {
-                case UART_DATA:
-                    // 获取当前缓冲区数据长度
-                    uart_get_buffered_data_len(UART_NUM_1, &buffered_size);
-                    // 通知接收任务
-                    xSemaphoreGive(rx1_sem);
-                    break;
-                
-                case UART_FIFO_OVF:
-                case UART_BUFFER_FULL:
-                    uart_flush_input(UART_NUM_1);
-                    xQueueReset(uart1_queue);
-                    break;
-                
-                default:
-                    break;
-            }
-        }
+
+static void uart_port_stats(rtu_port_t *port, rtu_port_stats_t *stats) {
+    *stats = ((uart_port_drv_t *)port)->stats;
+}
+
+static const rtu_port_ops_t uart_port_ops = {
+    .send = uart_port_send,
+    .receive = uart_port_receive,
+    .wait_tx_done = uart_port_wait_tx_done,
+    .timing = uart_port_timing,
+    .frame_times = uart_port_frame_times,
+    .stats = uart_port_stats,
+};
+
+rtu_port_t *uart_rtu_port(int uart_num) {
+    if (uart_num < 0 || uart_num >= UART_PORT_COUNT) {
+        return NULL;
     }
+    return &uart_ports[uart_num].base;
 }
 
-static void uart2_event_task(void *pvParameters) {
+// UART事件处理任务函数，每个串口一个
+static void uart_event_task(void *pvParameters) {
+    uart_port_drv_t *drv = (uart_port_drv_t *)pvParameters;
     uart_event_t event;
-    size_t buffered_size;
-    
+
     while (1) {
-        if (xQueueReceive(uart2_queue, (void *)&event, (TickType_t)portMAX_DELAY)) {
+        if (xQueueReceive(drv->queue, (void *)&event, (TickType_t)portMAX_DELAY)) {
             switch (event.type) {
                 case UART_DATA:
-                    // 获取当前缓冲区数据长度
-                    uart_get_buffered_data_len(UART_NUM_2, &buffered_size);
+                    // 硬件检测到总线短暂空闲，记录时间用于推算最后一个字节的时间
+                    if (event.timeout_flag) {
+                        drv->rx_idle_us = esp_timer_get_time();
+                        drv->rx_idle = true;
+                    }
                     // 通知接收任务
-                    xSemaphoreGive(rx2_sem);
+                    xSemaphoreGive(drv->rx_sem);
                     break;
-                
+
                 case UART_FIFO_OVF:
                 case UART_BUFFER_FULL:
-                    uart_flush_input(UART_NUM_2);
-                    xQueueReset(uart2_queue);
+                    drv->stats.rx_overflows++;
+                    uart_flush_input(drv->uart_num);
+                    xQueueReset(drv->queue);
                     break;
-                
+
                 default:
                     break;
             }
         }
     }
 }
-//初始化UART0、UART1和UART2
+
+// 初始化所有串口
 int uart_init(void) {
     // UART基本配置
-    uart_config_t uart_config;
-    
-    // 初始化3个UART
-    for(int i = 0; i < 3; i++) {
-        uart_config.baud_rate = uart_params[i].baud_rate;
-        uart_config.data_bits = uart_params[i].data_bits;
-        uart_config.parity = uart_params[i].parity;
-        uart_config.stop_bits = uart_params[i].stop_bits;
+    uart_config_t uart_config = {0};
+
+    for (int i = 0; i < UART_PORT_COUNT; i++) {
+        const uart_param_t *param = &uart_params[i];
+        uart_port_drv_t *drv = &uart_ports[i];
+
+        drv->base.ops = &uart_port_ops;
+        drv->base.name = uart_port_names[i];
+        drv->uart_num = i;
+
+        uart_config.baud_rate = param->baud_rate;
+        uart_config.data_bits = param->data_bits;
+        uart_config.parity = param->parity;
+        uart_config.stop_bits = param->stop_bits;
         uart_config.flow_ctrl = UART_HW_FLOWCTRL_DISABLE;
         uart_config.rx_flow_ctrl_thresh = 122;
         uart_config.source_clk = UART_SCLK_APB;
-        
+
         ESP_ERROR_CHECK(uart_param_config(i, &uart_config));
-        
-        // 根据UART端口号设置对应的固定引脚
-        if (i == 0) {
-            ESP_ERROR_CHECK(uart_set_pin(i, UART0_TX_PIN, UART0_RX_PIN, UART_PIN_NO_CHANGE, UART_PIN_NO_CHANGE));
-        } else if (i == 1) {
-            ESP_ERROR_CHECK(uart_set_pin(i, UART1_TX_PIN, UART1_RX_PIN, UART_PIN_NO_CHANGE, UART_PIN_NO_CHANGE));
-        } else {
-            ESP_ERROR_CHECK(uart_set_pin(i, UART2_TX_PIN, UART2_RX_PIN, UART_PIN_NO_CHANGE, UART_PIN_NO_CHANGE));
+
+        // RS485模式下RTS引脚作为收发方向控制(DE)
+        ESP_ERROR_CHECK(uart_set_pin(i, param->tx_pin, param->rx_pin,
+                                     param->rs485 ? param->de_pin : UART_PIN_NO_CHANGE,
+                                     UART_PIN_NO_CHANGE));
+
+        ESP_ERROR_CHECK(uart_driver_install(i, BUF_SIZE * 2, BUF_SIZE * 2, 20, &drv->queue, ESP_INTR_FLAG_IRAM));
+
+        if (param->rs485) {
+            ESP_ERROR_CHECK(uart_set_mode(i, UART_MODE_RS485_HALF_DUPLEX));
         }
-        
-        ESP_ERROR_CHECK(uart_driver_install(i, BUF_SIZE * 2, BUF_SIZE * 2, 20, i == 0 ? &uart0_queue : (i == 1 ? &uart1_queue : &uart2_queue), ESP_INTR_FLAG_IRAM));
-        uart_set_rx_timeout(i, 3);
+
+        // 按波特率计算t1.5/t3.5。硬件接收超时取两个字符，不等t3.5：
+        // 不足FIFO满阈值的帧尾只能靠超时送出，超时设为t3.5时解析器总要等到帧间隔才拿到帧尾
+        rtu_timing_init(&drv->timing, param->baud_rate, 5 + param->data_bits,
+                        param->parity != PARITY_NONE,
+                        param->stop_bits == STOP_BITS_2 ? 4 : (param->stop_bits == STOP_BITS_1_5 ? 3 : 2));
+        ESP_ERROR_CHECK(uart_set_rx_timeout(i, RX_TOUT_SYMBOLS));
+        ESP_ERROR_CHECK(uart_set_rx_full_threshold(i, RX_FULL_THRESH));
+        ESP_LOGI("UART", "UART%d TX:%d RX:%d%s 字符时间 %" PRIu32 " us, t1.5 %" PRIu32 " us, t3.5 %" PRIu32 " us (%d 字符), 硬件超时 %d 字符",
+                 i, param->tx_pin, param->rx_pin, param->rs485 ? " RS485" : "",
+                 drv->timing.char_us, drv->timing.t15_us, drv->timing.t35_us,
+                 drv->timing.rx_timeout_symbols, RX_TOUT_SYMBOLS);
+
+        drv->rx_sem = xSemaphoreCreateBinary();
+        if (drv->rx_sem == NULL) {
+            ESP_LOGE("UART", "Failed to create rx semaphores");
+            return -1;
         }
-    
-    rx0_sem = xSemaphoreCreateBinary();
-    rx1_sem = xSemaphoreCreateBinary();
-    rx2_sem = xSemaphoreCreateBinary();
-    if (rx0_sem == NULL || rx1_sem == NULL || rx2_sem == NULL) {
-        ESP_LOGE("UART", "Failed to create rx semaphores");
-        return -1;
+
+        char task_name[20];
+        snprintf(task_name, sizeof(task_name), "uart%d_event_task", i);
+        xTaskCreate(uart_event_task, task_name, 2048, drv, 12, NULL);
     }
-    
-    xTaskCreate(uart0_event_task, "uart0_event_task", 2048, NULL, 12, NULL);
-    xTaskCreate(uart1_event_task, "uart1_event_task", 2048, NULL, 12, NULL);
-    xTaskCreate(uart2_event_task, "uart2_event_task", 2048, NULL, 12, NULL);
-    
+
     return ESP_OK;
 }
 
@@ -387,7 +329,7 @@ esp_err_t load_uart_params_from_nvs(void) {
     }
 
     // 为每个UART端口分别读取参数
-    for(int i = 0; i < 3; i++) {
+    for(int i = 0; i < UART_PORT_COUNT; i++) {
         char key[16];
         uint32_t value;
         
@@ -418,6 +360,26 @@ esp_err_t load_uart_params_from_nvs(void) {
         if (err == ESP_OK) {
             uart_params[i].stop_bits = (uart_rtu_stop_bits_t)value;
         }
+
+        // 读取引脚和RS485配置
+        int8_t pin;
+        uint8_t flag;
+        snprintf(key, sizeof(key), "tx_pin_%d", i);
+        if (nvs_get_i8(nvs_handle, key, &pin) == ESP_OK) {
+            uart_params[i].tx_pin = pin;
+        }
+        snprintf(key, sizeof(key), "rx_pin_%d", i);
+        if (nvs_get_i8(nvs_handle, key, &pin) == ESP_OK) {
+            uart_params[i].rx_pin = pin;
+        }
+        snprintf(key, sizeof(key), "de_pin_%d", i);
+        if (nvs_get_i8(nvs_handle, key, &pin) == ESP_OK) {
+            uart_params[i].de_pin = pin;
+        }
+        snprintf(key, sizeof(key), "rs485_%d", i);
+        if (nvs_get_u8(nvs_handle, key, &flag) == ESP_OK) {
+            uart_params[i].rs485 = flag;
+        }
     }
 
     // 关闭NVS句柄
@@ -438,7 +400,7 @@ esp_err_t save_uart_params_to_nvs(void) {
     }
 
     // 为每个UART端口分别保存参数
-    for(int i = 0; i < 3; i++) {
+    for(int i = 0; i < UART_PORT_COUNT; i++) {
         char key[16];
         
         // 保存波特率
@@ -460,6 +422,23 @@ esp_err_t save_uart_params_to_nvs(void) {
         snprintf(key, sizeof(key), "stop_bits_%d", i);
         err = nvs_set_u32(nvs_handle, key, (uint32_t)uart_params[i].stop_bits);
         if (err != ESP_OK) continue;
+
+        // 保存引脚和RS485配置
+        snprintf(key, sizeof(key), "tx_pin_%d", i);
+        err = nvs_set_i8(nvs_handle, key, uart_params[i].tx_pin);
+        if (err != ESP_OK) continue;
+
+        snprintf(key, sizeof(key), "rx_pin_%d", i);
+        err = nvs_set_i8(nvs_handle, key, uart_params[i].rx_pin);
+        if (err != ESP_OK) continue;
+
+        snprintf(key, sizeof(key), "de_pin_%d", i);
+        err = nvs_set_i8(nvs_handle, key, uart_params[i].de_pin);
+        if (err != ESP_OK) continue;
+
+        snprintf(key, sizeof(key), "rs485_%d", i);
+        err = nvs_set_u8(nvs_handle, key, uart_params[i].rs485);
+        if (err != ESP_OK) continue;
     }
 
     // 提交更改
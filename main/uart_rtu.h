@@ -2,8 +2,10 @@
 #define __uart_rtu_H
 
 #include "driver/uart.h"
+#include "rtu_port.h"
 
 #define UART_BUFFER_SIZE    256 //定义串口缓冲区大小
+#define UART_PORT_COUNT     3   //物理串口数量
 
 // 波特率枚举
 typedef enum {
@@ -42,18 +44,19 @@ typedef struct {
     uart_rtu_data_bits_t data_bits;
     uart_rtu_parity_t parity;
     uart_rtu_stop_bits_t stop_bits;
+    int8_t tx_pin;
+    int8_t rx_pin;
+    int8_t de_pin;      // RS485收发方向控制引脚(RTS)，-1表示不使用
+    bool rs485;         // 是否使用硬件RS485半双工模式
 } uart_param_t;
 
-extern uart_param_t uart_params[3];
+extern uart_param_t uart_params[UART_PORT_COUNT];
 
-int send_data0(uint8_t *buf, int len);
-int send_data1(uint8_t *buf, int len);
-int send_data2(uint8_t *buf, int len);
-int receive_data0(uint8_t *buf, int bufsz, int timeout);
-int receive_data1(uint8_t *buf, int bufsz, int timeout);
-int receive_data2(uint8_t *buf, int bufsz, int timeout);
 int uart_init(void);
 
+// 获取物理UART对应的串口对象(uart_init后有效)，编号无效时返回NULL
+rtu_port_t *uart_rtu_port(int uart_num);
+
 // 从NVS中读取UART参数
 esp_err_t load_uart_params_from_nvs(void);
 // 保存UART参数到NVS
@@ -4,8 +4,12 @@
 #include "esp_log.h"
 #include "simple_wifi_sta.h"
 #include "mqtt.h"
+#include "mqtt_payload.h"
 #include "tcp_slave_regs.h"
+#include "tcp_server.h"
 #include "uart_rtu.h"
+#include "write_queue.h"
+#include "driver/gpio.h"
 
 // 日志标签
 static const char *TAG = "web_server";
@@ -44,6 +48,9 @@ esp_err_t get_modbus_config_handler(httpd_req_t *req)
 {
     cJSON *root = cJSON_CreateObject();
     cJSON_AddNumberToObject(root, "poll_interval", modbus_config.poll_interval);
+    cJSON_AddBoolToObject(root, "coalesce", modbus_config.coalesce);
+    cJSON_AddNumberToObject(root, "coalesce_gap", modbus_config.coalesce_gap);
+    cJSON_AddNumberToObject(root, "broadcast_delay_ms", modbus_config.broadcast_delay_ms);
     cJSON_AddNumberToObject(root, "group_count", modbus_config.group_count);
 
     cJSON *groups = cJSON_CreateArray();
@@ -56,6 +63,8 @@ esp_err_t get_modbus_config_handler(httpd_req_t *req)
         cJSON_AddNumberToObject(group, "start_addr", modbus_config.groups[i].start_addr);
         cJSON_AddNumberToObject(group, "reg_count", modbus_config.groups[i].reg_count);
         cJSON_AddNumberToObject(group, "uart_port", modbus_config.groups[i].uart_port);
+        cJSON_AddNumberToObject(group, "poll_period", modbus_config.groups[i].poll_period);
+        cJSON_AddNumberToObject(group, "priority", modbus_config.groups[i].priority);
         cJSON_AddItemToArray(groups, group);
     }
 
@@ -91,95 +100,11 @@ esp_err_t update_modbus_config_handler(httpd_req_t *req)
         return ESP_FAIL;
     }
 
-    cJSON *poll_interval = cJSON_GetObjectItem(root, "poll_interval");
-    cJSON *groups = cJSON_GetObjectItem(root, "groups");
-
-    if (poll_interval)
-        modbus_config.poll_interval = poll_interval->valueint;
-
-    if (groups && cJSON_IsArray(groups))
-    {
-        int array_size = cJSON_GetArraySize(groups);
-        // 直接使用数组大小作为group_count
-        modbus_config.group_count = array_size;
-        if (modbus_config.group_count > MAX_POLL_GROUPS)
-        {
-            modbus_config.group_count = MAX_POLL_GROUPS;
-        }
-
-        for (int i = 0; i < modbus_config.group_count; i++)
-        {
-            cJSON *group = cJSON_GetArrayItem(groups, i);
-            cJSON *enabled = cJSON_GetObjectItem(group, "enabled");
-            cJSON *slave_addr = cJSON_GetObjectItem(group, "slave_addr");
-            cJSON *function_code = cJSON_GetObjectItem(group, "function_code");
-            cJSON *start_addr = cJSON_GetObjectItem(group, "start_addr");
-            cJSON *reg_count = cJSON_GetObjectItem(group, "reg_count");
-            cJSON *uart_port = cJSON_GetObjectItem(group, "uart_port");
-
-            if (enabled)
-                modbus_config.groups[i].enabled = enabled->valueint;
-            if (slave_addr)
-            {
-                int addr = slave_addr->valueint;
-                if (addr >= 1 && addr <= 247)
-                {
-                    modbus_config.groups[i].slave_addr = addr;
-                }
-            }
-            if (function_code)
-            {
-                int fc = 0;
-                if (cJSON_IsNumber(function_code))
-                {
-                    fc = function_code->valueint;
-                }
-                else if (cJSON_IsString(function_code))
-                {
-                    fc = atoi(function_code->valuestring);
-                }
-
-                if (fc >= 1 && fc <= 4)
-                {
-                    modbus_config.groups[i].function_code = fc;
-                }
-            }
-            if (start_addr)
-            {
-                // 处理空字符串的情况
-                if (cJSON_IsString(start_addr) && strlen(start_addr->valuestring) == 0)
-                {
-                    modbus_config.groups[i].start_addr = 0;
-                }
-                else if (cJSON_IsNumber(start_addr))
-                {
-                    modbus_config.groups[i].start_addr = start_addr->valueint;
-                }
-                else if (cJSON_IsString(start_addr))
-                {
-                    modbus_config.groups[i].start_addr = atoi(start_addr->valuestring);
-                }
-            }
-            if (reg_count)
-            {
-                modbus_config.groups[i].reg_count = reg_count->valueint;
-                if (modbus_config.groups[i].reg_count > MAX_REGS)
-                {
-                    modbus_config.groups[i].reg_count = MAX_REGS;
-                }
-            }
-            if (uart_port)
-            {
-                int port = uart_port->valueint;
-                if (port == 1 || port == 2 || port == 3)
-                {
-                    modbus_config.groups[i].uart_port = port;
-                }
-            }
-        }
-    }
+    modbus_config_from_json(root);
 
     cJSON_Delete(root);
+    // 通知轮询任务重建调度表
+    modbus_config_changed();
     // 在发送响应之前保存配置
     esp_err_t save_err = save_modbus_config_to_nvs();
     if (save_err != ESP_OK)
@@ -215,6 +140,7 @@ esp_err_t get_mqtt_config_handler(httpd_req_t *req)
     cJSON_AddItemToObject(root, "parse_methods", parse_methods);
 
     cJSON_AddNumberToObject(root, "publish_interval", current_config.publish_interval);
+    cJSON_AddBoolToObject(root, "publish_on_change", current_config.publish_on_change);
     cJSON_AddBoolToObject(root, "connected", mqtt_is_connected());
 
     char *json_str = cJSON_Print(root);
@@ -251,64 +177,7 @@ esp_err_t update_mqtt_config_handler(httpd_req_t *req)
     mqtt_get_config(&new_config); // 获取当前配置作为基础
 
     // 解析新的配置
-    cJSON *enabled = cJSON_GetObjectItem(root, "enabled");
-    cJSON *broker_url = cJSON_GetObjectItem(root, "broker_url");
-    cJSON *username = cJSON_GetObjectItem(root, "username");
-    cJSON *password = cJSON_GetObjectItem(root, "password");
-    cJSON *topic = cJSON_GetObjectItem(root, "topic");
-    cJSON *group_ids = cJSON_GetObjectItem(root, "group_ids");
-    cJSON *parse_methods = cJSON_GetObjectItem(root, "parse_methods");
-    cJSON *publish_interval = cJSON_GetObjectItem(root, "publish_interval");
-
-    if (enabled)
-        new_config.enabled = enabled->valueint;
-    if (broker_url && cJSON_IsString(broker_url))
-    {
-        strncpy(new_config.broker_url, broker_url->valuestring, sizeof(new_config.broker_url) - 1);
-    }
-    if (username && cJSON_IsString(username))
-    {
-        strncpy(new_config.username, username->valuestring, sizeof(new_config.username) - 1);
-    }
-    if (password && cJSON_IsString(password))
-    {
-        strncpy(new_config.password, password->valuestring, sizeof(new_config.password) - 1);
-    }
-    if (topic && cJSON_IsString(topic))
-    {
-        strncpy(new_config.topic, topic->valuestring, sizeof(new_config.topic) - 1);
-    }
-
-    // 处理组ID和解析方式数组
-    if (group_ids && cJSON_IsArray(group_ids) && parse_methods && cJSON_IsArray(parse_methods))
-    {
-        int count = cJSON_GetArraySize(group_ids);
-        int parse_count = cJSON_GetArraySize(parse_methods);
-
-        // 使用较小的数组大小作为实际数量
-        count = (count < parse_count) ? count : parse_count;
-        if (count > MAX_POLL_GROUPS)
-            count = MAX_POLL_GROUPS;
-        new_config.group_count = count;
-
-        for (int i = 0; i < count; i++)
-        {
-            cJSON *group_id = cJSON_GetArrayItem(group_ids, i);
-            cJSON *parse_method = cJSON_GetArrayItem(parse_methods, i);
-
-            if (group_id && cJSON_IsNumber(group_id))
-            {
-                new_config.group_ids[i] = group_id->valueint;
-            }
-            if (parse_method && cJSON_IsNumber(parse_method))
-            {
-                new_config.parse_methods[i] = parse_method->valueint;
-            }
-        }
-    }
-
-    if (publish_interval)
-        new_config.publish_interval = publish_interval->valueint;
+    mqtt_config_from_json(&new_config, root);
 
     // 更新MQTT配置
     esp_err_t err = mqtt_update_config(&new_config);
@@ -345,6 +214,9 @@ esp_err_t get_tcp_slave_config_handler(httpd_req_t *req)
     cJSON_AddBoolToObject(root, "enabled", tcp_slave.enabled);
     cJSON_AddNumberToObject(root, "server_port", tcp_slave.server_port);
     cJSON_AddNumberToObject(root, "slave_address", tcp_slave.slave_address);
+    cJSON_AddNumberToObject(root, "max_clients", tcp_slave.max_clients);
+    cJSON_AddNumberToObject(root, "max_clients_limit", TCP_SERVER_MAX_CLIENTS);
+    cJSON_AddBoolToObject(root, "unit_mode", tcp_slave.unit_mode);
 
     // 创建映射配置数组
     cJSON *maps = cJSON_CreateArray();
@@ -448,107 +320,10 @@ esp_err_t post_tcp_slave_config_handler(httpd_req_t *req)
         return ESP_FAIL;
     }
 
-    // 解析基础参数
-    cJSON *item = cJSON_GetObjectItem(root, "enabled");
-    if (item)
-    {
-        tcp_slave.enabled = item->valueint;
-    }
-
-    item = cJSON_GetObjectItem(root, "server_port");
-    if (item)
-    {
-        tcp_slave.server_port = item->valueint;
-    }
-
-    item = cJSON_GetObjectItem(root, "slave_address");
-    if (item)
-    {
-        tcp_slave.slave_address = item->valueint;
-    }
-
-    // 解析寄存器尺寸配置
-    cJSON *reg_sizes = cJSON_GetObjectItem(root, "reg_sizes");
-    if (reg_sizes)
-    {
-        item = cJSON_GetObjectItem(reg_sizes, "tab_bits_size");
-        if (item)
-        {
-            tcp_slave.reg_sizes.tab_bits_size = item->valueint;
-        }
-
-        item = cJSON_GetObjectItem(reg_sizes, "tab_input_bits_size");
-        if (item)
-        {
-            tcp_slave.reg_sizes.tab_input_bits_size = item->valueint;
-        }
-
-        item = cJSON_GetObjectItem(reg_sizes, "tab_registers_size");
-        if (item)
-        {
-            tcp_slave.reg_sizes.tab_registers_size = item->valueint;
-        }
-
-        item = cJSON_GetObjectItem(reg_sizes, "tab_input_registers_size");
-        if (item)
-        {
-            tcp_slave.reg_sizes.tab_input_registers_size = item->valueint;
-        }
-    }
-
-    // 先清空旧的映射配置
-    memset(&tcp_slave.maps, 0, sizeof(tcp_slave.maps));
-
-    // 解析映射配置
-    cJSON *maps = cJSON_GetObjectItem(root, "maps");
-    if (maps && cJSON_IsArray(maps))
-    {
-        int map_count = cJSON_GetArraySize(maps);
-        if (map_count > MAX_MAPS)
-        {
-            map_count = MAX_MAPS; // 限制最大映射数量
-        }
-
-        // 遍历并设置映射
-        for (int i = 0; i < map_count; i++)
-        {
-            cJSON *map = cJSON_GetArrayItem(maps, i);
-            if (!map)
-                continue;
-
-            item = cJSON_GetObjectItem(map, "type");
-            if (item)
-            {
-                tcp_slave.maps[i].type = item->valueint;
-            }
-
-            item = cJSON_GetObjectItem(map, "group_index");
-            if (item)
-            {
-                tcp_slave.maps[i].group_index = item->valueint;
-            }
-
-            item = cJSON_GetObjectItem(map, "master_start_addr");
-            if (item)
-            {
-                tcp_slave.maps[i].master_start_addr = item->valueint;
-            }
-
-            item = cJSON_GetObjectItem(map, "slave_start_addr");
-            if (item)
-            {
-                tcp_slave.maps[i].slave_start_addr = item->valueint;
-            }
-
-            item = cJSON_GetObjectItem(map, "count");
-            if (item)
-            {
-                tcp_slave.maps[i].count = item->valueint;
-            }
-        }
-    }
+    tcp_slave_config_from_json(&tcp_slave, root);
 
     // 保存到 NVS
+    tcp_slave_regs_invalidate();
     esp_err_t save_err = save_tcp_slave_config_to_nvs(&tcp_slave);
     if (save_err != ESP_OK)
     {
@@ -652,9 +427,9 @@ esp_err_t uart_config_handler(httpd_req_t *req)
     }
 
     int config_count = cJSON_GetArraySize(uart_configs);
-    if (config_count > 3)
+    if (config_count > UART_PORT_COUNT)
     {
-        config_count = 3; // 限制最大串口数量为3
+        config_count = UART_PORT_COUNT; // 限制最大串口数量
     }
 
     for (int i = 0; i < config_count; i++)
@@ -667,6 +442,10 @@ esp_err_t uart_config_handler(httpd_req_t *req)
         cJSON *data_bits = cJSON_GetObjectItem(uart_config, "data_bits");
         cJSON *parity = cJSON_GetObjectItem(uart_config, "parity");
         cJSON *stop_bits = cJSON_GetObjectItem(uart_config, "stop_bits");
+        cJSON *tx_pin = cJSON_GetObjectItem(uart_config, "tx_pin");
+        cJSON *rx_pin = cJSON_GetObjectItem(uart_config, "rx_pin");
+        cJSON *de_pin = cJSON_GetObjectItem(uart_config, "de_pin");
+        cJSON *rs485 = cJSON_GetObjectItem(uart_config, "rs485");
 
         if (baud_rate && cJSON_IsNumber(baud_rate))
         {
@@ -741,6 +520,17 @@ esp_err_t uart_config_handler(httpd_req_t *req)
                     uart_params[i].stop_bits = STOP_BITS_1;
             }
         }
+
+        // 引脚配置，-1表示不使用该引脚
+        if (tx_pin && cJSON_IsNumber(tx_pin) && GPIO_IS_VALID_OUTPUT_GPIO(tx_pin->valueint))
+            uart_params[i].tx_pin = tx_pin->valueint;
+        if (rx_pin && cJSON_IsNumber(rx_pin) && GPIO_IS_VALID_GPIO(rx_pin->valueint))
+            uart_params[i].rx_pin = rx_pin->valueint;
+        if (de_pin && cJSON_IsNumber(de_pin) &&
+            (de_pin->valueint == -1 || GPIO_IS_VALID_OUTPUT_GPIO(de_pin->valueint)))
+            uart_params[i].de_pin = de_pin->valueint;
+        if (rs485)
+            uart_params[i].rs485 = cJSON_IsTrue(rs485);
     }
 
     // 释放资源
@@ -757,6 +547,52 @@ esp_err_t uart_config_handler(httpd_req_t *req)
     return ESP_OK;
 }
 
+// 写从站寄存器/线圈处理函数，命令经写队列插入轮询间隙执行，等待从站应答后返回结果
+esp_err_t modbus_write_handler(httpd_req_t *req)
+{
+    char content[1024];
+    int ret = httpd_req_recv(req, content, sizeof(content) - 1);
+    if (ret <= 0)
+    {
+        return ESP_FAIL;
+    }
+    content[ret] = '\0';
+
+    cJSON *root = cJSON_Parse(content);
+    if (root == NULL)
+    {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Invalid JSON");
+        return ESP_FAIL;
+    }
+
+    static write_req_t write_req;   // 较大，不放在HTTP任务栈上
+    esp_err_t err = write_req_from_json(root, &write_req);
+    cJSON_Delete(root);
+    if (err != ESP_OK)
+    {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Invalid write request");
+        return ESP_FAIL;
+    }
+
+    int result = write_queue_submit_wait(&write_req);
+
+    cJSON *response = cJSON_CreateObject();
+    cJSON_AddStringToObject(response, "status", result == WRITE_OK ? "ok" : "error");
+    cJSON_AddStringToObject(response, "result", write_result_name(result));
+    if (result <= -128)
+    {
+        cJSON_AddNumberToObject(response, "exception", -128 - result);
+    }
+
+    char *json_str = cJSON_PrintUnformatted(response);
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_send(req, json_str, strlen(json_str));
+
+    free(json_str);
+    cJSON_Delete(response);
+    return ESP_OK;
+}
+
 // URI处理结构
 static const httpd_uri_t html = {
     .uri = "/",
@@ -819,12 +655,18 @@ static const httpd_uri_t uart_config = {
     .handler = uart_config_handler,
     .user_ctx = NULL};
 
+static const httpd_uri_t modbus_write = {
+    .uri = "/api/modbus/write",
+    .method = HTTP_POST,
+    .handler = modbus_write_handler,
+    .user_ctx = NULL};
+
 httpd_handle_t start_webserver(void)
 {
     httpd_handle_t server = NULL;
     httpd_config_t config = HTTPD_DEFAULT_CONFIG();
     config.stack_size = 8192;
-    config.max_uri_handlers = 10;  
+    config.max_uri_handlers = 11;  
 
     if (httpd_start(&server, &config) == ESP_OK)
     {
@@ -838,6 +680,7 @@ httpd_handle_t start_webserver(void)
         httpd_register_uri_handler(server, &tcp_slave_post);
         httpd_register_uri_handler(server, &wifi_config);
         httpd_register_uri_handler(server, &uart_config);
+        httpd_register_uri_handler(server, &modbus_write);
         ESP_LOGI(TAG, "HTTP服务器启动成功");
         return server;
     }
@@ -0,0 +1,353 @@
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "write_queue.h"
+#include "agile_modbus.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+
+static const char *TAG = "write_queue";
+
+// 队列中的一条写命令
+typedef struct {
+    write_req_t req;
+    int64_t queued_us;
+    write_done_cb_t done;
+    void *done_arg;
+} write_entry_t;
+
+// 单个串口的写队列(环形缓冲区，按提交顺序执行)
+typedef struct {
+    write_entry_t entries[WRITE_QUEUE_DEPTH];
+    uint8_t head;
+    uint8_t count;
+    SemaphoreHandle_t lock;     // 保护环形缓冲区
+    SemaphoreHandle_t wake;     // 有新命令入队时唤醒空闲的轮询任务
+    volatile bool attached;     // 已有轮询任务执行该串口的写命令
+} write_port_t;
+
+static write_port_t write_ports[WRITE_QUEUE_PORTS];
+
+// 同步提交时的等待对象
+typedef struct {
+    StaticSemaphore_t sem_buf;
+    SemaphoreHandle_t sem;
+    int result;
+} write_waiter_t;
+
+static bool is_bit_write(uint8_t function_code)
+{
+    return function_code == 5 || function_code == 15;
+}
+
+static write_port_t *get_port(uint8_t uart_port)
+{
+    if (uart_port < 1 || uart_port > WRITE_QUEUE_PORTS || write_ports[uart_port - 1].lock == NULL) {
+        return NULL;
+    }
+    return &write_ports[uart_port - 1];
+}
+
+esp_err_t write_queue_init(void)
+{
+    for (int i = 0; i < WRITE_QUEUE_PORTS; i++) {
+        write_port_t *port = &write_ports[i];
+        if (port->lock != NULL) {
+            continue;
+        }
+        port->lock = xSemaphoreCreateMutex();
+        port->wake = xSemaphoreCreateBinary();
+        if (port->lock == NULL || port->wake == NULL) {
+            ESP_LOGE(TAG, "Failed to create write queue for UART%d", i + 1);
+            return ESP_ERR_NO_MEM;
+        }
+    }
+    return ESP_OK;
+}
+
+void write_queue_attach(uint8_t uart_port)
+{
+    write_port_t *port = get_port(uart_port);
+
+    if (port) {
+        port->attached = true;
+    }
+}
+
+esp_err_t write_queue_submit(const write_req_t *req, write_done_cb_t done, void *arg)
+{
+    write_port_t *port = get_port(req->uart_port);
+    int max_count;
+
+    switch (req->function_code) {
+    case 5:
+    case 6:
+        max_count = 1;
+        break;
+    case 15:
+        max_count = WRITE_MAX_BITS;
+        break;
+    case 16:
+        max_count = WRITE_MAX_REGS;
+        break;
+    default:
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (port == NULL || req->count == 0 || req->count > max_count ||
+        (uint32_t)req->addr + req->count > 0x10000) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    // 没有轮询任务(串口未启动或任务创建失败)时命令永远不会执行
+    if (!port->attached) {
+        ESP_LOGW(TAG, "UART%d has no running poll task, write rejected", req->uart_port);
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    xSemaphoreTake(port->lock, portMAX_DELAY);
+    if (port->count >= WRITE_QUEUE_DEPTH) {
+        xSemaphoreGive(port->lock);
+        ESP_LOGW(TAG, "UART%d write queue full", req->uart_port);
+        return ESP_ERR_NO_MEM;
+    }
+    write_entry_t *entry = &port->entries[(port->head + port->count) % WRITE_QUEUE_DEPTH];
+    entry->req = *req;
+    entry->queued_us = esp_timer_get_time();
+    entry->done = done;
+    entry->done_arg = arg;
+    port->count++;
+    xSemaphoreGive(port->lock);
+
+    xSemaphoreGive(port->wake);
+    return ESP_OK;
+}
+
+static void waiter_done(int result, void *arg)
+{
+    write_waiter_t *waiter = (write_waiter_t *)arg;
+    waiter->result = result;
+    xSemaphoreGive(waiter->sem);
+}
+
+// 撤回串口队列中以 done/arg 提交的命令：不再回调，命令到期后按过期丢弃。返回撤回的命令数
+static int cancel_entries(write_port_t *port, write_done_cb_t done, void *arg)
+{
+    int found = 0;
+
+    xSemaphoreTake(port->lock, portMAX_DELAY);
+    for (int i = 0; i < port->count; i++) {
+        write_entry_t *entry = &port->entries[(port->head + i) % WRITE_QUEUE_DEPTH];
+        if (entry->done == done && entry->done_arg == arg) {
+            entry->done = NULL;
+            entry->done_arg = NULL;
+            found++;
+        }
+    }
+    xSemaphoreGive(port->lock);
+    return found;
+}
+
+int write_queue_cancel(write_done_cb_t done, void *arg)
+{
+    int found = 0;
+
+    for (int i = 1; i <= WRITE_QUEUE_PORTS; i++) {
+        write_port_t *port = get_port(i);
+        if (port) {
+            found += cancel_entries(port, done, arg);
+        }
+    }
+    return found;
+}
+
+int write_queue_submit_wait(const write_req_t *req)
+{
+    write_waiter_t waiter;
+
+    waiter.sem = xSemaphoreCreateBinaryStatic(&waiter.sem_buf);
+    waiter.result = WRITE_ERR_FRAME;
+    if (write_queue_submit(req, waiter_done, &waiter) != ESP_OK) {
+        vSemaphoreDelete(waiter.sem);
+        return WRITE_ERR_FRAME;
+    }
+
+    // 轮询任务正常时在排队期限加一次事务超时内回调；超时说明轮询任务停滞，
+    // 撤回仍在排队的命令。已被取走的命令正在执行，回调会写入 waiter，必须等它完成
+    if (xSemaphoreTake(waiter.sem, pdMS_TO_TICKS(WRITE_WAIT_MS)) != pdTRUE) {
+        if (cancel_entries(get_port(req->uart_port), waiter_done, &waiter) > 0) {
+            ESP_LOGW(TAG, "UART%d write not taken within %d ms, cancelled", req->uart_port, WRITE_WAIT_MS);
+            waiter.result = WRITE_ERR_EXPIRED;
+        } else {
+            xSemaphoreTake(waiter.sem, portMAX_DELAY);
+        }
+    }
+    vSemaphoreDelete(waiter.sem);
+    return waiter.result;
+}
+
+esp_err_t write_req_from_json(const cJSON *json, write_req_t *req)
+{
+    cJSON *port = cJSON_GetObjectItem(json, "port");
+    cJSON *slave = cJSON_GetObjectItem(json, "slave");
+    cJSON *fc = cJSON_GetObjectItem(json, "fc");
+    cJSON *addr = cJSON_GetObjectItem(json, "addr");
+    cJSON *values = cJSON_GetObjectItem(json, "values");
+
+    if (!cJSON_IsNumber(port) || !cJSON_IsNumber(slave) || !cJSON_IsNumber(fc) ||
+        !cJSON_IsNumber(addr) || !cJSON_IsArray(values)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    int count = cJSON_GetArraySize(values);
+    bool bits = is_bit_write(fc->valueint);
+    if (fc->valueint == 5 || fc->valueint == 6) {
+        count = (count > 0) ? 1 : 0;
+    }
+    if (count == 0 || count > (bits ? WRITE_MAX_BITS : WRITE_MAX_REGS) ||
+        slave->valueint < 0 || slave->valueint > 247 ||
+        addr->valueint < 0 || addr->valueint > 0xFFFF) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    memset(req, 0, sizeof(*req));
+    req->uart_port = port->valueint;
+    req->slave_addr = slave->valueint;
+    req->function_code = fc->valueint;
+    req->addr = addr->valueint;
+    req->count = count;
+    for (int i = 0; i < count; i++) {
+        cJSON *value = cJSON_GetArrayItem(values, i);
+        int v = cJSON_IsNumber(value) ? value->valueint : cJSON_IsTrue(value);
+        if (bits) {
+            agile_modbus_slave_io_set(req->bits, i, v != 0);
+        } else {
+            req->regs[i] = (uint16_t)v;
+        }
+    }
+    return ESP_OK;
+}
+
+const char *write_result_name(int result)
+{
+    if (result <= -128) {
+        return "exception";
+    }
+    switch (result) {
+    case WRITE_OK:
+        return "ok";
+    case WRITE_ERR_TIMEOUT:
+        return "timeout";
+    case WRITE_ERR_EXPIRED:
+        return "expired";
+    default:
+        return "error";
+    }
+}
+
+int write_result_exception(int result)
+{
+    if (result == WRITE_OK) {
+        return 0;
+    }
+    if (result <= -128) {
+        return -(-128 - result);
+    }
+    if (result == WRITE_ERR_TIMEOUT || result == WRITE_ERR_EXPIRED) {
+        return -AGILE_MODBUS_EXCEPTION_GATEWAY_TARGET;
+    }
+    return -AGILE_MODBUS_EXCEPTION_SLAVE_OR_SERVER_FAILURE;
+}
+
+// 尝试把 next 并入批次：同一从站、同为FC15或同为FC16，且地址区间相邻或重叠。
+// FC05/06 不合并也不改写为FC15/16，有的从站只支持单个写入的功能码
+static bool try_merge(write_req_t *batch, const write_req_t *next)
+{
+    bool bits = is_bit_write(batch->function_code);
+    uint32_t batch_end = (uint32_t)batch->addr + batch->count;
+    uint32_t next_end = (uint32_t)next->addr + next->count;
+
+    if (next->slave_addr != batch->slave_addr || next->function_code != batch->function_code ||
+        (batch->function_code != 15 && batch->function_code != 16) ||
+        next->addr > batch_end || next_end < batch->addr) {
+        return false;
+    }
+
+    uint16_t start = (next->addr < batch->addr) ? next->addr : batch->addr;
+    uint32_t end = (next_end > batch_end) ? next_end : batch_end;
+    if (end - start > (bits ? WRITE_MAX_BITS : WRITE_MAX_REGS)) {
+        return false;
+    }
+
+    // 起始地址前移时先整体后移已有数据，再用后提交的值覆盖重叠部分
+    int shift = batch->addr - start;
+    int next_offset = next->addr - start;
+    if (bits) {
+        if (shift > 0) {
+            uint8_t old[sizeof(batch->bits)];
+            memcpy(old, batch->bits, (batch->count + 7) / 8);
+            agile_modbus_copy_bits(batch->bits, shift, old, 0, batch->count);
+        }
+        agile_modbus_copy_bits(batch->bits, next_offset, next->bits, 0, next->count);
+    } else {
+        memmove(&batch->regs[shift], batch->regs, batch->count * sizeof(uint16_t));
+        memcpy(&batch->regs[next_offset], next->regs, next->count * sizeof(uint16_t));
+    }
+
+    batch->addr = start;
+    batch->count = end - start;
+    return true;
+}
+
+bool write_queue_take(uint8_t uart_port, write_batch_t *batch, bool merge)
+{
+    write_port_t *port = get_port(uart_port);
+
+    if (port == NULL || port->count == 0) {
+        return false;
+    }
+
+    xSemaphoreTake(port->lock, portMAX_DELAY);
+    if (port->count == 0) {
+        xSemaphoreGive(port->lock);
+        return false;
+    }
+
+    write_entry_t *entry = &port->entries[port->head];
+    batch->req = entry->req;
+    batch->queued_us = entry->queued_us;
+    batch->done_count = 0;
+    do {
+        batch->done[batch->done_count] = entry->done;
+        batch->done_arg[batch->done_count] = entry->done_arg;
+        batch->done_count++;
+        port->head = (port->head + 1) % WRITE_QUEUE_DEPTH;
+        port->count--;
+
+        // 只合并紧随其后的命令，保证同一地址的写入顺序不变
+        entry = &port->entries[port->head];
+    } while (merge && port->count > 0 && try_merge(&batch->req, &entry->req));
+    xSemaphoreGive(port->lock);
+
+    return true;
+}
+
+void write_queue_complete(write_batch_t *batch, int result)
+{
+    for (int i = 0; i < batch->done_count; i++) {
+        if (batch->done[i]) {
+            batch->done[i](result, batch->done_arg[i]);
+        }
+    }
+    batch->done_count = 0;
+}
+
+void write_queue_wait(uint8_t uart_port, TickType_t ticks)
+{
+    write_port_t *port = get_port(uart_port);
+
+    if (port == NULL) {
+        vTaskDelay(ticks);
+        return;
+    }
+    xSemaphoreTake(port->wake, ticks);
+}
@@ -0,0 +1,85 @@
+#ifndef WRITE_QUEUE_H
+#define WRITE_QUEUE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+#include "cJSON.h"
+#include "agile_modbus.h"
+
+#define WRITE_QUEUE_PORTS 3          // 逻辑串口1~3
+#define WRITE_QUEUE_DEPTH 8          // 每个串口最多排队的写命令数
+#define WRITE_MAX_REGS 123           // 单条写命令最多寄存器数(FC16上限)
+#define WRITE_MAX_BITS AGILE_MODBUS_MAX_WRITE_BITS  // 单条写命令最多线圈数(FC15上限)
+#define WRITE_LATENCY_TARGET_MS 100  // 写命令排队时间目标，超过时告警
+#define WRITE_EXPIRE_MS 2000         // 排队超过该时间仍未发送的写命令直接判定失败
+#define WRITE_WAIT_MS (WRITE_EXPIRE_MS + 1000)  // 同步提交最长等待：排队期限加一次事务的最大超时
+
+// 写命令结果：0 成功，<0 失败；从站异常响应为 -128 - 异常码(与 agile_modbus 约定一致)
+#define WRITE_OK 0
+#define WRITE_ERR_TIMEOUT -1         // 从站无应答
+#define WRITE_ERR_EXPIRED -2         // 排队超时未发送
+#define WRITE_ERR_FRAME -3           // 请求打包失败或响应无效
+
+// 写命令完成回调，在轮询任务中调用，不能阻塞
+typedef void (*write_done_cb_t)(int result, void *arg);
+
+// 写命令
+typedef struct {
+    uint8_t uart_port;      // 逻辑串口号 1~3
+    uint8_t slave_addr;     // 从站地址，0为广播
+    uint8_t function_code;  // 5/6/15/16
+    uint16_t addr;          // 起始地址
+    uint16_t count;         // 寄存器或线圈个数
+    union {
+        uint16_t regs[WRITE_MAX_REGS];
+        uint8_t bits[(WRITE_MAX_BITS + 7) / 8]; // 打包的线圈值，低位在前(与FC15报文一致)
+    };
+} write_req_t;
+
+// 轮询任务一次取出的写批次：队列中相邻的可合并写命令合成一条
+typedef struct {
+    write_req_t req;
+    int64_t queued_us;                  // 批次中最早入队的时间
+    uint8_t done_count;
+    write_done_cb_t done[WRITE_QUEUE_DEPTH];
+    void *done_arg[WRITE_QUEUE_DEPTH];
+} write_batch_t;
+
+// 初始化各串口写队列
+esp_err_t write_queue_init(void);
+
+// 轮询任务启动后调用：登记为串口写队列的执行者，此后该串口才接受写命令
+void write_queue_attach(uint8_t uart_port);
+
+// 提交写命令，done 可为 NULL；队列满、参数无效或串口没有运行的轮询任务时返回错误，不调用 done
+esp_err_t write_queue_submit(const write_req_t *req, write_done_cb_t done, void *arg);
+
+// 提交写命令并等待结果，返回写命令结果；提交失败返回 WRITE_ERR_FRAME。
+// 最多等待 WRITE_WAIT_MS，超时后撤回仍在排队的命令并返回 WRITE_ERR_EXPIRED
+int write_queue_submit_wait(const write_req_t *req);
+
+// 撤回以 done/arg 提交、仍在排队的写命令，之后不再回调；已被轮询任务取走的命令照常回调。返回撤回的命令数
+int write_queue_cancel(write_done_cb_t done, void *arg);
+
+// 从JSON解析写命令：{"port":1,"slave":1,"fc":16,"addr":100,"values":[1,2]}，
+// fc 为5/6时 values 只取第一个值
+esp_err_t write_req_from_json(const cJSON *json, write_req_t *req);
+
+// 写命令结果的文字说明
+const char *write_result_name(int result);
+
+// 写命令结果转换为返回给Modbus客户端的异常码(负数，作为从站回调的返回值)，成功返回0
+int write_result_exception(int result);
+
+// 轮询任务调用：取出串口上的下一批写命令，merge 为 true 时合并地址相邻、功能码相同的FC15/FC16写命令。没有时返回 false
+bool write_queue_take(uint8_t uart_port, write_batch_t *batch, bool merge);
+
+// 轮询任务调用：报告写批次结果，通知批次中的每个提交者
+void write_queue_complete(write_batch_t *batch, int result);
+
+// 轮询任务空闲时调用：最多等待 ticks，有写命令入队时立即返回
+void write_queue_wait(uint8_t uart_port, TickType_t ticks);
+
+#endif